@@ -0,0 +1,68 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chain.h"
+#include "hash.h"
+#include "support/allocators/arena.h"
+#include "utilstrencodings.h"
+#include "validation.h"
+
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+// Load a block index of mainnet size in height order (as from the block index
+// snapshot, or as blocks arrive), then look blocks up by hash and find their
+// ancestors, as header processing and fork finding do. The same workload runs
+// with each entry allocated by new and indexed by the boost::unordered_map
+// that BlockMap used to be, for comparison.
+template <typename Map, bool ARENA>
+static void BlockIndexLoad(benchmark::State& state)
+{
+    const int nBlocks = 500000;
+    std::vector<uint256> vHashes;
+    vHashes.reserve(nBlocks);
+    for (int i = 0; i < nBlocks; i++)
+        vHashes.push_back(Hash(BEGIN(i), END(i)));
+
+    while (state.KeepRunning()) {
+        Map map;
+        ObjectArena<CBlockIndex> arena;
+        for (int i = 0; i < nBlocks; i++) {
+            CBlockIndex* pindex = ARENA ? arena.New() : new CBlockIndex();
+            typename Map::iterator it = map.insert(std::make_pair(vHashes[i], pindex)).first;
+            pindex->phashBlock = &it->first;
+            pindex->nHeight = i;
+            if (i > 0) {
+                pindex->pprev = map.find(vHashes[i - 1])->second;
+                pindex->BuildSkip();
+            }
+        }
+
+        for (int i = 0; i < 100000; i++) {
+            const int nHeight = (i * 7919) % nBlocks;
+            const CBlockIndex* pindex = map.find(vHashes[nHeight])->second;
+            assert(pindex->GetAncestor(nHeight / 2)->nHeight == nHeight / 2);
+        }
+
+        if (!ARENA) {
+            for (typename Map::value_type& entry : map)
+                delete entry.second;
+        }
+    }
+}
+
+static void BlockIndexLoadArena(benchmark::State& state)
+{
+    BlockIndexLoad<BlockMap, true>(state);
+}
+
+static void BlockIndexLoadUnordered(benchmark::State& state)
+{
+    BlockIndexLoad<boost::unordered_map<uint256, CBlockIndex*, BlockHasher>, false>(state);
+}
+
+BENCHMARK(BlockIndexLoadArena);
+BENCHMARK(BlockIndexLoadUnordered);
@@ -4,11 +4,15 @@
 
 #include "bench.h"
 #include "coins.h"
+#include "hash.h"
 #include "policy/policy.h"
+#include "utilstrencodings.h"
 #include "wallet/crypter.h"
 
 #include <vector>
 
+#include <boost/unordered_map.hpp>
+
 // FIXME: Dedup with SetupDummyInputs in test/transaction_tests.cpp.
 //
 // Helper: create two dummy transactions, each with
@@ -85,3 +89,46 @@ static void CCoinsCaching(benchmark::State& state)
 }
 
 BENCHMARK(CCoinsCaching);
+
+// Lookups, hits and misses, and the erasures and insertions of a busy coins
+// cache, on a map too large for the CPU caches. The same workload runs on the
+// boost::unordered_map that CCoinsMap used to be, for comparison.
+template <typename Map>
+static void CoinsMapAccess(benchmark::State& state)
+{
+    const uint32_t nEntries = 300000;
+    std::vector<uint256> vTxids, vMissing;
+    for (uint32_t i = 0; i < nEntries; i++)
+        vTxids.push_back(Hash(BEGIN(i), END(i)));
+    for (uint32_t i = nEntries; i < nEntries + 1000; i++)
+        vMissing.push_back(Hash(BEGIN(i), END(i)));
+
+    Map map;
+    for (const uint256& txid : vTxids)
+        map.emplace(txid, CCoinsCacheEntry());
+
+    size_t n = 0;
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 100; i++, n++) {
+            const uint256& txid = vTxids[(n * 7919) % nEntries];
+            typename Map::iterator it = map.find(txid);
+            assert(it != map.end());
+            map.erase(it);
+            assert(map.find(vMissing[n % vMissing.size()]) == map.end());
+            map.emplace(txid, CCoinsCacheEntry());
+        }
+    }
+}
+
+static void CoinsMapAccessPooled(benchmark::State& state)
+{
+    CoinsMapAccess<CCoinsMap>(state);
+}
+
+static void CoinsMapAccessUnordered(benchmark::State& state)
+{
+    CoinsMapAccess<boost::unordered_map<uint256, CCoinsCacheEntry, SaltedTxidHasher> >(state);
+}
+
+BENCHMARK(CoinsMapAccessPooled);
+BENCHMARK(CoinsMapAccessUnordered);
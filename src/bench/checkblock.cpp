@@ -7,7 +7,9 @@
 #include "chainparams.h"
 #include "validation.h"
 #include "streams.h"
+#include "consensus/merkle.h"
 #include "consensus/validation.h"
+#include "primitives/blockview.h"
 
 namespace block_bench {
 #include "bench/data/block413567.raw.h"
@@ -52,5 +54,58 @@ static void DeserializeAndCheckBlockTest(benchmark::State& state)
     }
 }
 
+// The same with a view of the serialized block, which is enough to check its
+// merkle roots and to relay it to peers as a full block.
+
+static void ParseBlockViewTest(benchmark::State& state)
+{
+    CBlockView::Buffer buffer = std::make_shared<std::vector<unsigned char> >(block_bench::block413567,
+            &block_bench::block413567[sizeof(block_bench::block413567)]);
+    CBlockView view;
+    assert(view.Parse(buffer));
+    uint256 hashMerkleRoot = view.GetHeader().hashMerkleRoot;
+
+    while (state.KeepRunning()) {
+        assert(view.Parse(buffer));
+        bool mutated;
+        assert(BlockMerkleRoot(view, &mutated) == hashMerkleRoot && !mutated);
+    }
+}
+
+static void RelayBlockTest(benchmark::State& state)
+{
+    CDataStream stream((const char*)block_bench::block413567,
+            (const char*)&block_bench::block413567[sizeof(block_bench::block413567)],
+            SER_NETWORK, PROTOCOL_VERSION);
+    char a;
+    stream.write(&a, 1); // Prevent compaction
+    std::vector<unsigned char> vchMessage;
+
+    while (state.KeepRunning()) {
+        CBlock block;
+        stream >> block;
+        assert(stream.Rewind(sizeof(block_bench::block413567)));
+        vchMessage.clear();
+        CVectorWriter(SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS, vchMessage, 0, block);
+    }
+}
+
+static void RelayBlockViewTest(benchmark::State& state)
+{
+    CBlockView::Buffer buffer = std::make_shared<std::vector<unsigned char> >(block_bench::block413567,
+            &block_bench::block413567[sizeof(block_bench::block413567)]);
+    std::vector<unsigned char> vchMessage;
+
+    while (state.KeepRunning()) {
+        CBlockView view;
+        assert(view.Parse(buffer));
+        vchMessage.clear();
+        CVectorWriter(SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS, vchMessage, 0, view);
+    }
+}
+
 BENCHMARK(DeserializeBlockTest);
 BENCHMARK(DeserializeAndCheckBlockTest);
+BENCHMARK(ParseBlockViewTest);
+BENCHMARK(RelayBlockTest);
+BENCHMARK(RelayBlockViewTest);
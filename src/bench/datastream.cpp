@@ -0,0 +1,87 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "primitives/block.h"
+#include "streams.h"
+#include "version.h"
+
+namespace block_bench {
+#include "bench/data/block413567.raw.h"
+}
+
+// Receiving and decoding network messages the way CNetMessage and
+// ProcessMessage do: the payload is copied into a fresh stream, deserialized,
+// and the stream freed. Compares the wiping CDataStream with the
+// CPlainDataStream used on the network paths.
+
+template <typename Stream>
+static void ReceiveMessage(Stream& stream, const char* pch, size_t nSize)
+{
+    stream.resize(nSize);
+    memcpy(&stream[0], pch, nSize);
+}
+
+template <typename Stream>
+static void ReceiveBlockMessages(benchmark::State& state)
+{
+    const char* pch = (const char*)block_bench::block413567;
+    while (state.KeepRunning()) {
+        Stream stream(SER_NETWORK, PROTOCOL_VERSION);
+        ReceiveMessage(stream, pch, sizeof(block_bench::block413567));
+        CBlock block;
+        stream >> block;
+    }
+}
+
+template <typename Stream>
+static void ReceiveTransactionMessages(benchmark::State& state)
+{
+    CDataStream streamBlock((const char*)block_bench::block413567,
+            (const char*)&block_bench::block413567[sizeof(block_bench::block413567)],
+            SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
+    streamBlock >> block;
+    std::vector<std::vector<char> > vMessages;
+    for (const CTransactionRef& tx : block.vtx) {
+        CPlainDataStream streamTx(SER_NETWORK, PROTOCOL_VERSION);
+        streamTx << tx;
+        vMessages.push_back(std::vector<char>(streamTx.begin(), streamTx.end()));
+    }
+
+    while (state.KeepRunning()) {
+        for (const std::vector<char>& vMessage : vMessages) {
+            Stream stream(SER_NETWORK, PROTOCOL_VERSION);
+            ReceiveMessage(stream, vMessage.data(), vMessage.size());
+            CTransactionRef tx;
+            stream >> tx;
+        }
+    }
+}
+
+static void ReceiveBlockMessagesWiped(benchmark::State& state)
+{
+    ReceiveBlockMessages<CDataStream>(state);
+}
+
+static void ReceiveBlockMessagesPlain(benchmark::State& state)
+{
+    ReceiveBlockMessages<CPlainDataStream>(state);
+}
+
+static void ReceiveTransactionMessagesWiped(benchmark::State& state)
+{
+    ReceiveTransactionMessages<CDataStream>(state);
+}
+
+static void ReceiveTransactionMessagesPlain(benchmark::State& state)
+{
+    ReceiveTransactionMessages<CPlainDataStream>(state);
+}
+
+BENCHMARK(ReceiveBlockMessagesWiped);
+BENCHMARK(ReceiveBlockMessagesPlain);
+BENCHMARK(ReceiveTransactionMessagesWiped);
+BENCHMARK(ReceiveTransactionMessagesPlain);
@@ -4,6 +4,7 @@
 
 #include "bench.h"
 #include "key.h"
+#include "random.h"
 #if defined(HAVE_CONSENSUS_LIB)
 #include "script/bitcoinconsensus.h"
 #endif
@@ -99,4 +100,45 @@ static void VerifyScriptBench(benchmark::State& state)
     }
 }
 
+// Legacy signature hashes of every input of a large consolidation
+// transaction, which cover the whole transaction each.
+static CMutableTransaction BuildConsolidationTransaction(int nInputs)
+{
+    CMutableTransaction txSpend;
+    txSpend.vin.resize(nInputs);
+    for (int i = 0; i < nInputs; i++) {
+        txSpend.vin[i].prevout.hash = GetRandHash();
+        txSpend.vin[i].prevout.n = i % 4;
+        txSpend.vin[i].scriptSig = CScript() << std::vector<unsigned char>(72) << std::vector<unsigned char>(33);
+    }
+    txSpend.vout.resize(1);
+    txSpend.vout[0].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20) << OP_EQUALVERIFY << OP_CHECKSIG;
+    txSpend.vout[0].nValue = nInputs;
+    return txSpend;
+}
+
+static void SignatureHashLegacy(benchmark::State& state, bool fPrecompute)
+{
+    const CTransaction tx(BuildConsolidationTransaction(500));
+    const CScript scriptCode = tx.vout[0].scriptPubKey;
+
+    while (state.KeepRunning()) {
+        PrecomputedTransactionData txdata(fPrecompute ? tx : CTransaction());
+        for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++)
+            SignatureHash(scriptCode, tx, nIn, SIGHASH_ALL, 0, SIGVERSION_BASE, &txdata);
+    }
+}
+
+static void SignatureHashLegacyBench(benchmark::State& state)
+{
+    SignatureHashLegacy(state, false);
+}
+
+static void SignatureHashLegacyPrecomputedBench(benchmark::State& state)
+{
+    SignatureHashLegacy(state, true);
+}
+
 BENCHMARK(VerifyScriptBench);
+BENCHMARK(SignatureHashLegacyBench);
+BENCHMARK(SignatureHashLegacyPrecomputedBench);
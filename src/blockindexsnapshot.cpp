@@ -0,0 +1,220 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockindexsnapshot.h"
+
+#include "arith_uint256.h"
+#include "chain.h"
+#include "clientversion.h"
+#include "hash.h"
+#include "serialize.h"
+#include "streams.h"
+#include "util.h"
+
+#include <string.h>
+#include <unordered_map>
+
+#include <boost/filesystem.hpp>
+
+namespace {
+
+const unsigned char SNAPSHOT_MAGIC[4] = {'b', 'i', 'd', 'x'};
+const uint32_t SNAPSHOT_VERSION = 1;
+//! Bytes buffered before writing to the snapshot file
+const size_t SNAPSHOT_WRITE_BUFFER = 1 << 20;
+
+struct CSnapshotHeader
+{
+    unsigned char magic[sizeof(SNAPSHOT_MAGIC)];
+    uint32_t nVersion;
+    uint256 tag;
+    uint64_t nEntries;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(FLATDATA(magic));
+        READWRITE(nVersion);
+        READWRITE(tag);
+        READWRITE(nEntries);
+    }
+};
+
+//! One block, with fixed-size fields only so that all entries have the same size
+struct CSnapshotEntry
+{
+    uint256 hash;
+    //! Positions of pprev and pskip in the snapshot, or -1
+    int32_t nPrev;
+    int32_t nSkip;
+    int32_t nHeight;
+    int32_t nFile;
+    uint32_t nDataPos;
+    uint32_t nUndoPos;
+    uint32_t nTx;
+    uint32_t nStatus;
+    int32_t nVersion;
+    uint256 hashMerkleRoot;
+    uint32_t nTime;
+    uint32_t nBits;
+    uint32_t nNonce;
+    uint256 nChainWork;
+    uint32_t nTimeMax;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hash);
+        READWRITE(nPrev);
+        READWRITE(nSkip);
+        READWRITE(nHeight);
+        READWRITE(nFile);
+        READWRITE(nDataPos);
+        READWRITE(nUndoPos);
+        READWRITE(nTx);
+        READWRITE(nStatus);
+        READWRITE(nVersion);
+        READWRITE(hashMerkleRoot);
+        READWRITE(nTime);
+        READWRITE(nBits);
+        READWRITE(nNonce);
+        READWRITE(nChainWork);
+        READWRITE(nTimeMax);
+    }
+};
+
+} // namespace
+
+bool WriteBlockIndexSnapshot(const boost::filesystem::path& path, const uint256& tag, const std::vector<const CBlockIndex*>& vIndex)
+{
+    std::unordered_map<const CBlockIndex*, int32_t> mapPos;
+    mapPos.reserve(vIndex.size());
+    for (size_t i = 0; i < vIndex.size(); i++)
+        mapPos[vIndex[i]] = i;
+    auto GetPos = [&mapPos](const CBlockIndex* pindex) {
+        return pindex ? mapPos.at(pindex) : -1;
+    };
+
+    const boost::filesystem::path pathTmp = path.string() + ".new";
+    CAutoFile file(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return error("%s: unable to open %s", __func__, pathTmp.string());
+    try {
+        CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+        std::vector<unsigned char> vch;
+        auto WriteBuffer = [&]() {
+            file.write((const char*)vch.data(), vch.size());
+            hasher.write((const char*)vch.data(), vch.size());
+            vch.clear();
+        };
+
+        CSnapshotHeader header;
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.nVersion = SNAPSHOT_VERSION;
+        header.tag = tag;
+        header.nEntries = vIndex.size();
+        CVectorWriter(SER_DISK, CLIENT_VERSION, vch, vch.size(), header);
+
+        CSnapshotEntry entry;
+        for (const CBlockIndex* pindex : vIndex) {
+            entry.hash = pindex->GetBlockHash();
+            entry.nPrev = GetPos(pindex->pprev);
+            entry.nSkip = GetPos(pindex->pskip);
+            entry.nHeight = pindex->nHeight;
+            entry.nFile = pindex->nFile;
+            entry.nDataPos = pindex->nDataPos;
+            entry.nUndoPos = pindex->nUndoPos;
+            entry.nTx = pindex->nTx;
+            entry.nStatus = pindex->nStatus;
+            entry.nVersion = pindex->nVersion;
+            entry.hashMerkleRoot = pindex->hashMerkleRoot;
+            entry.nTime = pindex->nTime;
+            entry.nBits = pindex->nBits;
+            entry.nNonce = pindex->nNonce;
+            entry.nChainWork = ArithToUint256(pindex->nChainWork);
+            entry.nTimeMax = pindex->nTimeMax;
+            CVectorWriter(SER_DISK, CLIENT_VERSION, vch, vch.size(), entry);
+            if (vch.size() >= SNAPSHOT_WRITE_BUFFER)
+                WriteBuffer();
+        }
+        WriteBuffer();
+        file << hasher.GetHash();
+        FileCommit(file.Get());
+        file.fclose();
+    } catch (const std::exception& e) {
+        file.fclose();
+        boost::filesystem::remove(pathTmp);
+        return error("%s: failed to write %s: %s", __func__, pathTmp.string(), e.what());
+    }
+    if (!RenameOver(pathTmp, path))
+        return error("%s: unable to rename %s", __func__, pathTmp.string());
+    return true;
+}
+
+bool ReadBlockIndexSnapshot(const boost::filesystem::path& path, const uint256& tag, boost::function<CBlockIndex*(const uint256&)> insertBlockIndex, std::vector<CBlockIndex*>& vIndex)
+{
+    std::vector<CSnapshotEntry> vEntries;
+    try {
+        // Read in one go and check the checksum before looking at anything
+        std::vector<unsigned char> vch(boost::filesystem::file_size(path));
+        CAutoFile file(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull())
+            return error("%s: unable to open %s", __func__, path.string());
+        file.read((char*)vch.data(), vch.size());
+        if (vch.size() < sizeof(uint256))
+            return error("%s: truncated", __func__);
+        const unsigned char* pchecksum = vch.data() + vch.size() - sizeof(uint256);
+        const uint256 hash = Hash(vch.cbegin(), vch.cend() - sizeof(uint256));
+        if (memcmp(hash.begin(), pchecksum, sizeof(uint256)) != 0)
+            return error("%s: checksum mismatch", __func__);
+
+        CSpanReader s(SER_DISK, CLIENT_VERSION, vch.data(), pchecksum);
+        CSnapshotHeader header;
+        s >> header;
+        if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header.nVersion != SNAPSHOT_VERSION)
+            return error("%s: unknown format", __func__);
+        if (header.tag != tag)
+            return error("%s: written for another block tree database state", __func__);
+        if (header.nEntries * ::GetSerializeSize(CSnapshotEntry(), SER_DISK, CLIENT_VERSION) != s.size())
+            return error("%s: size mismatch", __func__);
+
+        vEntries.resize(header.nEntries);
+        for (size_t i = 0; i < vEntries.size(); i++) {
+            CSnapshotEntry& entry = vEntries[i];
+            s >> entry;
+            // Links only go backwards, to lower blocks
+            const bool fPrevValid = entry.nPrev < 0 ? entry.nHeight == 0 : (size_t)entry.nPrev < i && vEntries[entry.nPrev].nHeight == entry.nHeight - 1;
+            const bool fSkipValid = entry.nSkip < 0 ? entry.nPrev < 0 : (size_t)entry.nSkip < i && vEntries[entry.nSkip].nHeight < entry.nHeight;
+            if (entry.nPrev < -1 || entry.nSkip < -1 || !fPrevValid || !fSkipValid)
+                return error("%s: invalid entry %u", __func__, i);
+        }
+    } catch (const std::exception& e) {
+        return error("%s: failed to read %s: %s", __func__, path.string(), e.what());
+    }
+
+    vIndex.clear();
+    vIndex.reserve(vEntries.size());
+    for (const CSnapshotEntry& entry : vEntries) {
+        CBlockIndex* pindex = insertBlockIndex(entry.hash);
+        pindex->pprev = entry.nPrev < 0 ? NULL : vIndex[entry.nPrev];
+        pindex->pskip = entry.nSkip < 0 ? NULL : vIndex[entry.nSkip];
+        pindex->nHeight = entry.nHeight;
+        pindex->nFile = entry.nFile;
+        pindex->nDataPos = entry.nDataPos;
+        pindex->nUndoPos = entry.nUndoPos;
+        pindex->nTx = entry.nTx;
+        pindex->nStatus = entry.nStatus;
+        pindex->nVersion = entry.nVersion;
+        pindex->hashMerkleRoot = entry.hashMerkleRoot;
+        pindex->nTime = entry.nTime;
+        pindex->nBits = entry.nBits;
+        pindex->nNonce = entry.nNonce;
+        pindex->nChainWork = UintToArith256(entry.nChainWork);
+        pindex->nTimeMax = entry.nTimeMax;
+        vIndex.push_back(pindex);
+    }
+    return true;
+}
@@ -0,0 +1,38 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKINDEXSNAPSHOT_H
+#define BITCOIN_BLOCKINDEXSNAPSHOT_H
+
+#include "uint256.h"
+
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/function.hpp>
+
+class CBlockIndex;
+
+/**
+ * A block index snapshot is a flat copy of the block index, written at
+ * shutdown so that the next startup can read it in one go instead of
+ * iterating over the block tree database. It holds, after a header with a
+ * tag identifying the database state it was written for, one fixed-size
+ * record per block in height order, with its hash, chain work and the
+ * positions of its pprev and pskip, so that nothing needs to be hashed or
+ * recomputed on load. It ends with the double SHA256 of everything before.
+ */
+
+/** Write vIndex, which must be sorted by height and closed under pprev and pskip */
+bool WriteBlockIndexSnapshot(const boost::filesystem::path& path, const uint256& tag, const std::vector<const CBlockIndex*>& vIndex);
+
+/**
+ * Read a snapshot written for tag, creating its entries through
+ * insertBlockIndex (as CBlockTreeDB::LoadBlockIndexGuts does), and return
+ * them in height order. Nothing is created unless the whole snapshot is
+ * valid. Only nChainTx and nSequenceId are left for the caller to fill in.
+ */
+bool ReadBlockIndexSnapshot(const boost::filesystem::path& path, const uint256& tag, boost::function<CBlockIndex*(const uint256&)> insertBlockIndex, std::vector<CBlockIndex*>& vIndex);
+
+#endif // BITCOIN_BLOCKINDEXSNAPSHOT_H
@@ -44,7 +44,7 @@ bool CCoins::Spend(uint32_t nPos)
 bool CCoinsView::GetCoins(const uint256 &txid, CCoins &coins) const { return false; }
 bool CCoinsView::HaveCoins(const uint256 &txid) const { return false; }
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
-bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return false; }
+bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) { return false; }
 CCoinsViewCursor *CCoinsView::Cursor() const { return 0; }
 
 
@@ -53,7 +53,7 @@ bool CCoinsViewBacked::GetCoins(const uint256 &txid, CCoins &coins) const { retu
 bool CCoinsViewBacked::HaveCoins(const uint256 &txid) const { return base->HaveCoins(txid); }
 uint256 CCoinsViewBacked::GetBestBlock() const { return base->GetBestBlock(); }
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
-bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return base->BatchWrite(mapCoins, hashBlock); }
+bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) { return base->BatchWrite(mapCoins, hashBlock, fErase); }
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
 
 SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
@@ -71,12 +71,16 @@ size_t CCoinsViewCache::DynamicMemoryUsage() const {
 
 CCoinsMap::const_iterator CCoinsViewCache::FetchCoins(const uint256 &txid) const {
     CCoinsMap::iterator it = cacheCoins.find(txid);
-    if (it != cacheCoins.end())
+    if (it != cacheCoins.end()) {
+        it->second.fRecent = true;
+        stats.nHits++;
         return it;
+    }
+    stats.nMisses++;
     CCoins tmp;
     if (!base->GetCoins(txid, tmp))
         return cacheCoins.end();
-    CCoinsMap::iterator ret = cacheCoins.insert(std::make_pair(txid, CCoinsCacheEntry())).first;
+    CCoinsMap::iterator ret = cacheCoins.emplace(txid, CCoinsCacheEntry()).first;
     tmp.swap(ret->second.coins);
     if (ret->second.coins.IsPruned()) {
         // The parent only has an empty entry for this txid; we can consider our
@@ -98,9 +102,10 @@ bool CCoinsViewCache::GetCoins(const uint256 &txid, CCoins &coins) const {
 
 CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256 &txid) {
     assert(!hasModifier);
-    std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.insert(std::make_pair(txid, CCoinsCacheEntry()));
+    std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.emplace(txid, CCoinsCacheEntry());
     size_t cachedCoinUsage = 0;
     if (ret.second) {
+        stats.nMisses++;
         if (!base->GetCoins(txid, ret.first->second.coins)) {
             // The parent view does not have this entry; mark it as fresh.
             ret.first->second.coins.Clear();
@@ -110,6 +115,8 @@ CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256 &txid) {
             ret.first->second.flags = CCoinsCacheEntry::FRESH;
         }
     } else {
+        stats.nHits++;
+        ret.first->second.fRecent = true;
         cachedCoinUsage = ret.first->second.coins.DynamicMemoryUsage();
     }
     // Assume that whenever ModifyCoins is called, the entry will be modified.
@@ -133,7 +140,7 @@ CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256 &txid) {
  */
 CCoinsModifier CCoinsViewCache::ModifyNewCoins(const uint256 &txid, bool coinbase) {
     assert(!hasModifier);
-    std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.insert(std::make_pair(txid, CCoinsCacheEntry()));
+    std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.emplace(txid, CCoinsCacheEntry());
     if (!coinbase) {
         // New coins must not already exist.
         if (!ret.first->second.coins.IsPruned())
@@ -185,7 +192,7 @@ void CCoinsViewCache::SetBestBlock(const uint256 &hashBlockIn) {
     hashBlock = hashBlockIn;
 }
 
-bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn) {
+bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn, bool fErase) {
     assert(!hasModifier);
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) { // Ignore non-dirty entries (optimization).
@@ -197,7 +204,10 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
                     // Otherwise we will need to create it in the parent
                     // and move the data up and mark it as dirty
                     CCoinsCacheEntry& entry = cacheCoins[it->first];
-                    entry.coins.swap(it->second.coins);
+                    if (fErase)
+                        entry.coins.swap(it->second.coins);
+                    else
+                        entry.coins = it->second.coins;
                     cachedCoinsUsage += entry.coins.DynamicMemoryUsage();
                     entry.flags = CCoinsCacheEntry::DIRTY;
                     // We can mark it FRESH in the parent if it was FRESH in the child
@@ -224,7 +234,10 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
                 } else {
                     // A normal modification.
                     cachedCoinsUsage -= itUs->second.coins.DynamicMemoryUsage();
-                    itUs->second.coins.swap(it->second.coins);
+                    if (fErase)
+                        itUs->second.coins.swap(it->second.coins);
+                    else
+                        itUs->second.coins = it->second.coins;
                     cachedCoinsUsage += itUs->second.coins.DynamicMemoryUsage();
                     itUs->second.flags |= CCoinsCacheEntry::DIRTY;
                     // NOTE: It is possible the child has a FRESH flag here in
@@ -236,16 +249,52 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
             }
         }
         CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        if (fErase)
+            mapCoins.erase(itOld);
     }
     hashBlock = hashBlockIn;
     return true;
 }
 
 bool CCoinsViewCache::Flush() {
-    bool fOk = base->BatchWrite(cacheCoins, hashBlock);
+    bool fOk = base->BatchWrite(cacheCoins, hashBlock, true);
     cacheCoins.clear();
     cachedCoinsUsage = 0;
+    stats.nFlushes++;
+    return fOk;
+}
+
+bool CCoinsViewCache::Sync(size_t nMaxUsage) {
+    assert(!hasModifier);
+    bool fOk = base->BatchWrite(cacheCoins, hashBlock, false);
+    stats.nFlushes++;
+    // Everything is in the base now: pruned entries are useless, and the
+    // others are clean.
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end();) {
+        CCoinsMap::iterator itOld = it++;
+        if (itOld->second.coins.IsPruned()) {
+            cachedCoinsUsage -= itOld->second.coins.DynamicMemoryUsage();
+            cacheCoins.erase(itOld);
+        } else {
+            itOld->second.flags = 0;
+        }
+    }
+    // Evict entries that were not used since the last sync, then, if that is
+    // not enough, any entry. The others get their second chance until the
+    // next sync.
+    for (int nPass = 0; nPass < 2 && DynamicMemoryUsage() > nMaxUsage; nPass++) {
+        for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end() && DynamicMemoryUsage() > nMaxUsage;) {
+            CCoinsMap::iterator itOld = it++;
+            if (nPass == 0 && itOld->second.fRecent)
+                continue;
+            cachedCoinsUsage -= itOld->second.coins.DynamicMemoryUsage();
+            cacheCoins.erase(itOld);
+            stats.nEvicted++;
+        }
+    }
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); ++it)
+        it->second.fRecent = false;
+    stats.nRetained = cacheCoins.size();
     return fOk;
 }
 
@@ -262,6 +311,13 @@ unsigned int CCoinsViewCache::GetCacheSize() const {
     return cacheCoins.size();
 }
 
+void CCoinsViewCache::GetModified(std::vector<std::pair<uint256, bool> > &vModified) const {
+    for (CCoinsMap::const_iterator it = cacheCoins.begin(); it != cacheCoins.end(); ++it) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY)
+            vModified.push_back(std::make_pair(it->first, (it->second.flags & CCoinsCacheEntry::FRESH) != 0));
+    }
+}
+
 const CTxOut &CCoinsViewCache::GetOutputFor(const CTxIn& input) const
 {
     const CCoins* coins = AccessCoins(input.prevout.hash);
@@ -10,6 +10,7 @@
 #include "core_memusage.h"
 #include "hash.h"
 #include "memusage.h"
+#include "pooledmap.h"
 #include "serialize.h"
 #include "uint256.h"
 
@@ -17,7 +18,6 @@
 #include <stdint.h>
 
 #include <boost/foreach.hpp>
-#include <boost/unordered_map.hpp>
 
 /** 
  * Pruned version of CTransaction: only retains metadata and unspent transaction outputs
@@ -276,10 +276,25 @@ struct CCoinsCacheEntry
          */
     };
 
-    CCoinsCacheEntry() : coins(), flags(0) {}
+    //! Whether the entry was created or looked up since the last CCoinsViewCache::Sync
+    bool fRecent;
+
+    CCoinsCacheEntry() : coins(), flags(0), fRecent(true) {}
 };
 
-typedef boost::unordered_map<uint256, CCoinsCacheEntry, SaltedTxidHasher> CCoinsMap;
+/** Counters on the use of a CCoinsViewCache */
+struct CCoinsCacheStats
+{
+    uint64_t nHits;      //!< Lookups answered from the cache
+    uint64_t nMisses;    //!< Lookups passed on to the base view
+    uint64_t nFlushes;   //!< Flush() and Sync() calls
+    uint64_t nEvicted;   //!< Entries evicted by Sync()
+    uint64_t nRetained;  //!< Entries that the last Sync() kept
+
+    CCoinsCacheStats() : nHits(0), nMisses(0), nFlushes(0), nEvicted(0), nRetained(0) {}
+};
+
+typedef pooledmap<uint256, CCoinsCacheEntry, SaltedTxidHasher> CCoinsMap;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -316,8 +331,9 @@ public:
     virtual uint256 GetBestBlock() const;
 
     //! Do a bulk modification (multiple CCoins changes + BestBlock change).
-    //! The passed mapCoins can be modified.
-    virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
+    //! The passed mapCoins can be modified; with fErase, its entries are
+    //! erased (and their data may be moved out), otherwise they are left as is.
+    virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase);
 
     //! Get a cursor to iterate over the whole state
     virtual CCoinsViewCursor *Cursor() const;
@@ -339,7 +355,7 @@ public:
     bool HaveCoins(const uint256 &txid) const;
     uint256 GetBestBlock() const;
     void SetBackend(CCoinsView &viewIn);
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase);
     CCoinsViewCursor *Cursor() const;
 };
 
@@ -384,6 +400,8 @@ protected:
     /* Cached dynamic memory usage for the inner CCoins objects. */
     mutable size_t cachedCoinsUsage;
 
+    mutable CCoinsCacheStats stats;
+
 public:
     CCoinsViewCache(CCoinsView *baseIn);
     ~CCoinsViewCache();
@@ -393,7 +411,7 @@ public:
     bool HaveCoins(const uint256 &txid) const;
     uint256 GetBestBlock() const;
     void SetBestBlock(const uint256 &hashBlock);
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase);
 
     /**
      * Check if we have the given tx already loaded in this cache.
@@ -434,6 +452,15 @@ public:
      */
     bool Flush();
 
+    /**
+     * Push the modifications applied to this cache to its base like Flush(),
+     * but keep the entries, then evict clean ones until the memory usage is
+     * at most nMaxUsage. Entries not accessed since the previous Sync() go
+     * first, in a single CLOCK-like sweep, so that the working set of recent
+     * blocks stays cached.
+     */
+    bool Sync(size_t nMaxUsage);
+
     /**
      * Removes the transaction with the given hash from the cache, if it is
      * not modified.
@@ -443,9 +470,18 @@ public:
     //! Calculate the size of the cache (in number of transactions)
     unsigned int GetCacheSize() const;
 
+    /**
+     * Append the txids of the entries modified in this cache, which have not
+     * been flushed yet, each with whether it is fresh (has no unspent outputs
+     * in the base).
+     */
+    void GetModified(std::vector<std::pair<uint256, bool> > &vModified) const;
+
     //! Calculate the size of the cache (in bytes)
     size_t DynamicMemoryUsage() const;
 
+    const CCoinsCacheStats& GetStats() const { return stats; }
+
     /** 
      * Amount of bitcoins coming in to a transaction
      * Note that lightweight clients may not know anything besides the hash of previous transactions,
@@ -0,0 +1,234 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinstats.h"
+
+#include "coins.h"
+#include "hash.h"
+#include "primitives/transaction.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+namespace {
+
+//! The element of the set for output n of txid
+void SerializeOutput(std::vector<unsigned char> &vch, const uint256 &txid, uint32_t n, const CCoins &coins)
+{
+    vch.clear();
+    CVectorWriter(SER_DISK, PROTOCOL_VERSION, vch, 0, COutPoint(txid, n), (uint32_t)(coins.nHeight * 2 + coins.fCoinBase), coins.vout[n]);
+}
+
+bool SameOutput(const CCoins &a, const CCoins &b, uint32_t n)
+{
+    return a.nHeight == b.nHeight && a.fCoinBase == b.fCoinBase && a.vout[n] == b.vout[n];
+}
+
+} // namespace
+
+void CUTXOCommitment::Add(const uint256 &txid, const CCoins &coins, bool fHash)
+{
+    if (coins.IsPruned())
+        return;
+    std::vector<unsigned char> vch;
+    nTransactions++;
+    for (uint32_t n = 0; n < coins.vout.size(); n++) {
+        if (!coins.IsAvailable(n))
+            continue;
+        if (fHash) {
+            SerializeOutput(vch, txid, n, coins);
+            muhash.Insert(vch.data(), vch.size());
+        }
+        nTransactionOutputs++;
+        nTotalAmount += coins.vout[n].nValue;
+    }
+}
+
+void CUTXOCommitment::Update(const uint256 &txid, const CCoins *pcoinsOld, const CCoins *pcoinsNew)
+{
+    std::vector<unsigned char> vch;
+    const bool fOld = pcoinsOld && !pcoinsOld->IsPruned();
+    const bool fNew = pcoinsNew && !pcoinsNew->IsPruned();
+    nTransactions += (int)fNew - (int)fOld;
+    const size_t nOutputs = std::max(fOld ? pcoinsOld->vout.size() : 0, fNew ? pcoinsNew->vout.size() : 0);
+    for (uint32_t n = 0; n < nOutputs; n++) {
+        const bool fOldOutput = fOld && pcoinsOld->IsAvailable(n);
+        const bool fNewOutput = fNew && pcoinsNew->IsAvailable(n);
+        if (fOldOutput && fNewOutput && SameOutput(*pcoinsOld, *pcoinsNew, n))
+            continue;
+        if (fOldOutput) {
+            SerializeOutput(vch, txid, n, *pcoinsOld);
+            muhash.Remove(vch.data(), vch.size());
+            nTransactionOutputs--;
+            nTotalAmount -= pcoinsOld->vout[n].nValue;
+        }
+        if (fNewOutput) {
+            SerializeOutput(vch, txid, n, *pcoinsNew);
+            muhash.Insert(vch.data(), vch.size());
+            nTransactionOutputs++;
+            nTotalAmount += pcoinsNew->vout[n].nValue;
+        }
+    }
+}
+
+void CUTXOCommitment::Update(const CCoinsViewCache &view, const CCoinsViewCache &base)
+{
+    std::vector<std::pair<uint256, bool> > vModified;
+    view.GetModified(vModified);
+    for (const std::pair<uint256, bool> &modified : vModified) {
+        // Fresh entries need no lookup in the base, which would miss all the way to disk
+        const CCoins *pcoinsOld = modified.second ? NULL : base.AccessCoins(modified.first);
+        Update(modified.first, pcoinsOld, view.AccessCoins(modified.first));
+    }
+    hashBlock = view.GetBestBlock();
+}
+
+CUTXOCommitment& CUTXOCommitment::operator+=(const CUTXOCommitment &other)
+{
+    muhash *= other.muhash;
+    nTransactions += other.nTransactions;
+    nTransactionOutputs += other.nTransactionOutputs;
+    nTotalAmount += other.nTotalAmount;
+    return *this;
+}
+
+uint256 CUTXOCommitment::GetHash() const
+{
+    MuHash3072 tmp(muhash);
+    uint256 hash;
+    tmp.Finalize(hash.begin());
+    return hash;
+}
+
+namespace {
+
+void ScanCoins(CCoinsViewCursor *pcursor, CUTXOCommitment *pcommitment, uint64_t *pnSerializedSize, bool fHash, char *pfSuccess)
+{
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        uint256 key;
+        CCoins coins;
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(coins))
+            return;
+        pcommitment->Add(key, coins, fHash);
+        *pnSerializedSize += 32 + pcursor->GetValueSize();
+        pcursor->Next();
+    }
+    *pfSuccess = true;
+}
+
+//! Scan the coins database with one thread per core, each over its own range of txids
+bool ScanCoinsParallel(const CCoinsViewDB &view, CUTXOCommitment &commitment, uint64_t &nSerializedSize, bool fHash)
+{
+    const int nThreads = std::max(1, std::min(GetNumCores(), 64));
+    std::vector<std::unique_ptr<CCoinsViewCursor> > vCursors = view.PartitionedCursors(nThreads);
+    std::vector<CUTXOCommitment> vCommitments(nThreads);
+    std::vector<uint64_t> vSerializedSizes(nThreads, 0);
+    std::vector<char> vSuccess(nThreads, false);
+
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nThreads; i++)
+        threadGroup.create_thread(boost::bind(&ScanCoins, vCursors[i].get(), &vCommitments[i], &vSerializedSizes[i], fHash, &vSuccess[i]));
+    try {
+        threadGroup.join_all();
+    } catch (const boost::thread_interrupted&) {
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+        throw;
+    }
+
+    commitment = CUTXOCommitment();
+    commitment.hashBlock = vCursors[0]->GetBestBlock();
+    nSerializedSize = 0;
+    for (int i = 0; i < nThreads; i++) {
+        if (!vSuccess[i])
+            return error("%s: unable to read value", __func__);
+        commitment += vCommitments[i];
+        nSerializedSize += vSerializedSizes[i];
+    }
+    return true;
+}
+
+} // namespace
+
+CSerializedUTXOHasher::CSerializedUTXOHasher(const uint256 &hashBlock) : ss(SER_GETHASH, PROTOCOL_VERSION)
+{
+    ss << hashBlock;
+}
+
+void CSerializedUTXOHasher::Add(const uint256 &txid, const CCoins &coins)
+{
+    ss << txid;
+    for (unsigned int i=0; i<coins.vout.size(); i++) {
+        const CTxOut &out = coins.vout[i];
+        if (!out.IsNull()) {
+            ss << VARINT(i+1);
+            ss << out;
+        }
+    }
+    ss << VARINT(0);
+}
+
+uint256 CSerializedUTXOHasher::GetHash()
+{
+    return ss.GetHash();
+}
+
+bool GetUTXOStats(const CCoinsViewDB &view, CCoinsStats &stats, CoinStatsHashType hashType)
+{
+    if (hashType != COINSTATS_HASH_SERIALIZED) {
+        CUTXOCommitment commitment;
+        if (!ScanCoinsParallel(view, commitment, stats.nSerializedSize, hashType == COINSTATS_MUHASH))
+            return false;
+        stats.hashBlock = commitment.hashBlock;
+        stats.nTransactions = commitment.nTransactions;
+        stats.nTransactionOutputs = commitment.nTransactionOutputs;
+        stats.nTotalAmount = commitment.nTotalAmount;
+        if (hashType == COINSTATS_MUHASH)
+            stats.hashMuHash = commitment.GetHash();
+        return true;
+    }
+
+    std::unique_ptr<CCoinsViewCursor> pcursor(view.Cursor());
+
+    stats.hashBlock = pcursor->GetBestBlock();
+    CSerializedUTXOHasher hasher(stats.hashBlock);
+    CAmount nTotalAmount = 0;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        uint256 key;
+        CCoins coins;
+        if (pcursor->GetKey(key) && pcursor->GetValue(coins)) {
+            stats.nTransactions++;
+            hasher.Add(key, coins);
+            for (unsigned int i=0; i<coins.vout.size(); i++) {
+                const CTxOut &out = coins.vout[i];
+                if (!out.IsNull()) {
+                    stats.nTransactionOutputs++;
+                    nTotalAmount += out.nValue;
+                }
+            }
+            stats.nSerializedSize += 32 + pcursor->GetValueSize();
+        } else {
+            return error("%s: unable to read value", __func__);
+        }
+        pcursor->Next();
+    }
+    stats.hashSerialized = hasher.GetHash();
+    stats.nTotalAmount = nTotalAmount;
+    return true;
+}
+
+bool ComputeUTXOCommitment(const CCoinsViewDB &view, CUTXOCommitment &commitment)
+{
+    uint64_t nSerializedSize;
+    return ScanCoinsParallel(view, commitment, nSerializedSize, true);
+}
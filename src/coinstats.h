@@ -0,0 +1,122 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COINSTATS_H
+#define BITCOIN_COINSTATS_H
+
+#include "amount.h"
+#include "crypto/muhash.h"
+#include "hash.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+
+class CCoins;
+class CCoinsViewCache;
+class CCoinsViewDB;
+
+/**
+ * Commitment to a set of unspent outputs: the MuHash of the outputs, each
+ * serialized as its outpoint, height and coinbase flag, and txout, along
+ * with totals. Outputs can be added and removed in any order, so it can be
+ * kept up to date with the UTXO set block by block instead of rescanning it.
+ */
+class CUTXOCommitment
+{
+private:
+    MuHash3072 muhash;
+
+public:
+    //! Block whose UTXO set this commits to
+    uint256 hashBlock;
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    CAmount nTotalAmount;
+
+    CUTXOCommitment() : nTransactions(0), nTransactionOutputs(0), nTotalAmount(0) {}
+
+    //! Add the unspent outputs of a transaction, which must not be in the set yet
+    void Add(const uint256 &txid, const CCoins &coins, bool fHash = true);
+
+    //! Replace the outputs of txid in pcoinsOld (if any) by those in pcoinsNew (if any)
+    void Update(const uint256 &txid, const CCoins *pcoinsOld, const CCoins *pcoinsNew);
+
+    /**
+     * Apply the changes made in view, a cache on top of base (typically, by
+     * connecting or disconnecting a block), before they are flushed to base.
+     */
+    void Update(const CCoinsViewCache &view, const CCoinsViewCache &base);
+
+    //! Add the outputs of another set, disjoint from this one
+    CUTXOCommitment& operator+=(const CUTXOCommitment &other);
+
+    //! The hash of the set (which takes a few tens of milliseconds)
+    uint256 GetHash() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hashBlock);
+        READWRITE(nTransactions);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nTotalAmount);
+        READWRITE(muhash);
+    }
+};
+
+/**
+ * The hash_serialized of gettxoutsetinfo, computed from the transactions of
+ * the UTXO set, which must be added in txid order (as the database holds them).
+ */
+class CSerializedUTXOHasher
+{
+private:
+    CHashWriter ss;
+
+public:
+    explicit CSerializedUTXOHasher(const uint256 &hashBlock);
+
+    void Add(const uint256 &txid, const CCoins &coins);
+    //! The hash of what was added, after which the hasher must not be used anymore
+    uint256 GetHash();
+};
+
+enum CoinStatsHashType {
+    //! SHA256 of the serialized UTXO set, in txid order (sequential)
+    COINSTATS_HASH_SERIALIZED,
+    //! MuHash of the UTXO set, as a CUTXOCommitment (parallel)
+    COINSTATS_MUHASH,
+    //! Only the totals (parallel)
+    COINSTATS_NONE,
+};
+
+struct CCoinsStats
+{
+    int nHeight;
+    uint256 hashBlock;
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    uint64_t nSerializedSize;
+    uint256 hashSerialized;
+    uint256 hashMuHash;
+    CAmount nTotalAmount;
+
+    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
+};
+
+/**
+ * Calculate statistics about the unspent transaction output set, as of a
+ * snapshot of the coins database taken on entry (so the cache must have been
+ * flushed first, but validation can go on meanwhile). Except for
+ * COINSTATS_HASH_SERIALIZED, the database is scanned by one thread per core.
+ * nHeight is left for the caller to fill in.
+ */
+bool GetUTXOStats(const CCoinsViewDB &view, CCoinsStats &stats, CoinStatsHashType hashType);
+
+//! Compute the commitment to the UTXO set in the coins database, by a parallel scan
+bool ComputeUTXOCommitment(const CCoinsViewDB &view, CUTXOCommitment &commitment);
+
+#endif // BITCOIN_COINSTATS_H
@@ -176,6 +176,26 @@ uint256 BlockWitnessMerkleRoot(const CBlock& block, bool* mutated)
     return ComputeMerkleRoot(leaves, mutated);
 }
 
+uint256 BlockMerkleRoot(const CBlockView& block, bool* mutated)
+{
+    std::vector<uint256> leaves;
+    leaves.resize(block.GetTransactionCount());
+    for (size_t s = 0; s < leaves.size(); s++) {
+        leaves[s] = block.GetTxHash(s);
+    }
+    return ComputeMerkleRoot(leaves, mutated);
+}
+
+uint256 BlockWitnessMerkleRoot(const CBlockView& block, bool* mutated)
+{
+    std::vector<uint256> leaves;
+    leaves.resize(block.GetTransactionCount());
+    for (size_t s = 1; s < leaves.size(); s++) {
+        leaves[s] = block.GetWitnessHash(s);
+    }
+    return ComputeMerkleRoot(leaves, mutated);
+}
+
 std::vector<uint256> BlockMerkleBranch(const CBlock& block, uint32_t position)
 {
     std::vector<uint256> leaves;
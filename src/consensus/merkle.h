@@ -10,6 +10,7 @@
 
 #include "primitives/transaction.h"
 #include "primitives/block.h"
+#include "primitives/blockview.h"
 #include "uint256.h"
 
 uint256 ComputeMerkleRoot(const std::vector<uint256>& leaves, bool* mutated = NULL);
@@ -28,6 +29,12 @@ uint256 BlockMerkleRoot(const CBlock& block, bool* mutated = NULL);
  */
 uint256 BlockWitnessMerkleRoot(const CBlock& block, bool* mutated = NULL);
 
+/*
+ * The same for a block view, hashing its transactions in place.
+ */
+uint256 BlockMerkleRoot(const CBlockView& block, bool* mutated = NULL);
+uint256 BlockWitnessMerkleRoot(const CBlockView& block, bool* mutated = NULL);
+
 /*
  * Compute the Merkle branch for the tree of transactions in a block, for a
  * given position.
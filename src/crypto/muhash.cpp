@@ -0,0 +1,163 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "crypto/sha512.h"
+
+#include <string.h>
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; i++)
+        limbs[i] = sizeof(limb_t) == 8 ? ReadLE64(data + 8 * i) : ReadLE32(data + 4 * i);
+}
+
+void Num3072::SetToOne()
+{
+    limbs[0] = 1;
+    memset(limbs + 1, 0, (LIMBS - 1) * sizeof(limbs[0]));
+}
+
+bool Num3072::IsOverflow() const
+{
+    // The modulus is all ones except for its lowest limb, -MAX_PRIME_DIFF
+    if (limbs[0] < (limb_t)(0 - MAX_PRIME_DIFF))
+        return false;
+    for (int i = 1; i < LIMBS; i++) {
+        if (limbs[i] != (limb_t)-1)
+            return false;
+    }
+    return true;
+}
+
+void Num3072::FullReduce()
+{
+    // Subtract the modulus, i.e. add MAX_PRIME_DIFF and drop the 2^3072 bit
+    double_limb_t carry = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS; i++) {
+        carry += limbs[i];
+        limbs[i] = (limb_t)carry;
+        carry >>= LIMB_BITS;
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    // Schoolbook multiplication into 6144 bits
+    limb_t tmp[2 * LIMBS] = {0};
+    for (int i = 0; i < LIMBS; i++) {
+        double_limb_t carry = 0;
+        for (int j = 0; j < LIMBS; j++) {
+            carry += (double_limb_t)limbs[i] * a.limbs[j] + tmp[i + j];
+            tmp[i + j] = (limb_t)carry;
+            carry >>= LIMB_BITS;
+        }
+        tmp[i + LIMBS] = (limb_t)carry;
+    }
+
+    // As 2^3072 = MAX_PRIME_DIFF modulo the prime, fold the upper half onto
+    // the lower one, then what overflows again, until it fits in 3072 bits.
+    double_limb_t carry = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        carry += (double_limb_t)tmp[LIMBS + i] * MAX_PRIME_DIFF + tmp[i];
+        limbs[i] = (limb_t)carry;
+        carry >>= LIMB_BITS;
+    }
+    while (carry) {
+        carry *= MAX_PRIME_DIFF;
+        for (int i = 0; i < LIMBS && carry; i++) {
+            carry += limbs[i];
+            limbs[i] = (limb_t)carry;
+            carry >>= LIMB_BITS;
+        }
+    }
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // By Fermat's little theorem, the inverse is this^(p - 2). All limbs of
+    // p - 2 are ones, except for the lowest.
+    Num3072 result;
+    for (int i = LIMBS - 1; i >= 0; i--) {
+        const limb_t exponent = i > 0 ? (limb_t)-1 : (limb_t)(0 - MAX_PRIME_DIFF - 2);
+        for (int bit = LIMB_BITS - 1; bit >= 0; bit--) {
+            result.Multiply(result);
+            if ((exponent >> bit) & 1)
+                result.Multiply(*this);
+        }
+    }
+    return result;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    Multiply(a.GetInverse());
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE])
+{
+    if (IsOverflow())
+        FullReduce();
+    for (int i = 0; i < LIMBS; i++) {
+        if (sizeof(limb_t) == 8)
+            WriteLE64(out + 8 * i, limbs[i]);
+        else
+            WriteLE32(out + 4 * i, limbs[i]);
+    }
+}
+
+namespace {
+
+Num3072 ToNum3072(const unsigned char* data, size_t len)
+{
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(hash);
+    unsigned char bytes[Num3072::BYTE_SIZE];
+    for (uint32_t i = 0; i < Num3072::BYTE_SIZE / CSHA512::OUTPUT_SIZE; i++) {
+        unsigned char counter[4];
+        WriteLE32(counter, i);
+        CSHA512().Write(hash, sizeof(hash)).Write(counter, sizeof(counter)).Finalize(bytes + i * CSHA512::OUTPUT_SIZE);
+    }
+    return Num3072(bytes);
+}
+
+} // namespace
+
+MuHash3072& MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& other)
+{
+    numerator.Multiply(other.numerator);
+    denominator.Multiply(other.denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& other)
+{
+    numerator.Multiply(other.denominator);
+    denominator.Multiply(other.numerator);
+    return *this;
+}
+
+void MuHash3072::Finalize(unsigned char out[OUTPUT_SIZE])
+{
+    numerator.Divide(denominator);
+    denominator.SetToOne();
+    unsigned char data[Num3072::BYTE_SIZE];
+    numerator.ToBytes(data);
+    CSHA256().Write(data, sizeof(data)).Finalize(out);
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <initializer_list>
+#include <stdint.h>
+#include <stdlib.h>
+
+/** An integer modulo the prime 2^3072 - 1103717, as limbs of the native word size (least significant first). */
+class Num3072
+{
+public:
+#ifdef __SIZEOF_INT128__
+    typedef uint64_t limb_t;
+    __extension__ typedef unsigned __int128 double_limb_t;
+#else
+    typedef uint32_t limb_t;
+    typedef uint64_t double_limb_t;
+#endif
+    static const size_t BYTE_SIZE = 384;
+    static const int LIMB_BITS = sizeof(limb_t) * 8;
+    static const int LIMBS = BYTE_SIZE / sizeof(limb_t);
+    //! 2^3072 minus the modulus
+    static const limb_t MAX_PRIME_DIFF = 1103717;
+
+    limb_t limbs[LIMBS];
+
+    Num3072() { SetToOne(); }
+    //! Read a little-endian number (which may exceed the modulus)
+    explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+
+    void SetToOne();
+    void Multiply(const Num3072& a);
+    //! Multiply by the inverse of a, which is slow (thousands of multiplications)
+    void Divide(const Num3072& a);
+    Num3072 GetInverse() const;
+
+    //! Write as little-endian, after reducing below the modulus
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]);
+
+private:
+    bool IsOverflow() const;
+    void FullReduce();
+};
+
+/**
+ * A hash of a set of byte strings, which can be updated as strings are
+ * inserted and removed, in any order.
+ *
+ * Each element is hashed to an integer modulo a 3072-bit prime, with SHA256
+ * followed by SHA512 in counter mode, and the set hash is the product of
+ * those (MuHash, from "Incremental Multiset Hash Functions and Their
+ * Application to Memory Integrity Checking" by Clarke et al.). Removals
+ * multiply a separate denominator, so that the costly inversion is only done
+ * once, when finalizing. Sets can be combined by multiplying their hashes,
+ * which allows computing the hash of a large set in parallel.
+ */
+class MuHash3072
+{
+private:
+    Num3072 numerator;
+    Num3072 denominator;
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+    static const size_t SERIALIZED_SIZE = 2 * Num3072::BYTE_SIZE;
+
+    //! The hash of the empty set
+    MuHash3072() {}
+
+    MuHash3072& Insert(const unsigned char* data, size_t len);
+    MuHash3072& Remove(const unsigned char* data, size_t len);
+
+    //! Add the elements of another set
+    MuHash3072& operator*=(const MuHash3072& other);
+    //! Remove the elements of another set
+    MuHash3072& operator/=(const MuHash3072& other);
+
+    //! Compute the 32-byte hash of the set, which does not change the set
+    void Finalize(unsigned char out[OUTPUT_SIZE]);
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        unsigned char data[Num3072::BYTE_SIZE];
+        for (const Num3072* num : {&numerator, &denominator}) {
+            Num3072 tmp(*num);
+            tmp.ToBytes(data);
+            s.write((const char*)data, sizeof(data));
+        }
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        unsigned char data[Num3072::BYTE_SIZE];
+        for (Num3072* num : {&numerator, &denominator}) {
+            s.read((char*)data, sizeof(data));
+            *num = Num3072(data);
+        }
+    }
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
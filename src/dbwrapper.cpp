@@ -6,8 +6,10 @@
 
 #include "util.h"
 #include "random.h"
+#include "uint256.h"
 
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
 
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
@@ -73,11 +75,22 @@ public:
     }
 };
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+static leveldb::Options GetOptions(size_t nCacheSize, const CDBProfile& profile)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
+    if (profile.fBulkLoad) {
+        // Most of what is read during a bulk load was just written. Larger write buffers reach
+        // level 0 as fewer, larger files, which leaves less to compact while loading.
+        options.block_cache = leveldb::NewLRUCache(nCacheSize / 4);
+        options.write_buffer_size = nCacheSize * 3 / 8;
+    } else {
+        options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
+        options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
+    }
+    if (profile.fHDD) {
+        // A seek costs about as much as reading a large block, and larger blocks mean fewer of them
+        options.block_size = 64 << 10;
+    }
     options.filter_policy = leveldb::NewBloomFilterPolicy(10);
     options.compression = leveldb::kNoCompression;
     options.max_open_files = 64;
@@ -90,14 +103,14 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const CDBProfile& profile)
 {
     penv = NULL;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, profile);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -109,7 +122,7 @@ CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, b
             dbwrapper_private::HandleError(result);
         }
         TryCreateDirectory(path);
-        LogPrintf("Opening LevelDB in %s\n", path.string());
+        LogPrintf("Opening LevelDB in %s%s%s\n", path.string(), profile.fBulkLoad ? " for a bulk load" : "", profile.fHDD ? " (tuned for HDD)" : "");
     }
     leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
     dbwrapper_private::HandleError(status);
@@ -183,6 +196,36 @@ bool CDBWrapper::IsEmpty()
     return !(it->Valid());
 }
 
+void CDBWrapper::CompactHashed(char prefix) const
+{
+    for (int i = 0; i < 256; i++) {
+        boost::this_thread::interruption_point();
+        // Keys are ordered by the first byte of the serialized hash, after the prefix
+        uint256 hashBegin, hashEnd;
+        *hashBegin.begin() = i;
+        if (i < 255)
+            *hashEnd.begin() = i + 1;
+        CompactRange(std::make_pair(prefix, hashBegin), std::make_pair(i < 255 ? prefix : (char)(prefix + 1), hashEnd));
+    }
+}
+
+CDBSnapshot::CDBSnapshot(const CDBWrapper &_parent) : parent(_parent)
+{
+    psnapshot = parent.pdb->GetSnapshot();
+}
+
+CDBSnapshot::~CDBSnapshot()
+{
+    parent.pdb->ReleaseSnapshot(psnapshot);
+}
+
+CDBIterator *CDBSnapshot::NewIterator() const
+{
+    leveldb::ReadOptions options = parent.iteroptions;
+    options.snapshot = psnapshot;
+    return new CDBIterator(parent, parent.pdb->NewIterator(options));
+}
+
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
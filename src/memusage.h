@@ -6,6 +6,7 @@
 #define BITCOIN_MEMUSAGE_H
 
 #include "indirectmap.h"
+#include "pooledmap.h"
 
 #include <stdlib.h>
 
@@ -131,6 +132,14 @@ static inline size_t IncrementalDynamicUsage(const indirectmap<X, Y>& m)
     return MallocUsage(sizeof(stl_tree_node<std::pair<const X*, Y> >));
 }
 
+// pooledmap takes one pool block per entry, without malloc overhead, and a slot array
+
+template<typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const pooledmap<X, Y, Z>& m)
+{
+    return pooledmap<X, Y, Z>::ENTRY_SIZE * m.size() + MallocUsage(pooledmap<X, Y, Z>::SLOT_SIZE * m.bucket_count());
+}
+
 template<typename X>
 static inline size_t DynamicUsage(const std::unique_ptr<X>& p)
 {
@@ -0,0 +1,260 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_POOLEDMAP_H
+#define BITCOIN_POOLEDMAP_H
+
+#include "support/allocators/pool.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stddef.h>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/* Hash map using open addressing over a flat array of slots, with its
+ * entries allocated from a FixedSizePool.
+ *
+ * Each slot holds the full hash of its key next to a pointer to the entry, so
+ * a lookup is a linear scan of adjacent slots, which only dereferences the
+ * entry whose hash matches (and a miss usually touches a single cache line).
+ * Entries themselves never move: like with std::unordered_map, pointers and
+ * references to them stay valid until they are erased, while iterators are
+ * invalidated when an insertion grows the table. Erasing leaves a marker in
+ * the slot, so it does not invalidate iterators either, and markers are
+ * cleared whenever the table is rebuilt.
+ *
+ * The subset of the std::unordered_map interface implemented is the one
+ * needed by the coins cache and the block index.
+ */
+template <class K, class T, class Hash>
+class pooledmap {
+public:
+    typedef K key_type;
+    typedef T mapped_type;
+    typedef std::pair<const K, T> value_type;
+    typedef size_t size_type;
+
+    /** Bytes taken per entry, in the pool */
+    static const size_t ENTRY_SIZE = FixedSizePool<sizeof(value_type)>::ALLOCATION_SIZE;
+
+private:
+    struct Slot {
+        value_type* entry;
+        //! Hash of the entry's key; for slots without an entry, whether one was erased from it
+        size_t hash;
+
+        Slot() : entry(NULL), hash(0) {}
+        bool IsErased() const { return !entry && hash; }
+    };
+
+    std::vector<Slot> vSlots;
+    size_t nSize;
+    size_t nErased;
+    Hash hasher;
+    pool_allocator<value_type> allocator;
+
+    //! Slot holding key, or NULL
+    Slot* Lookup(const K& key, size_t hash) const
+    {
+        if (vSlots.empty())
+            return NULL;
+        const size_t nMask = vSlots.size() - 1;
+        for (size_t i = hash & nMask; ; i = (i + 1) & nMask) {
+            const Slot& slot = vSlots[i];
+            if (slot.entry) {
+                if (slot.hash == hash && slot.entry->first == key)
+                    return const_cast<Slot*>(&slot);
+            } else if (!slot.IsErased()) {
+                return NULL;
+            }
+        }
+    }
+
+    //! Rebuild the table, dropping erased markers and growing it if it is more than half full (or would be with nEntries)
+    void Rebuild(size_t nEntries = 0)
+    {
+        size_t nCapacity = vSlots.empty() ? 16 : vSlots.size();
+        while ((std::max(nSize, nEntries) + 1) * 2 > nCapacity)
+            nCapacity *= 2;
+        std::vector<Slot> vOld(nCapacity);
+        vOld.swap(vSlots);
+        const size_t nMask = vSlots.size() - 1;
+        for (const Slot& slot : vOld) {
+            if (!slot.entry)
+                continue;
+            size_t i = slot.hash & nMask;
+            while (vSlots[i].entry)
+                i = (i + 1) & nMask;
+            vSlots[i] = slot;
+        }
+        nErased = 0;
+    }
+
+    void Destroy(value_type* entry)
+    {
+        entry->~value_type();
+        allocator.deallocate(entry, 1);
+    }
+
+    pooledmap(const pooledmap&);
+    pooledmap& operator=(const pooledmap&);
+
+public:
+    /** Bytes taken per slot of the table */
+    static const size_t SLOT_SIZE = sizeof(Slot);
+
+    template <bool IS_CONST>
+    class iterator_impl : public std::iterator<std::forward_iterator_tag, value_type> {
+    private:
+        friend class pooledmap;
+        typedef typename std::conditional<IS_CONST, const Slot*, Slot*>::type slot_pointer;
+        slot_pointer pos;
+        slot_pointer end;
+
+        void Skip()
+        {
+            while (pos != end && !pos->entry)
+                ++pos;
+        }
+
+    public:
+        typedef typename std::conditional<IS_CONST, const value_type&, value_type&>::type reference;
+        typedef typename std::conditional<IS_CONST, const value_type*, value_type*>::type pointer;
+
+        iterator_impl() : pos(NULL), end(NULL) {}
+        iterator_impl(slot_pointer posIn, slot_pointer endIn) : pos(posIn), end(endIn) { Skip(); }
+        // Allow converting an iterator to a const_iterator
+        iterator_impl(const iterator_impl<false>& other) : pos(other.pos), end(other.end) {}
+
+        reference operator*() const { return *pos->entry; }
+        pointer operator->() const { return pos->entry; }
+        iterator_impl& operator++() { ++pos; Skip(); return *this; }
+        iterator_impl operator++(int) { iterator_impl copy(*this); ++(*this); return copy; }
+        friend bool operator==(const iterator_impl& a, const iterator_impl& b) { return a.pos == b.pos; }
+        friend bool operator!=(const iterator_impl& a, const iterator_impl& b) { return a.pos != b.pos; }
+
+        template <bool> friend class iterator_impl;
+    };
+    typedef iterator_impl<false> iterator;
+    typedef iterator_impl<true> const_iterator;
+
+    pooledmap() : nSize(0), nErased(0) {}
+    ~pooledmap() { clear(); }
+
+    iterator begin() { return iterator(vSlots.data(), vSlots.data() + vSlots.size()); }
+    iterator end() { return iterator(vSlots.data() + vSlots.size(), vSlots.data() + vSlots.size()); }
+    const_iterator begin() const { return const_iterator(vSlots.data(), vSlots.data() + vSlots.size()); }
+    const_iterator end() const { return const_iterator(vSlots.data() + vSlots.size(), vSlots.data() + vSlots.size()); }
+
+    bool empty() const { return nSize == 0; }
+    size_type size() const { return nSize; }
+    size_type bucket_count() const { return vSlots.size(); }
+
+    iterator find(const K& key)
+    {
+        Slot* slot = Lookup(key, hasher(key));
+        return slot ? iterator(slot, vSlots.data() + vSlots.size()) : end();
+    }
+
+    const_iterator find(const K& key) const
+    {
+        const Slot* slot = Lookup(key, hasher(key));
+        return slot ? const_iterator(slot, vSlots.data() + vSlots.size()) : end();
+    }
+
+    size_type count(const K& key) const { return Lookup(key, hasher(key)) ? 1 : 0; }
+
+    T& at(const K& key)
+    {
+        Slot* slot = Lookup(key, hasher(key));
+        if (!slot)
+            throw std::out_of_range("pooledmap::at");
+        return slot->entry->second;
+    }
+
+    const T& at(const K& key) const
+    {
+        const Slot* slot = Lookup(key, hasher(key));
+        if (!slot)
+            throw std::out_of_range("pooledmap::at");
+        return slot->entry->second;
+    }
+
+    /** Make room for n entries, so that inserting them does not rebuild the table */
+    void reserve(size_type n)
+    {
+        if ((n + 1) * 2 > vSlots.size())
+            Rebuild(n);
+    }
+
+    /** Insert (key, value) if there is no entry for key yet */
+    template <typename V>
+    std::pair<iterator, bool> emplace(const K& key, V&& value)
+    {
+        const size_t hash = hasher(key);
+        Slot* slot = Lookup(key, hash);
+        if (slot)
+            return std::make_pair(iterator(slot, vSlots.data() + vSlots.size()), false);
+
+        if ((nSize + nErased + 1) * 4 > vSlots.size() * 3)
+            Rebuild();
+        const size_t nMask = vSlots.size() - 1;
+        size_t i = hash & nMask;
+        while (vSlots[i].entry)
+            i = (i + 1) & nMask;
+        slot = &vSlots[i];
+        value_type* entry = allocator.allocate(1);
+        try {
+            new (entry) value_type(key, std::forward<V>(value));
+        } catch (...) {
+            allocator.deallocate(entry, 1);
+            throw;
+        }
+        if (slot->IsErased())
+            nErased--;
+        slot->entry = entry;
+        slot->hash = hash;
+        nSize++;
+        return std::make_pair(iterator(slot, vSlots.data() + vSlots.size()), true);
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) { return emplace(value.first, value.second); }
+
+    T& operator[](const K& key) { return emplace(key, T()).first->second; }
+
+    void erase(const_iterator it)
+    {
+        Slot* slot = const_cast<Slot*>(it.pos);
+        Destroy(slot->entry);
+        slot->entry = NULL;
+        slot->hash = 1;
+        nSize--;
+        nErased++;
+    }
+
+    size_type erase(const K& key)
+    {
+        Slot* slot = Lookup(key, hasher(key));
+        if (!slot)
+            return 0;
+        erase(const_iterator(slot, vSlots.data() + vSlots.size()));
+        return 1;
+    }
+
+    /** Erase all entries and release the table */
+    void clear()
+    {
+        for (Slot& slot : vSlots) {
+            if (slot.entry)
+                Destroy(slot.entry);
+        }
+        std::vector<Slot>().swap(vSlots);
+        nSize = 0;
+        nErased = 0;
+    }
+};
+
+#endif // BITCOIN_POOLEDMAP_H
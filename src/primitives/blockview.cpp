@@ -0,0 +1,162 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "primitives/blockview.h"
+
+#include "hash.h"
+#include "streams.h"
+#include "version.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+void SkipVector(CSpanReader& s)
+{
+    s.ignore(ReadCompactSize(s));
+}
+
+} // namespace
+
+void CBlockView::SetNull()
+{
+    buffer.reset();
+    header.SetNull();
+    vTxRanges.clear();
+    vtxCache.clear();
+}
+
+bool CBlockView::Parse(const Buffer& bufferIn)
+{
+    SetNull();
+    if (!bufferIn || bufferIn->size() > std::numeric_limits<uint32_t>::max())
+        return false;
+
+    // Walk the serialization the same way UnserializeTransaction does, but
+    // only note where things are.
+    const unsigned char* pbegin = bufferIn->data();
+    CSpanReader s(SER_NETWORK, PROTOCOL_VERSION, pbegin, pbegin + bufferIn->size());
+    try {
+        s >> header;
+        uint64_t nTx = ReadCompactSize(s);
+        // The smallest transaction takes 10 bytes; don't trust nTx further
+        vTxRanges.reserve(std::min<uint64_t>(nTx, s.size() / 10));
+        for (uint64_t i = 0; i < nTx; i++) {
+            TxRange range;
+            range.nBegin = s.data() - pbegin;
+            range.fExtended = false;
+            range.fHasWitness = false;
+            s.ignore(4); // nVersion
+            range.nInOutBegin = s.data() - pbegin;
+            uint64_t nInputs = ReadCompactSize(s);
+            bool fOutputs = true;
+            if (nInputs == 0) {
+                unsigned char flags;
+                s >> flags;
+                if (flags == 1) {
+                    range.fExtended = true;
+                    range.nInOutBegin = s.data() - pbegin;
+                    nInputs = ReadCompactSize(s);
+                } else if (flags == 0) {
+                    // An empty vin, not followed by a vout
+                    fOutputs = false;
+                } else {
+                    throw std::ios_base::failure("Unknown transaction optional data");
+                }
+            }
+            for (uint64_t j = 0; j < nInputs; j++) {
+                s.ignore(36); // prevout
+                SkipVector(s); // scriptSig
+                s.ignore(4); // nSequence
+            }
+            if (fOutputs) {
+                uint64_t nOutputs = ReadCompactSize(s);
+                for (uint64_t j = 0; j < nOutputs; j++) {
+                    s.ignore(8); // nValue
+                    SkipVector(s); // scriptPubKey
+                }
+            }
+            range.nInOutEnd = s.data() - pbegin;
+            if (range.fExtended) {
+                for (uint64_t j = 0; j < nInputs; j++) {
+                    uint64_t nItems = ReadCompactSize(s);
+                    if (nItems > 0)
+                        range.fHasWitness = true;
+                    for (uint64_t k = 0; k < nItems; k++)
+                        SkipVector(s);
+                }
+            }
+            s.ignore(4); // nLockTime
+            range.nEnd = s.data() - pbegin;
+            vTxRanges.push_back(range);
+        }
+    } catch (const std::ios_base::failure&) {
+        SetNull();
+        return false;
+    }
+    if (!s.empty()) {
+        SetNull();
+        return false;
+    }
+    buffer = bufferIn;
+    return true;
+}
+
+bool CBlockView::HasWitness() const
+{
+    for (const TxRange& range : vTxRanges) {
+        if (range.fHasWitness)
+            return true;
+    }
+    return false;
+}
+
+uint256 CBlockView::GetTxHash(size_t nIndex) const
+{
+    const TxRange& range = vTxRanges[nIndex];
+    CHash256 hasher;
+    if (range.fExtended) {
+        hasher.Write(Begin() + range.nBegin, 4);
+        hasher.Write(Begin() + range.nInOutBegin, range.nInOutEnd - range.nInOutBegin);
+        hasher.Write(Begin() + range.nEnd - 4, 4);
+    } else {
+        hasher.Write(Begin() + range.nBegin, range.nEnd - range.nBegin);
+    }
+    uint256 hash;
+    hasher.Finalize(hash.begin());
+    return hash;
+}
+
+uint256 CBlockView::GetWitnessHash(size_t nIndex) const
+{
+    const TxRange& range = vTxRanges[nIndex];
+    if (!range.fHasWitness)
+        return GetTxHash(nIndex);
+    uint256 hash;
+    CHash256().Write(Begin() + range.nBegin, range.nEnd - range.nBegin).Finalize(hash.begin());
+    return hash;
+}
+
+CTransactionRef CBlockView::GetTransaction(size_t nIndex) const
+{
+    if (vtxCache.empty())
+        vtxCache.resize(vTxRanges.size());
+    CTransactionRef& tx = vtxCache[nIndex];
+    if (!tx) {
+        const TxRange& range = vTxRanges[nIndex];
+        CSpanReader s(SER_NETWORK, PROTOCOL_VERSION, Begin() + range.nBegin, Begin() + range.nEnd);
+        s >> tx;
+    }
+    return tx;
+}
+
+void CBlockView::GetBlock(CBlock& block) const
+{
+    block.SetNull();
+    *(CBlockHeader*)&block = header;
+    block.vtx.reserve(vTxRanges.size());
+    for (size_t i = 0; i < vTxRanges.size(); i++)
+        block.vtx.push_back(GetTransaction(i));
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_PRIMITIVES_BLOCKVIEW_H
+#define BITCOIN_PRIMITIVES_BLOCKVIEW_H
+
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "uint256.h"
+
+#include <assert.h>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Read-only view of a serialized block (in the network and disk format,
+ * including witnesses), for code that only needs to hash, check or relay it.
+ *
+ * Parsing a block into a view decodes its header and records where each
+ * transaction, and each transaction's inputs and outputs, start and end in the
+ * buffer, instead of allocating every CTransaction, CTxIn, CTxOut and CScript
+ * of the block. Transaction hashes are computed straight from those ranges, so
+ * checking the merkle roots takes no allocations beyond the list of leaves,
+ * and the block can be reserialized, with or without witnesses, by copying
+ * them. A CTransaction is only materialized when asked for one.
+ *
+ * The buffer is shared: it stays alive for as long as any view of it does.
+ * Views are not safe to use from several threads at once, as transactions are
+ * materialized into a cache on demand.
+ */
+class CBlockView
+{
+public:
+    typedef std::shared_ptr<const std::vector<unsigned char> > Buffer;
+
+private:
+    /** Offsets into the buffer of a serialized transaction */
+    struct TxRange
+    {
+        uint32_t nBegin;
+        //! Inputs and outputs, which together with the version and lock time
+        //! make up the serialization without witnesses
+        uint32_t nInOutBegin;
+        uint32_t nInOutEnd;
+        uint32_t nEnd;
+        //! The serialization has the extended format, with a witness section
+        bool fExtended;
+        //! Any input has a non-empty witness
+        bool fHasWitness;
+    };
+
+    Buffer buffer;
+    CBlockHeader header;
+    std::vector<TxRange> vTxRanges;
+    mutable std::vector<CTransactionRef> vtxCache;
+
+    const unsigned char* Begin() const { return buffer->data(); }
+    template <typename Stream>
+    void WriteRange(Stream& s, uint32_t nBegin, uint32_t nEnd) const
+    {
+        s.write((const char*)Begin() + nBegin, nEnd - nBegin);
+    }
+
+public:
+    CBlockView() {}
+
+    /**
+     * Parse the block serialized in bufferIn, which has to hold exactly one
+     * block. Returns false, leaving the view empty, if it is malformed, i.e.
+     * if deserializing it as a CBlock would fail.
+     */
+    bool Parse(const Buffer& bufferIn);
+
+    bool IsNull() const { return !buffer; }
+    void SetNull();
+
+    const Buffer& GetBuffer() const { return buffer; }
+    const CBlockHeader& GetHeader() const { return header; }
+    uint256 GetHash() const { return header.GetHash(); }
+
+    size_t GetTransactionCount() const { return vTxRanges.size(); }
+    //! Whether any transaction in the block has witness data
+    bool HasWitness() const;
+    uint256 GetTxHash(size_t nIndex) const;
+    uint256 GetWitnessHash(size_t nIndex) const;
+    /** The transaction at nIndex, deserialized the first time it is asked for */
+    CTransactionRef GetTransaction(size_t nIndex) const;
+    /** Deserialize the whole block */
+    void GetBlock(CBlock& block) const;
+
+    /**
+     * Serialize the block as CBlock would (omitting witnesses if the stream
+     * version has SERIALIZE_TRANSACTION_NO_WITNESS), by copying the ranges of
+     * the buffer it consists of.
+     */
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        assert(!IsNull());
+        const bool fAllowWitness = !(s.GetVersion() & SERIALIZE_TRANSACTION_NO_WITNESS);
+        // Header and transaction count
+        WriteRange(s, 0, vTxRanges.empty() ? buffer->size() : vTxRanges[0].nBegin);
+        for (const TxRange& range : vTxRanges) {
+            if (!range.fExtended || (fAllowWitness && range.fHasWitness)) {
+                WriteRange(s, range.nBegin, range.nEnd);
+            } else {
+                // Version, inputs and outputs, and lock time
+                WriteRange(s, range.nBegin, range.nBegin + 4);
+                WriteRange(s, range.nInOutBegin, range.nInOutEnd);
+                WriteRange(s, range.nEnd - 4, range.nEnd);
+            }
+        }
+    }
+};
+
+#endif // BITCOIN_PRIMITIVES_BLOCKVIEW_H
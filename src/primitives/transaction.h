@@ -9,6 +9,7 @@
 #include "amount.h"
 #include "script/script.h"
 #include "serialize.h"
+#include "support/allocators/pool.h"
 #include "uint256.h"
 
 static const int SERIALIZE_TRANSACTION_NO_WITNESS = 0x40000000;
@@ -444,9 +445,15 @@ struct CMutableTransaction
     }
 };
 
+/**
+ * Transactions are shared through reference counted pointers, which are
+ * allocated (together with their count) from a pool rather than the heap, as
+ * thousands of them come and go with every block.
+ */
 typedef std::shared_ptr<const CTransaction> CTransactionRef;
-static inline CTransactionRef MakeTransactionRef() { return std::make_shared<const CTransaction>(); }
-template <typename Tx> static inline CTransactionRef MakeTransactionRef(Tx&& txIn) { return std::make_shared<const CTransaction>(std::forward<Tx>(txIn)); }
+template<> struct SharedPtrAllocator<CTransaction> { typedef pool_allocator<CTransaction> type; };
+static inline CTransactionRef MakeTransactionRef() { return std::allocate_shared<const CTransaction>(pool_allocator<CTransaction>()); }
+template <typename Tx> static inline CTransactionRef MakeTransactionRef(Tx&& txIn) { return std::allocate_shared<const CTransaction>(pool_allocator<CTransaction>(), std::forward<Tx>(txIn)); }
 
 /** Compute the weight of a transaction, as defined by BIP 141 */
 int64_t GetTransactionWeight(const CTransaction &tx);
@@ -8,6 +8,7 @@
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "coins.h"
+#include "coinstats.h"
 #include "consensus/validation.h"
 #include "validation.h"
 #include "policy/policy.h"
@@ -15,15 +16,18 @@
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
+#include "txdb.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "utxosnapshot.h"
 #include "hash.h"
 
 #include <stdint.h>
 
 #include <univalue.h>
 
+#include <boost/filesystem.hpp>
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
 #include <mutex>
@@ -765,60 +769,6 @@ UniValue getblock(const JSONRPCRequest& request)
     return blockToJSON(block, pblockindex);
 }
 
-struct CCoinsStats
-{
-    int nHeight;
-    uint256 hashBlock;
-    uint64_t nTransactions;
-    uint64_t nTransactionOutputs;
-    uint64_t nSerializedSize;
-    uint256 hashSerialized;
-    CAmount nTotalAmount;
-
-    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
-};
-
-//! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
-{
-    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
-
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = pcursor->GetBestBlock();
-    {
-        LOCK(cs_main);
-        stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
-    }
-    ss << stats.hashBlock;
-    CAmount nTotalAmount = 0;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        uint256 key;
-        CCoins coins;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coins)) {
-            stats.nTransactions++;
-            ss << key;
-            for (unsigned int i=0; i<coins.vout.size(); i++) {
-                const CTxOut &out = coins.vout[i];
-                if (!out.IsNull()) {
-                    stats.nTransactionOutputs++;
-                    ss << VARINT(i+1);
-                    ss << out;
-                    nTotalAmount += out.nValue;
-                }
-            }
-            stats.nSerializedSize += 32 + pcursor->GetValueSize();
-            ss << VARINT(0);
-        } else {
-            return error("%s: unable to read value", __func__);
-        }
-        pcursor->Next();
-    }
-    stats.hashSerialized = ss.GetHash();
-    stats.nTotalAmount = nTotalAmount;
-    return true;
-}
-
 UniValue pruneblockchain(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -870,44 +820,171 @@ UniValue pruneblockchain(const JSONRPCRequest& request)
 
 UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 1)
         throw std::runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Note this call may take some time, except for hash_type \"muhash\" when the node runs with -utxocommitment.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"  (string, optional, default=\"hash_serialized\") Which UTXO set hash to calculate:\n"
+            "                 \"hash_serialized\" (in txid order, on a single thread), \"muhash\" (a set hash,\n"
+            "                 on all cores) or \"none\" (only the totals, on all cores)\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
             "  \"transactions\": n,      (numeric) The number of transactions\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
-            "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"bytes_serialized\": n,  (numeric) The serialized size (omitted when read from the UTXO set commitment)\n"
+            "  \"hash_serialized\": \"hash\",   (string) The serialized hash (only for hash_type \"hash_serialized\")\n"
+            "  \"muhash\": \"hash\",     (string) The MuHash of the outputs (only for hash_type \"muhash\")\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"muhash\"")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
+    CoinStatsHashType hashType = COINSTATS_HASH_SERIALIZED;
+    if (request.params.size() > 0 && !request.params[0].isNull()) {
+        const std::string strHashType = request.params[0].get_str();
+        if (strHashType == "muhash")
+            hashType = COINSTATS_MUHASH;
+        else if (strHashType == "none")
+            hashType = COINSTATS_NONE;
+        else if (strHashType != "hash_serialized")
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid hash_type: " + strHashType);
+    }
+
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
-    FlushStateToDisk();
-    if (GetUTXOStats(pcoinsTip, stats)) {
-        ret.push_back(Pair("height", (int64_t)stats.nHeight));
-        ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
-        ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
-        ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
+    bool fFromCommitment = false;
+    if (hashType == COINSTATS_MUHASH) {
+        // The commitment kept up to date with the tip needs no scan at all
+        CUTXOCommitment commitment;
+        {
+            LOCK(cs_main);
+            if (pUTXOCommitment) {
+                commitment = *pUTXOCommitment;
+                fFromCommitment = true;
+            }
+        }
+        if (fFromCommitment) {
+            stats.hashBlock = commitment.hashBlock;
+            stats.nTransactions = commitment.nTransactions;
+            stats.nTransactionOutputs = commitment.nTransactionOutputs;
+            stats.nTotalAmount = commitment.nTotalAmount;
+            stats.hashMuHash = commitment.GetHash();
+        }
+    }
+    if (!fFromCommitment) {
+        // Only the flush needs cs_main: the scan reads a snapshot of the database
+        FlushStateToDisk();
+        if (!GetUTXOStats(*pcoinsdbview, stats, hashType))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+    }
+    {
+        LOCK(cs_main);
+        stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
+    }
+
+    ret.push_back(Pair("height", (int64_t)stats.nHeight));
+    ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
+    ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
+    ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
+    if (!fFromCommitment)
         ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
+    if (hashType == COINSTATS_HASH_SERIALIZED)
         ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
-        ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
-    } else {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
-    }
+    if (hashType == COINSTATS_MUHASH)
+        ret.push_back(Pair("muhash", stats.hashMuHash.GetHex()));
+    ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+    return ret;
+}
+
+static UniValue SnapshotInfoToJSON(const CUTXOSnapshotInfo& info, const boost::filesystem::path& path)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins_written", (int64_t)info.nTransactions));
+    ret.push_back(Pair("base_hash", info.hashBlock.GetHex()));
+    ret.push_back(Pair("base_height", info.nHeight));
+    ret.push_back(Pair("path", path.string()));
+    ret.push_back(Pair("hash_serialized", info.hashSerialized.GetHex()));
     return ret;
 }
 
+UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrite the UTXO set, along with the block headers up to the tip, to a snapshot file\n"
+            "which another node can load with loadtxoutset instead of validating the blocks itself.\n"
+            "\nArguments:\n"
+            "1. \"path\"       (string, required) Path of the new file, absolute or relative to the data directory\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,        (numeric) The number of transactions with unspent outputs written\n"
+            "  \"base_hash\": \"hash\",      (string) The hash of the block whose UTXO set was written\n"
+            "  \"base_height\": n,          (numeric) The height of that block\n"
+            "  \"path\": \"path\",           (string) The absolute path of the file\n"
+            "  \"hash_serialized\": \"hash\" (string) The hash_serialized of gettxoutsetinfo for that UTXO set\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    const boost::filesystem::path path = boost::filesystem::absolute(request.params[0].get_str(), GetDataDir());
+
+    // As for gettxoutsetinfo, the file is written from a snapshot of the database
+    FlushStateToDisk();
+    CUTXOSnapshotInfo info;
+    std::string strError;
+    if (!DumpUTXOSnapshot(*pcoinsdbview, path, info, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    return SnapshotInfoToJSON(info, path);
+}
+
+UniValue loadtxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "loadtxoutset \"path\" ( \"hash_serialized\" )\n"
+            "\nReplace the chain state of a new node by a snapshot written by dumptxoutset, after which it\n"
+            "continues from the block of the snapshot. The node must run with -prune and be at the genesis block.\n"
+            "Blocks up to the snapshot are neither downloaded nor validated: the UTXO set is trusted as is,\n"
+            "so the hash_serialized should be checked against a trusted node.\n"
+            "\nArguments:\n"
+            "1. \"path\"            (string, required) Path of the file, absolute or relative to the data directory\n"
+            "2. \"hash_serialized\" (string, optional) The expected hash_serialized of the UTXO set\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,        (numeric) The number of transactions with unspent outputs loaded\n"
+            "  \"base_hash\": \"hash\",      (string) The hash of the block whose UTXO set was loaded\n"
+            "  \"base_height\": n,          (numeric) The height of that block\n"
+            "  \"path\": \"path\",           (string) The absolute path of the file\n"
+            "  \"hash_serialized\": \"hash\" (string) The hash_serialized of gettxoutsetinfo for that UTXO set\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("loadtxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("loadtxoutset", "\"utxo.dat\"")
+        );
+
+    const boost::filesystem::path path = boost::filesystem::absolute(request.params[0].get_str(), GetDataDir());
+    uint256 hashExpected;
+    if (request.params.size() > 1 && !request.params[1].isNull())
+        hashExpected = ParseHashV(request.params[1], "hash_serialized");
+
+    CUTXOSnapshotInfo info;
+    std::string strError;
+    if (!LoadUTXOSnapshot(Params(), path, hashExpected, info, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    return SnapshotInfoToJSON(info, path);
+}
+
 UniValue gettxout(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
@@ -1272,6 +1349,44 @@ UniValue getchaintips(const JSONRPCRequest& request)
     return res;
 }
 
+UniValue getcoinscacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getcoinscacheinfo\n"
+            "\nReturns statistics about the in-memory cache of the unspent transaction output set.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"transactions\": n,     (numeric) The number of transactions in the cache\n"
+            "  \"usage\": n,            (numeric) Memory usage of the cache, in bytes\n"
+            "  \"maxusage\": n,         (numeric) Usage above which the cache is flushed, when the mempool is full\n"
+            "  \"retain\": n,           (numeric) Percentage of the limit kept after flushing a full cache (see -dbcacheretain)\n"
+            "  \"hits\": n,             (numeric) Lookups answered from the cache since startup\n"
+            "  \"misses\": n,           (numeric) Lookups that had to read the database since startup\n"
+            "  \"flushes\": n,          (numeric) Number of times the cache was written to the database\n"
+            "  \"evicted\": n,          (numeric) Transactions evicted from the cache while keeping it warm\n"
+            "  \"retained\": n          (numeric) Transactions the last flush kept in the cache\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getcoinscacheinfo", "")
+            + HelpExampleRpc("getcoinscacheinfo", "")
+        );
+
+    LOCK(cs_main);
+    const CCoinsCacheStats& stats = pcoinsTip->GetStats();
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("transactions", (int64_t)pcoinsTip->GetCacheSize()));
+    ret.push_back(Pair("usage", (int64_t)pcoinsTip->DynamicMemoryUsage()));
+    ret.push_back(Pair("maxusage", (int64_t)nCoinCacheUsage));
+    ret.push_back(Pair("retain", nCoinCacheRetain));
+    ret.push_back(Pair("hits", (int64_t)stats.nHits));
+    ret.push_back(Pair("misses", (int64_t)stats.nMisses));
+    ret.push_back(Pair("flushes", (int64_t)stats.nFlushes));
+    ret.push_back(Pair("evicted", (int64_t)stats.nEvicted));
+    ret.push_back(Pair("retained", (int64_t)stats.nRetained));
+    return ret;
+}
+
 UniValue mempoolInfoToJSON()
 {
     UniValue ret(UniValue::VOBJ);
@@ -1430,6 +1545,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getblockhash",           &getblockhash,           true,  {"height"} },
     { "blockchain",         "getblockheader",         &getblockheader,         true,  {"blockhash","verbose"} },
     { "blockchain",         "getchaintips",           &getchaintips,           true,  {} },
+    { "blockchain",         "getcoinscacheinfo",      &getcoinscacheinfo,      true,  {} },
     { "blockchain",         "getdifficulty",          &getdifficulty,          true,  {} },
     { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    true,  {"txid","verbose"} },
     { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  true,  {"txid","verbose"} },
@@ -1437,7 +1553,9 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,  {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          true,  {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               true,  {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {"hash_type"} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           true,  {"path"} },
+    { "blockchain",         "loadtxoutset",           &loadtxoutset,           true,  {"path","hash_serialized"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        true,  {"height"} },
     { "blockchain",         "verifychain",            &verifychain,            true,  {"checklevel","nblocks"} },
 
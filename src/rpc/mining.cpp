@@ -141,6 +141,8 @@ UniValue generateBlocks(boost::shared_ptr<CReserveScript> coinbaseScript, int nG
             coinbaseScript->KeepScript();
         }
     }
+    // Let listeners such as the wallet catch up with the new blocks before returning
+    SyncWithValidationInterfaceQueue();
     return blockHashes;
 }
 
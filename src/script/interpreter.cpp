@@ -11,6 +11,7 @@
 #include "crypto/sha256.h"
 #include "pubkey.h"
 #include "script/script.h"
+#include "streams.h"
 #include "uint256.h"
 
 typedef std::vector<unsigned char> valtype;
@@ -54,13 +55,108 @@ bool CastToBool(const valtype& vch)
  */
 #define stacktop(i)  (stack.at(stack.size()+(i)))
 #define altstacktop(i)  (altstack.at(altstack.size()+(i)))
-static inline void popstack(std::vector<valtype>& stack)
+static inline void popstack(std::vector<valtype>& stack, ScriptExecutionArena* arena = NULL)
 {
     if (stack.empty())
         throw std::runtime_error("popstack(): stack empty");
+    if (arena)
+        arena->Pop(stack);
+    else
+        stack.pop_back();
+}
+
+static inline void pushstack(std::vector<valtype>& stack, const valtype& vch, ScriptExecutionArena* arena)
+{
+    if (arena)
+        arena->Push(stack, vch);
+    else
+        stack.push_back(vch);
+}
+
+ScriptExecutionArena::ScriptExecutionArena()
+{
+    vElements.reserve(SCRIPT_ARENA_MAX_ELEMENTS);
+    vStacks.reserve(SCRIPT_ARENA_MAX_STACKS);
+}
+
+void ScriptExecutionArena::Acquire(valtype& vch)
+{
+    assert(vch.empty());
+    if (vch.capacity() == 0 && !vElements.empty()) {
+        vch.swap(vElements.back());
+        vElements.pop_back();
+    }
+}
+
+void ScriptExecutionArena::Acquire(std::vector<valtype>& stack)
+{
+    assert(stack.empty());
+    if (stack.capacity() == 0 && !vStacks.empty()) {
+        stack.swap(vStacks.back());
+        vStacks.pop_back();
+    }
+}
+
+void ScriptExecutionArena::Release(valtype& vch)
+{
+    vch.clear();
+    // Oversized buffers (from arithmetic on large elements, say) are not worth keeping
+    if (vch.capacity() != 0 && vch.capacity() <= MAX_SCRIPT_ELEMENT_SIZE && vElements.size() < SCRIPT_ARENA_MAX_ELEMENTS) {
+        vElements.push_back(valtype());
+        vElements.back().swap(vch);
+    }
+}
+
+void ScriptExecutionArena::Release(std::vector<valtype>& stack)
+{
+    for (valtype& vch : stack)
+        Release(vch);
+    stack.clear();
+    if (stack.capacity() != 0 && vStacks.size() < SCRIPT_ARENA_MAX_STACKS) {
+        vStacks.push_back(std::vector<valtype>());
+        vStacks.back().swap(stack);
+    }
+}
+
+void ScriptExecutionArena::Push(std::vector<valtype>& stack, const valtype& vch)
+{
+    stack.push_back(valtype());
+    Acquire(stack.back());
+    stack.back().assign(vch.begin(), vch.end());
+}
+
+void ScriptExecutionArena::Pop(std::vector<valtype>& stack)
+{
+    Release(stack.back());
     stack.pop_back();
 }
 
+namespace {
+
+/** Lends a stack or buffer from an arena, if there is one, for the duration of a scope */
+template<typename T>
+class ArenaScope
+{
+private:
+    ScriptExecutionArena* arena;
+    T& obj;
+
+public:
+    ArenaScope(ScriptExecutionArena* arenaIn, T& objIn) : arena(arenaIn), obj(objIn)
+    {
+        if (arena)
+            arena->Acquire(obj);
+    }
+
+    ~ArenaScope()
+    {
+        if (arena)
+            arena->Release(obj);
+    }
+};
+
+} // anon namespace
+
 bool static IsCompressedOrUncompressedPubKey(const valtype &vchPubKey) {
     if (vchPubKey.size() < 33) {
         //  Non-canonical public key: too short
@@ -243,7 +339,7 @@ bool static CheckMinimalPush(const valtype& data, opcodetype opcode) {
     return true;
 }
 
-bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror)
+bool EvalScriptGeneric(std::vector<std::vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror, ScriptExecutionArena* arena)
 {
     static const CScriptNum bnZero(0);
     static const CScriptNum bnOne(1);
@@ -258,6 +354,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
     CScript::const_iterator pbegincodehash = script.begin();
     opcodetype opcode;
     valtype vchPushValue;
+    ArenaScope<valtype> scopePushValue(arena, vchPushValue);
     std::vector<bool> vfExec;
     std::vector<valtype> altstack;
     set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
@@ -305,7 +402,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                 if (fRequireMinimal && !CheckMinimalPush(vchPushValue, opcode)) {
                     return set_error(serror, SCRIPT_ERR_MINIMALDATA);
                 }
-                stack.push_back(vchPushValue);
+                pushstack(stack, vchPushValue, arena);
             } else if (fExec || (OP_IF <= opcode && opcode <= OP_ENDIF))
             switch (opcode)
             {
@@ -451,7 +548,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                         fValue = CastToBool(vch);
                         if (opcode == OP_NOTIF)
                             fValue = !fValue;
-                        popstack(stack);
+                        popstack(stack, arena);
                     }
                     vfExec.push_back(fValue);
                 }
@@ -481,7 +578,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                     bool fValue = CastToBool(stacktop(-1));
                     if (fValue)
-                        popstack(stack);
+                        popstack(stack, arena);
                     else
                         return set_error(serror, SCRIPT_ERR_VERIFY);
                 }
@@ -502,7 +599,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                     altstack.push_back(stacktop(-1));
-                    popstack(stack);
+                    popstack(stack, arena);
                 }
                 break;
 
@@ -520,8 +617,8 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     // (x1 x2 -- )
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    popstack(stack);
-                    popstack(stack);
+                    popstack(stack, arena);
+                    popstack(stack, arena);
                 }
                 break;
 
@@ -610,7 +707,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     // (x -- )
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    popstack(stack);
+                    popstack(stack, arena);
                 }
                 break;
 
@@ -651,7 +748,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                     int n = CScriptNum(stacktop(-1), fRequireMinimal).getint();
-                    popstack(stack);
+                    popstack(stack, arena);
                     if (n < 0 || n >= (int)stack.size())
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                     valtype vch = stacktop(-n-1);
@@ -722,13 +819,13 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     // zero bytes after it (numerically, 0x01 == 0x0001 == 0x000001)
                     //if (opcode == OP_NOTEQUAL)
                     //    fEqual = !fEqual;
-                    popstack(stack);
-                    popstack(stack);
+                    popstack(stack, arena);
+                    popstack(stack, arena);
                     stack.push_back(fEqual ? vchTrue : vchFalse);
                     if (opcode == OP_EQUALVERIFY)
                     {
                         if (fEqual)
-                            popstack(stack);
+                            popstack(stack, arena);
                         else
                             return set_error(serror, SCRIPT_ERR_EQUALVERIFY);
                     }
@@ -760,7 +857,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     case OP_0NOTEQUAL:  bn = (bn != bnZero); break;
                     default:            assert(!"invalid opcode"); break;
                     }
-                    popstack(stack);
+                    popstack(stack, arena);
                     stack.push_back(bn.getvch());
                 }
                 break;
@@ -808,14 +905,14 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     case OP_MAX:                 bn = (bn1 > bn2 ? bn1 : bn2); break;
                     default:                     assert(!"invalid opcode"); break;
                     }
-                    popstack(stack);
-                    popstack(stack);
+                    popstack(stack, arena);
+                    popstack(stack, arena);
                     stack.push_back(bn.getvch());
 
                     if (opcode == OP_NUMEQUALVERIFY)
                     {
                         if (CastToBool(stacktop(-1)))
-                            popstack(stack);
+                            popstack(stack, arena);
                         else
                             return set_error(serror, SCRIPT_ERR_NUMEQUALVERIFY);
                     }
@@ -831,9 +928,9 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     CScriptNum bn2(stacktop(-2), fRequireMinimal);
                     CScriptNum bn3(stacktop(-1), fRequireMinimal);
                     bool fValue = (bn2 <= bn1 && bn1 < bn3);
-                    popstack(stack);
-                    popstack(stack);
-                    popstack(stack);
+                    popstack(stack, arena);
+                    popstack(stack, arena);
+                    popstack(stack, arena);
                     stack.push_back(fValue ? vchTrue : vchFalse);
                 }
                 break;
@@ -863,7 +960,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                         CHash160().Write(vch.data(), vch.size()).Finalize(vchHash.data());
                     else if (opcode == OP_HASH256)
                         CHash256().Write(vch.data(), vch.size()).Finalize(vchHash.data());
-                    popstack(stack);
+                    popstack(stack, arena);
                     stack.push_back(vchHash);
                 }
                 break;                                   
@@ -902,13 +999,13 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     if (!fSuccess && (flags & SCRIPT_VERIFY_NULLFAIL) && vchSig.size())
                         return set_error(serror, SCRIPT_ERR_SIG_NULLFAIL);
 
-                    popstack(stack);
-                    popstack(stack);
+                    popstack(stack, arena);
+                    popstack(stack, arena);
                     stack.push_back(fSuccess ? vchTrue : vchFalse);
                     if (opcode == OP_CHECKSIGVERIFY)
                     {
                         if (fSuccess)
-                            popstack(stack);
+                            popstack(stack, arena);
                         else
                             return set_error(serror, SCRIPT_ERR_CHECKSIGVERIFY);
                     }
@@ -996,7 +1093,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                             return set_error(serror, SCRIPT_ERR_SIG_NULLFAIL);
                         if (ikey2 > 0)
                             ikey2--;
-                        popstack(stack);
+                        popstack(stack, arena);
                     }
 
                     // A bug causes CHECKMULTISIG to consume one extra argument
@@ -1009,14 +1106,14 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                     if ((flags & SCRIPT_VERIFY_NULLDUMMY) && stacktop(-1).size())
                         return set_error(serror, SCRIPT_ERR_SIG_NULLDUMMY);
-                    popstack(stack);
+                    popstack(stack, arena);
 
                     stack.push_back(fSuccess ? vchTrue : vchFalse);
 
                     if (opcode == OP_CHECKMULTISIGVERIFY)
                     {
                         if (fSuccess)
-                            popstack(stack);
+                            popstack(stack, arena);
                         else
                             return set_error(serror, SCRIPT_ERR_CHECKMULTISIGVERIFY);
                     }
@@ -1043,8 +1140,157 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
     return set_success(serror);
 }
 
+/**
+ * Fast paths for the scripts that make up almost all inputs: pay-to-pubkey-hash
+ * (which is also how P2WPKH programs are run) and bare multisig (most P2SH
+ * redeem scripts). They go straight to the signature checks with the
+ * arguments on the stack, instead of running the opcodes one by one, and
+ * must behave exactly like EvalScriptGeneric, errors included. Cases where
+ * the generic interpreter would fail before reaching the signature checks
+ * (missing arguments, stack size limit) are left to it.
+ */
+namespace {
+
+//! OP_DUP OP_HASH160 <20 bytes> OP_EQUALVERIFY OP_CHECKSIG
+bool IsPayToPubKeyHashScript(const CScript& script)
+{
+    return script.size() == 25 && script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == 20 &&
+           script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG;
+}
+
+/**
+ * OP_m <pubkey>... OP_n OP_CHECKMULTISIG with 1 <= m <= n <= 16 and 33 to 65
+ * byte keys. On success, vKeyPos holds the offset of each key's push.
+ */
+bool IsMultisigScript(const CScript& script, int& nRequired, int& nKeys, unsigned int vKeyPos[16])
+{
+    if (script.size() < 3 || script[0] < OP_1 || script[0] > OP_16)
+        return false;
+    nRequired = script[0] - (OP_1 - 1);
+    nKeys = 0;
+    unsigned int nPos = 1;
+    while (nPos + 2 < script.size()) {
+        unsigned int nSize = script[nPos];
+        if (nSize < 33 || nSize > 65 || nKeys == 16 || nPos + 1 + nSize + 2 > script.size())
+            return false;
+        vKeyPos[nKeys++] = nPos;
+        nPos += 1 + nSize;
+    }
+    return nPos + 2 == script.size() && nKeys >= nRequired && script[nPos] == OP_1 + (nKeys - 1) &&
+           script[nPos + 1] == OP_CHECKMULTISIG;
+}
+
+bool EvalPayToPubKeyHash(std::vector<valtype>& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror, ScriptExecutionArena* arena)
+{
+    static const valtype vchFalse(0);
+    static const valtype vchTrue(1, 1);
+
+    // OP_DUP OP_HASH160 <hash> OP_EQUALVERIFY
+    const valtype& vchSig = stack[stack.size() - 2];
+    const valtype& vchPubKey = stack[stack.size() - 1];
+    unsigned char vchHash[CHash160::OUTPUT_SIZE];
+    CHash160().Write(vchPubKey.data(), vchPubKey.size()).Finalize(vchHash);
+    if (memcmp(vchHash, &script[3], sizeof(vchHash)) != 0)
+        return set_error(serror, SCRIPT_ERR_EQUALVERIFY);
+
+    // OP_CHECKSIG
+    CScript scriptCode(script.begin(), script.end());
+    if (sigversion == SIGVERSION_BASE) {
+        scriptCode.FindAndDelete(CScript(vchSig));
+    }
+    if (!CheckSignatureEncoding(vchSig, flags, serror) || !CheckPubKeyEncoding(vchPubKey, flags, sigversion, serror)) {
+        // serror is set
+        return false;
+    }
+    bool fSuccess = checker.CheckSig(vchSig, vchPubKey, scriptCode, sigversion);
+
+    if (!fSuccess && (flags & SCRIPT_VERIFY_NULLFAIL) && vchSig.size())
+        return set_error(serror, SCRIPT_ERR_SIG_NULLFAIL);
+
+    popstack(stack, arena);
+    stack.back() = fSuccess ? vchTrue : vchFalse;
+    return set_success(serror);
+}
+
+bool EvalMultisig(std::vector<valtype>& stack, const CScript& script, int nRequired, int nKeys, const unsigned int vKeyPos[16], unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror, ScriptExecutionArena* arena)
+{
+    static const valtype vchFalse(0);
+    static const valtype vchTrue(1, 1);
+
+    // Signatures are the nRequired topmost stack items, the last one first,
+    // and are checked against the keys from the last one on, like OP_CHECKMULTISIG does
+    const size_t nTop = stack.size() - 1;
+    CScript scriptCode(script.begin(), script.end());
+    if (sigversion == SIGVERSION_BASE) {
+        for (int k = 0; k < nRequired; k++)
+            scriptCode.FindAndDelete(CScript(stack[nTop - k]));
+    }
+
+    int nSigsLeft = nRequired;
+    int nKeysLeft = nKeys;
+    bool fSuccess = true;
+    valtype vchPubKey;
+    ArenaScope<valtype> scopePubKey(arena, vchPubKey);
+    while (fSuccess && nSigsLeft > 0) {
+        const valtype& vchSig = stack[nTop - (nRequired - nSigsLeft)];
+        CScript::const_iterator itKey = script.begin() + vKeyPos[nKeysLeft - 1];
+        vchPubKey.assign(itKey + 1, itKey + 1 + *itKey);
+
+        if (!CheckSignatureEncoding(vchSig, flags, serror) || !CheckPubKeyEncoding(vchPubKey, flags, sigversion, serror)) {
+            // serror is set
+            return false;
+        }
+        if (checker.CheckSig(vchSig, vchPubKey, scriptCode, sigversion))
+            nSigsLeft--;
+        nKeysLeft--;
+        if (nSigsLeft > nKeysLeft)
+            fSuccess = false;
+    }
+
+    if (!fSuccess && (flags & SCRIPT_VERIFY_NULLFAIL)) {
+        for (int k = 0; k < nRequired; k++) {
+            if (stack[nTop - k].size())
+                return set_error(serror, SCRIPT_ERR_SIG_NULLFAIL);
+        }
+    }
+    // The extra argument consumed by OP_CHECKMULTISIG
+    if ((flags & SCRIPT_VERIFY_NULLDUMMY) && stack[nTop - nRequired].size())
+        return set_error(serror, SCRIPT_ERR_SIG_NULLDUMMY);
+
+    for (int k = 0; k < nRequired; k++)
+        popstack(stack, arena);
+    stack.back() = fSuccess ? vchTrue : vchFalse;
+    return set_success(serror);
+}
+
+} // anon namespace
+
+bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror, ScriptExecutionArena* arena)
+{
+    try
+    {
+        // The generic interpreter fails once the stack grows above 1000 items
+        if (IsPayToPubKeyHashScript(script) && stack.size() >= 2 && stack.size() + 2 <= 1000)
+            return EvalPayToPubKeyHash(stack, script, flags, checker, sigversion, serror, arena);
+
+        int nRequired, nKeys;
+        unsigned int vKeyPos[16];
+        if (IsMultisigScript(script, nRequired, nKeys, vKeyPos) && stack.size() >= (size_t)nRequired + 1 && stack.size() + nKeys + 2 <= 1000)
+            return EvalMultisig(stack, script, nRequired, nKeys, vKeyPos, flags, checker, sigversion, serror, arena);
+    }
+    catch (...)
+    {
+        return set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
+    }
+
+    return EvalScriptGeneric(stack, script, flags, checker, sigversion, serror, arena);
+}
+
 namespace {
 
+//! Size of a serialized input with an empty scriptSig: prevout, script length, nSequence
+static const size_t LEGACY_SIGHASH_BLANK_INPUT_SIZE = 32 + 4 + 1 + 4;
+
 /**
  * Wrapper that serializes like CTransaction, but with the modifications
  *  required for the signature hash done in-place
@@ -1171,6 +1417,27 @@ PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
     hashPrevouts = GetPrevoutHash(txTo);
     hashSequence = GetSequenceHash(txTo);
     hashOutputs = GetOutputsHash(txTo);
+
+    if (txTo.vin.size() >= LEGACY_SIGHASH_CACHE_MIN_INPUTS) {
+        vLegacyInputs.reserve(txTo.vin.size() * LEGACY_SIGHASH_BLANK_INPUT_SIZE);
+        CVectorWriter inputs(SER_GETHASH, 0, vLegacyInputs, 0);
+        for (const CTxIn& txin : txTo.vin)
+            inputs << txin.prevout << CScriptBase() << txin.nSequence;
+        assert(vLegacyInputs.size() == txTo.vin.size() * LEGACY_SIGHASH_BLANK_INPUT_SIZE);
+
+        CVectorWriter tail(SER_GETHASH, 0, vLegacyTail, 0);
+        tail << txTo.vout << txTo.nLockTime;
+
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << txTo.nVersion;
+        WriteCompactSize(ss, txTo.vin.size());
+        vLegacyMidstates.reserve(txTo.vin.size() / LEGACY_SIGHASH_MIDSTATE_INTERVAL + 1);
+        for (size_t nInput = 0; nInput < txTo.vin.size(); nInput += LEGACY_SIGHASH_MIDSTATE_INTERVAL) {
+            vLegacyMidstates.push_back(ss);
+            size_t nCount = std::min<size_t>(LEGACY_SIGHASH_MIDSTATE_INTERVAL, txTo.vin.size() - nInput);
+            ss.write((const char*)&vLegacyInputs[nInput * LEGACY_SIGHASH_BLANK_INPUT_SIZE], nCount * LEGACY_SIGHASH_BLANK_INPUT_SIZE);
+        }
+    }
 }
 
 uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const CAmount& amount, SigVersion sigversion, const PrecomputedTransactionData* cache)
@@ -1237,6 +1504,23 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
+    if (cache && cache->vLegacyInputs.size() == txTo.vin.size() * LEGACY_SIGHASH_BLANK_INPUT_SIZE &&
+        !(nHashType & SIGHASH_ANYONECANPAY) && (nHashType & 0x1f) != SIGHASH_SINGLE && (nHashType & 0x1f) != SIGHASH_NONE) {
+        // Resume from the last midstate before nIn, and hash the rest of the
+        // serialization from the cached parts: only the input being signed
+        // differs between inputs
+        size_t nMidstate = nIn / LEGACY_SIGHASH_MIDSTATE_INTERVAL;
+        size_t nFirst = nMidstate * LEGACY_SIGHASH_MIDSTATE_INTERVAL;
+        const char* pInputs = (const char*)cache->vLegacyInputs.data();
+        CHashWriter ss(cache->vLegacyMidstates[nMidstate]);
+        ss.write(pInputs + nFirst * LEGACY_SIGHASH_BLANK_INPUT_SIZE, (nIn - nFirst) * LEGACY_SIGHASH_BLANK_INPUT_SIZE);
+        txTmp.SerializeInput(ss, nIn);
+        ss.write(pInputs + (nIn + 1) * LEGACY_SIGHASH_BLANK_INPUT_SIZE, (txTo.vin.size() - nIn - 1) * LEGACY_SIGHASH_BLANK_INPUT_SIZE);
+        ss.write((const char*)cache->vLegacyTail.data(), cache->vLegacyTail.size());
+        ss << nHashType;
+        return ss.GetHash();
+    }
+
     // Serialize and hash
     CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
@@ -1351,9 +1635,10 @@ bool TransactionSignatureChecker::CheckSequence(const CScriptNum& nSequence) con
     return true;
 }
 
-static bool VerifyWitnessProgram(const CScriptWitness& witness, int witversion, const std::vector<unsigned char>& program, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
+static bool VerifyWitnessProgram(const CScriptWitness& witness, int witversion, const std::vector<unsigned char>& program, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror, ScriptExecutionArena* arena)
 {
     std::vector<std::vector<unsigned char> > stack;
+    ArenaScope<std::vector<valtype> > scopeStack(arena, stack);
     CScript scriptPubKey;
 
     if (witversion == 0) {
@@ -1363,7 +1648,8 @@ static bool VerifyWitnessProgram(const CScriptWitness& witness, int witversion,
                 return set_error(serror, SCRIPT_ERR_WITNESS_PROGRAM_WITNESS_EMPTY);
             }
             scriptPubKey = CScript(witness.stack.back().begin(), witness.stack.back().end());
-            stack = std::vector<std::vector<unsigned char> >(witness.stack.begin(), witness.stack.end() - 1);
+            for (size_t i = 0; i + 1 < witness.stack.size(); i++)
+                pushstack(stack, witness.stack[i], arena);
             uint256 hashScriptPubKey;
             CSHA256().Write(&scriptPubKey[0], scriptPubKey.size()).Finalize(hashScriptPubKey.begin());
             if (memcmp(hashScriptPubKey.begin(), &program[0], 32)) {
@@ -1375,7 +1661,8 @@ static bool VerifyWitnessProgram(const CScriptWitness& witness, int witversion,
                 return set_error(serror, SCRIPT_ERR_WITNESS_PROGRAM_MISMATCH); // 2 items in witness
             }
             scriptPubKey << OP_DUP << OP_HASH160 << program << OP_EQUALVERIFY << OP_CHECKSIG;
-            stack = witness.stack;
+            for (const valtype& vch : witness.stack)
+                pushstack(stack, vch, arena);
         } else {
             return set_error(serror, SCRIPT_ERR_WITNESS_PROGRAM_WRONG_LENGTH);
         }
@@ -1392,7 +1679,7 @@ static bool VerifyWitnessProgram(const CScriptWitness& witness, int witversion,
             return set_error(serror, SCRIPT_ERR_PUSH_SIZE);
     }
 
-    if (!EvalScript(stack, scriptPubKey, flags, checker, SIGVERSION_WITNESS_V0, serror)) {
+    if (!EvalScript(stack, scriptPubKey, flags, checker, SIGVERSION_WITNESS_V0, serror, arena)) {
         return false;
     }
 
@@ -1404,7 +1691,7 @@ static bool VerifyWitnessProgram(const CScriptWitness& witness, int witversion,
     return true;
 }
 
-bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const CScriptWitness* witness, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
+bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const CScriptWitness* witness, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror, ScriptExecutionArena* arena)
 {
     static const CScriptWitness emptyWitness;
     if (witness == NULL) {
@@ -1419,12 +1706,17 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const C
     }
 
     std::vector<std::vector<unsigned char> > stack, stackCopy;
-    if (!EvalScript(stack, scriptSig, flags, checker, SIGVERSION_BASE, serror))
+    ArenaScope<std::vector<valtype> > scopeStack(arena, stack);
+    ArenaScope<std::vector<valtype> > scopeStackCopy(arena, stackCopy);
+    if (!EvalScript(stack, scriptSig, flags, checker, SIGVERSION_BASE, serror, arena))
         // serror is set
         return false;
-    if (flags & SCRIPT_VERIFY_P2SH)
-        stackCopy = stack;
-    if (!EvalScript(stack, scriptPubKey, flags, checker, SIGVERSION_BASE, serror))
+    // Only P2SH evaluation below needs the copy
+    if ((flags & SCRIPT_VERIFY_P2SH) && scriptPubKey.IsPayToScriptHash()) {
+        for (const valtype& vch : stack)
+            pushstack(stackCopy, vch, arena);
+    }
+    if (!EvalScript(stack, scriptPubKey, flags, checker, SIGVERSION_BASE, serror, arena))
         // serror is set
         return false;
     if (stack.empty())
@@ -1442,7 +1734,7 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const C
                 // The scriptSig must be _exactly_ CScript(), otherwise we reintroduce malleability.
                 return set_error(serror, SCRIPT_ERR_WITNESS_MALLEATED);
             }
-            if (!VerifyWitnessProgram(*witness, witnessversion, witnessprogram, flags, checker, serror)) {
+            if (!VerifyWitnessProgram(*witness, witnessversion, witnessprogram, flags, checker, serror, arena)) {
                 return false;
             }
             // Bypass the cleanstack check at the end. The actual stack is obviously not clean
@@ -1468,9 +1760,9 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const C
 
         const valtype& pubKeySerialized = stack.back();
         CScript pubKey2(pubKeySerialized.begin(), pubKeySerialized.end());
-        popstack(stack);
+        popstack(stack, arena);
 
-        if (!EvalScript(stack, pubKey2, flags, checker, SIGVERSION_BASE, serror))
+        if (!EvalScript(stack, pubKey2, flags, checker, SIGVERSION_BASE, serror, arena))
             // serror is set
             return false;
         if (stack.empty())
@@ -1487,7 +1779,7 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const C
                     // reintroduce malleability.
                     return set_error(serror, SCRIPT_ERR_WITNESS_MALLEATED_P2SH);
                 }
-                if (!VerifyWitnessProgram(*witness, witnessversion, witnessprogram, flags, checker, serror)) {
+                if (!VerifyWitnessProgram(*witness, witnessversion, witnessprogram, flags, checker, serror, arena)) {
                     return false;
                 }
                 // Bypass the cleanstack check at the end. The actual stack is obviously not clean
@@ -6,6 +6,7 @@
 #ifndef BITCOIN_SCRIPT_INTERPRETER_H
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
+#include "hash.h"
 #include "script_error.h"
 #include "primitives/transaction.h"
 
@@ -110,10 +111,29 @@ enum
 
 bool CheckSignatureEncoding(const std::vector<unsigned char> &vchSig, unsigned int flags, ScriptError* serror);
 
+//! Transactions with at least this many inputs get their legacy signature hashing precomputed
+static const unsigned int LEGACY_SIGHASH_CACHE_MIN_INPUTS = 32;
+//! Number of inputs between two cached legacy signature hash midstates
+static const unsigned int LEGACY_SIGHASH_MIDSTATE_INTERVAL = 16;
+
 struct PrecomputedTransactionData
 {
     uint256 hashPrevouts, hashSequence, hashOutputs;
 
+    /**
+     * Legacy SIGHASH_ALL signature hashes cover the whole transaction for
+     * every input, which is quadratic in the number of inputs. For large
+     * transactions, the parts shared by all inputs are serialized once:
+     * - vLegacyInputs: every input as it appears when another one is signed
+     *   (empty scriptSig), LEGACY_SIGHASH_BLANK_INPUT_SIZE bytes each
+     * - vLegacyTail: the outputs and nLockTime
+     * - vLegacyMidstates: hasher state after the version, the input count and
+     *   the blanked inputs before every LEGACY_SIGHASH_MIDSTATE_INTERVAL-th one
+     */
+    std::vector<unsigned char> vLegacyInputs;
+    std::vector<unsigned char> vLegacyTail;
+    std::vector<CHashWriter> vLegacyMidstates;
+
     PrecomputedTransactionData(const CTransaction& tx);
 };
 
@@ -174,8 +194,43 @@ public:
     MutableTransactionSignatureChecker(const CMutableTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn) : TransactionSignatureChecker(&txTo, nInIn, amountIn), txTo(*txToIn) {}
 };
 
-bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* error = NULL);
-bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const CScriptWitness* witness, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror = NULL);
+//! Maximum number of stack element buffers kept by a ScriptExecutionArena (the stack size limit)
+static const unsigned int SCRIPT_ARENA_MAX_ELEMENTS = 1000;
+//! Maximum number of stacks kept by a ScriptExecutionArena
+static const unsigned int SCRIPT_ARENA_MAX_STACKS = 4;
+
+/**
+ * Buffers kept from one script execution to the next, so that running a
+ * script does not go to the heap: the stacks and stack elements released by
+ * one execution are reused by the following ones. Script check threads keep
+ * one each; it is not thread safe.
+ */
+class ScriptExecutionArena
+{
+private:
+    std::vector<std::vector<unsigned char> > vElements;
+    std::vector<std::vector<std::vector<unsigned char> > > vStacks;
+
+public:
+    ScriptExecutionArena();
+
+    //! Give vch (or stack), which must be empty, a buffer from the arena if it has none
+    void Acquire(std::vector<unsigned char>& vch);
+    void Acquire(std::vector<std::vector<unsigned char> >& stack);
+    //! Take back the buffer of vch (or of stack and its elements), leaving it empty
+    void Release(std::vector<unsigned char>& vch);
+    void Release(std::vector<std::vector<unsigned char> >& stack);
+
+    //! Push a copy of vch onto stack, in a buffer from the arena
+    void Push(std::vector<std::vector<unsigned char> >& stack, const std::vector<unsigned char>& vch);
+    //! Pop the top element of stack, keeping its buffer
+    void Pop(std::vector<std::vector<unsigned char> >& stack);
+};
+
+bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* error = NULL, ScriptExecutionArena* arena = NULL);
+/** EvalScript without the fast paths for standard scripts, which must behave exactly like it */
+bool EvalScriptGeneric(std::vector<std::vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* error = NULL, ScriptExecutionArena* arena = NULL);
+bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const CScriptWitness* witness, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror = NULL, ScriptExecutionArena* arena = NULL);
 
 size_t CountWitnessSigOps(const CScript& scriptSig, const CScript& scriptPubKey, const CScriptWitness* witness, unsigned int flags);
 
@@ -510,7 +510,10 @@ template<typename Stream, typename K, typename Pred, typename A> void Unserializ
 
 /**
  * shared_ptr
+ * The allocator used for deserialized objects can be chosen by specializing
+ * SharedPtrAllocator for their type.
  */
+template<typename T> struct SharedPtrAllocator { typedef std::allocator<T> type; };
 template<typename Stream, typename T> void Serialize(Stream& os, const std::shared_ptr<const T>& p);
 template<typename Stream, typename T> void Unserialize(Stream& os, std::shared_ptr<const T>& p);
 
@@ -801,7 +804,7 @@ Serialize(Stream& os, const std::shared_ptr<const T>& p)
 template<typename Stream, typename T>
 void Unserialize(Stream& is, std::shared_ptr<const T>& p)
 {
-    p = std::make_shared<const T>(deserialize, is);
+    p = std::allocate_shared<const T>(typename SharedPtrAllocator<T>::type(), deserialize, is);
 }
 
 
@@ -0,0 +1,81 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_ARENA_H
+#define BITCOIN_SUPPORT_ALLOCATORS_ARENA_H
+
+#include <memory>
+#include <new>
+#include <stddef.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Objects of one type, constructed one after the other in large chunks of
+ * memory, and destroyed all at once.
+ *
+ * Meant for objects that are created throughout the life of the program and
+ * never destroyed one by one, like the entries of the block index: they take
+ * no per-allocation overhead, and objects created in sequence (such as
+ * blocks in height order) sit next to each other in memory, so walking from
+ * one to the next stays within a few cache lines. Objects never move, and
+ * are destroyed by Clear() or with the arena. Not thread-safe.
+ */
+template <typename T, size_t OBJECTS_PER_CHUNK = 4096>
+class ObjectArena
+{
+private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+
+    std::vector<std::unique_ptr<Storage[]> > vChunks;
+    //! Objects constructed in the last chunk
+    size_t nLast;
+
+    ObjectArena(const ObjectArena&);
+    ObjectArena& operator=(const ObjectArena&);
+
+public:
+    ObjectArena() : nLast(OBJECTS_PER_CHUNK) {}
+    ~ObjectArena() { Clear(); }
+
+    template <typename... Args>
+    T* New(Args&&... args)
+    {
+        if (nLast == OBJECTS_PER_CHUNK) {
+            vChunks.emplace_back(new Storage[OBJECTS_PER_CHUNK]);
+            nLast = 0;
+        }
+        T* p = reinterpret_cast<T*>(&vChunks.back()[nLast]);
+        new (p) T(std::forward<Args>(args)...);
+        nLast++;
+        return p;
+    }
+
+    //! Number of objects constructed
+    size_t size() const
+    {
+        return vChunks.empty() ? 0 : (vChunks.size() - 1) * OBJECTS_PER_CHUNK + nLast;
+    }
+
+    //! Bytes of memory taken, including what is left in the last chunk
+    size_t GetCapacity() const
+    {
+        return vChunks.size() * OBJECTS_PER_CHUNK * sizeof(Storage);
+    }
+
+    //! Destroy all objects and release their memory
+    void Clear()
+    {
+        for (size_t i = 0; i < vChunks.size(); i++) {
+            const size_t nObjects = i + 1 == vChunks.size() ? nLast : OBJECTS_PER_CHUNK;
+            for (size_t j = 0; j < nObjects; j++)
+                reinterpret_cast<T*>(&vChunks[i][j])->~T();
+        }
+        vChunks.clear();
+        nLast = OBJECTS_PER_CHUNK;
+    }
+};
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_ARENA_H
@@ -0,0 +1,129 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stddef.h>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Thread-safe pool of fixed-size memory blocks, carved out of larger chunks
+ * and recycled through a free list.
+ *
+ * Meant for small objects that are created and destroyed by the thousands
+ * (like the transactions of every block), to keep them out of the general
+ * purpose heap: allocating and freeing one is a list operation, and objects
+ * freed at scattered times leave reusable holes in the pool rather than
+ * fragmenting the heap. Chunks are never returned to the system, so the pool
+ * stays as large as the most blocks that were ever in use at once.
+ */
+template <size_t BLOCK_SIZE>
+class FixedSizePool
+{
+private:
+    static const size_t BLOCKS_PER_CHUNK = 1024;
+
+    union Block
+    {
+        Block* pnext;
+        typename std::aligned_storage<BLOCK_SIZE>::type data;
+    };
+
+    std::mutex mutex;
+    Block* pfree;
+    std::vector<std::unique_ptr<Block[]> > vChunks;
+
+    FixedSizePool() : pfree(NULL) {}
+    FixedSizePool(const FixedSizePool&);
+    FixedSizePool& operator=(const FixedSizePool&);
+
+public:
+    //! Bytes taken by each block, including alignment
+    static const size_t ALLOCATION_SIZE = sizeof(Block);
+
+    static FixedSizePool& Get()
+    {
+        // Never destroyed, as blocks may still be freed during shutdown
+        static FixedSizePool* pool = new FixedSizePool();
+        return *pool;
+    }
+
+    void* Allocate()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!pfree) {
+            Block* chunk = new Block[BLOCKS_PER_CHUNK];
+            vChunks.emplace_back(chunk);
+            for (size_t i = 0; i < BLOCKS_PER_CHUNK; i++) {
+                chunk[i].pnext = pfree;
+                pfree = &chunk[i];
+            }
+        }
+        Block* block = pfree;
+        pfree = block->pnext;
+        return block;
+    }
+
+    void Free(void* p)
+    {
+        Block* block = static_cast<Block*>(p);
+        std::lock_guard<std::mutex> lock(mutex);
+        block->pnext = pfree;
+        pfree = block;
+    }
+
+    //! Number of blocks the pool holds, in use or not
+    size_t GetCapacity()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return vChunks.size() * BLOCKS_PER_CHUNK;
+    }
+};
+
+/**
+ * Allocator drawing single objects from the FixedSizePool for their size
+ * (arrays come from the heap). Its main use is with std::allocate_shared,
+ * which allocates the object and its reference count together.
+ */
+template <typename T>
+struct pool_allocator
+{
+    typedef T value_type;
+
+    pool_allocator() {}
+    template <typename U>
+    pool_allocator(const pool_allocator<U>&) {}
+
+    template <typename U>
+    struct rebind {
+        typedef pool_allocator<U> other;
+    };
+
+    T* allocate(size_t n)
+    {
+        if (n != 1)
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(FixedSizePool<sizeof(T)>::Get().Allocate());
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if (n != 1)
+            ::operator delete(p);
+        else
+            FixedSizePool<sizeof(T)>::Get().Free(p);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const pool_allocator<T>&, const pool_allocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const pool_allocator<T>&, const pool_allocator<U>&) { return false; }
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
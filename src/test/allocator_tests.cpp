@@ -4,6 +4,8 @@
 
 #include "util.h"
 
+#include "support/allocators/arena.h"
+#include "support/allocators/pool.h"
 #include "support/allocators/secure.h"
 #include "test/test_bitcoin.h"
 
@@ -231,4 +233,75 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     BOOST_CHECK(pool.stats().used == initial.used);
 }
 
+BOOST_AUTO_TEST_CASE(pool_allocator_tests)
+{
+    // A size no other pool uses
+    struct Object { char data[1000]; };
+    FixedSizePool<sizeof(Object)>& pool = FixedSizePool<sizeof(Object)>::Get();
+    BOOST_CHECK_EQUAL(pool.GetCapacity(), 0U);
+
+    pool_allocator<Object> alloc;
+    std::vector<Object*> objects;
+    for (int i = 0; i < 1500; i++) {
+        objects.push_back(alloc.allocate(1));
+        memset(objects.back()->data, i, sizeof(Object));
+    }
+    BOOST_CHECK_EQUAL(pool.GetCapacity(), 2048U);
+    for (int i = 0; i < 1500; i++)
+        BOOST_CHECK_EQUAL(objects[i]->data[999], (char)i);
+
+    // Freed blocks are reused before the pool grows
+    Object* p = objects[700];
+    alloc.deallocate(p, 1);
+    BOOST_CHECK(alloc.allocate(1) == p);
+    for (Object* object : objects)
+        alloc.deallocate(object, 1);
+    objects.clear();
+    for (int i = 0; i < 2048; i++)
+        objects.push_back(alloc.allocate(1));
+    BOOST_CHECK_EQUAL(pool.GetCapacity(), 2048U);
+    for (Object* object : objects)
+        alloc.deallocate(object, 1);
+
+    // Arrays come from the heap
+    Object* array = alloc.allocate(3);
+    alloc.deallocate(array, 3);
+    BOOST_CHECK_EQUAL(pool.GetCapacity(), 2048U);
+}
+
+BOOST_AUTO_TEST_CASE(object_arena_tests)
+{
+    struct Object {
+        int n;
+        int* pnDestroyed;
+        Object(int nIn, int* pnDestroyedIn) : n(nIn), pnDestroyed(pnDestroyedIn) {}
+        ~Object() { ++*pnDestroyed; }
+    };
+    int nDestroyed = 0;
+    {
+        ObjectArena<Object, 100> arena;
+        BOOST_CHECK_EQUAL(arena.size(), 0U);
+        BOOST_CHECK_EQUAL(arena.GetCapacity(), 0U);
+        std::vector<Object*> objects;
+        for (int i = 0; i < 250; i++)
+            objects.push_back(arena.New(i, &nDestroyed));
+        BOOST_CHECK_EQUAL(arena.size(), 250U);
+        BOOST_CHECK(arena.GetCapacity() >= 300 * sizeof(Object));
+        for (int i = 0; i < 250; i++) {
+            BOOST_CHECK_EQUAL(objects[i]->n, i);
+            // Objects created in sequence are adjacent within a chunk
+            if (i % 100 != 0)
+                BOOST_CHECK(objects[i] == objects[i - 1] + 1);
+        }
+
+        arena.Clear();
+        BOOST_CHECK_EQUAL(nDestroyed, 250);
+        BOOST_CHECK_EQUAL(arena.size(), 0U);
+        BOOST_CHECK_EQUAL(arena.GetCapacity(), 0U);
+        arena.New(0, &nDestroyed);
+    }
+    // The arena destroys what is left in it
+    BOOST_CHECK_EQUAL(nDestroyed, 251);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
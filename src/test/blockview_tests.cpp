@@ -0,0 +1,151 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "primitives/blockview.h"
+
+#include "consensus/merkle.h"
+#include "streams.h"
+#include "version.h"
+#include "test/test_bitcoin.h"
+#include "test/test_random.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockview_tests, BasicTestingSetup)
+
+static CMutableTransaction RandomTransaction(bool fWitness)
+{
+    CMutableTransaction tx;
+    tx.nVersion = insecure_rand();
+    tx.nLockTime = insecure_rand();
+    int nInputs = 1 + insecure_rand() % 4;
+    for (int i = 0; i < nInputs; i++) {
+        CTxIn txin(COutPoint(GetRandHash(), insecure_rand() % 10), CScript() << std::vector<unsigned char>(insecure_rand() % 300, 1), insecure_rand());
+        if (fWitness && insecure_rand() % 2)
+            txin.scriptWitness.stack.resize(1 + insecure_rand() % 3, std::vector<unsigned char>(insecure_rand() % 80, 2));
+        tx.vin.push_back(txin);
+    }
+    if (fWitness && !CTransaction(tx).HasWitness())
+        tx.vin[0].scriptWitness.stack.push_back(std::vector<unsigned char>(1, 3));
+    int nOutputs = insecure_rand() % 4;
+    for (int i = 0; i < nOutputs; i++)
+        tx.vout.push_back(CTxOut(insecure_rand(), CScript() << OP_RETURN << std::vector<unsigned char>(insecure_rand() % 40, 4)));
+    return tx;
+}
+
+static CBlockView::Buffer SerializeBlock(const CBlock& block, int nVersion = PROTOCOL_VERSION)
+{
+    std::shared_ptr<std::vector<unsigned char> > buffer = std::make_shared<std::vector<unsigned char> >();
+    CVectorWriter(SER_NETWORK, nVersion, *buffer, 0, block);
+    return buffer;
+}
+
+BOOST_AUTO_TEST_CASE(blockview_roundtrip)
+{
+    for (int i = 0; i < 20; i++) {
+        CBlock block;
+        block.nVersion = insecure_rand();
+        block.hashPrevBlock = GetRandHash();
+        block.nTime = insecure_rand();
+        int nTx = 1 + insecure_rand() % 30;
+        for (int j = 0; j < nTx; j++)
+            block.vtx.push_back(MakeTransactionRef(RandomTransaction(j > 0 && insecure_rand() % 2)));
+        block.hashMerkleRoot = BlockMerkleRoot(block);
+
+        CBlockView view;
+        BOOST_CHECK(view.Parse(SerializeBlock(block)));
+        BOOST_CHECK(view.GetHash() == block.GetHash());
+        BOOST_CHECK_EQUAL(view.GetTransactionCount(), block.vtx.size());
+        bool fHasWitness = false;
+        for (size_t j = 0; j < block.vtx.size(); j++) {
+            BOOST_CHECK(view.GetTxHash(j) == block.vtx[j]->GetHash());
+            BOOST_CHECK(view.GetWitnessHash(j) == block.vtx[j]->GetWitnessHash());
+            fHasWitness |= block.vtx[j]->HasWitness();
+        }
+        BOOST_CHECK_EQUAL(view.HasWitness(), fHasWitness);
+
+        bool fMutated = true;
+        BOOST_CHECK(BlockMerkleRoot(view, &fMutated) == block.hashMerkleRoot);
+        BOOST_CHECK(!fMutated);
+        BOOST_CHECK(BlockWitnessMerkleRoot(view) == BlockWitnessMerkleRoot(block));
+
+        // Reserialization matches CBlock's, with and without witnesses
+        BOOST_CHECK(*SerializeBlock(block) == *view.GetBuffer());
+        std::vector<unsigned char> vchStripped;
+        CVectorWriter(SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS, vchStripped, 0, view);
+        BOOST_CHECK(*SerializeBlock(block, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS) == vchStripped);
+
+        // Transactions are materialized once, and equal the originals
+        size_t nIndex = insecure_rand() % block.vtx.size();
+        CTransactionRef tx = view.GetTransaction(nIndex);
+        BOOST_CHECK(tx == view.GetTransaction(nIndex));
+        BOOST_CHECK(*tx == *block.vtx[nIndex]);
+        CBlock block2;
+        view.GetBlock(block2);
+        BOOST_CHECK(block2.GetHash() == block.GetHash());
+        BOOST_CHECK(block2.vtx[nIndex] == tx);
+        BOOST_CHECK(BlockWitnessMerkleRoot(block2) == BlockWitnessMerkleRoot(block));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(blockview_malformed)
+{
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(RandomTransaction(false)));
+    block.vtx.push_back(MakeTransactionRef(RandomTransaction(true)));
+    std::vector<unsigned char> vch = *SerializeBlock(block);
+
+    // Truncated, or with trailing data
+    CBlockView view;
+    for (size_t nSize = 0; nSize < vch.size(); nSize++) {
+        BOOST_CHECK(!view.Parse(std::make_shared<std::vector<unsigned char> >(vch.begin(), vch.begin() + nSize)));
+        BOOST_CHECK(view.IsNull());
+    }
+    std::vector<unsigned char> vchLong(vch);
+    vchLong.push_back(0);
+    BOOST_CHECK(!view.Parse(std::make_shared<std::vector<unsigned char> >(vchLong)));
+
+    // An unknown flag in the extended transaction format
+    size_t nFlagPos = 80 + 1 + ::GetSerializeSize(*block.vtx[0], SER_NETWORK, PROTOCOL_VERSION) + 5;
+    BOOST_CHECK_EQUAL(vch[nFlagPos - 1], 0);
+    BOOST_CHECK_EQUAL(vch[nFlagPos], 1);
+    vch[nFlagPos] = 2;
+    BOOST_CHECK(!view.Parse(std::make_shared<std::vector<unsigned char> >(vch)));
+    vch[nFlagPos] = 1;
+    BOOST_CHECK(view.Parse(std::make_shared<std::vector<unsigned char> >(vch)));
+}
+
+BOOST_AUTO_TEST_CASE(blockview_empty_witness)
+{
+    // The extended format with only empty witnesses is accepted, but hashes
+    // and reserializes like CTransaction, i.e. without the witness section
+    CMutableTransaction mtx = RandomTransaction(false);
+    std::vector<unsigned char> vchTx;
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, vchTx, 0, mtx);
+    std::vector<unsigned char> vchExtended(vchTx.begin(), vchTx.begin() + 4);
+    vchExtended.push_back(0);
+    vchExtended.push_back(1);
+    vchExtended.insert(vchExtended.end(), vchTx.begin() + 4, vchTx.end() - 4);
+    vchExtended.insert(vchExtended.end(), mtx.vin.size(), 0);
+    vchExtended.insert(vchExtended.end(), vchTx.end() - 4, vchTx.end());
+
+    CBlock block;
+    std::shared_ptr<std::vector<unsigned char> > buffer = std::make_shared<std::vector<unsigned char> >();
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, *buffer, 0, block.GetBlockHeader());
+    buffer->push_back(1); // One transaction
+    buffer->insert(buffer->end(), vchExtended.begin(), vchExtended.end());
+
+    CBlockView view;
+    BOOST_CHECK(view.Parse(buffer));
+    BOOST_CHECK(!view.HasWitness());
+    BOOST_CHECK(view.GetTxHash(0) == mtx.GetHash());
+    BOOST_CHECK(view.GetWitnessHash(0) == mtx.GetHash());
+    BOOST_CHECK(view.GetTransaction(0)->GetHash() == mtx.GetHash());
+    std::vector<unsigned char> vchBlock;
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, vchBlock, 0, view);
+    BOOST_CHECK_EQUAL(vchBlock.size(), 81 + vchTx.size());
+    BOOST_CHECK(std::equal(vchTx.begin(), vchTx.end(), vchBlock.begin() + 81));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -50,7 +50,7 @@ public:
 
     uint256 GetBestBlock() const { return hashBestBlock_; }
 
-    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, bool fErase)
     {
         for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); ) {
             if (it->second.flags & CCoinsCacheEntry::DIRTY) {
@@ -61,7 +61,10 @@ public:
                     map_.erase(it->first);
                 }
             }
-            mapCoins.erase(it++);
+            if (fErase)
+                mapCoins.erase(it++);
+            else
+                ++it;
         }
         if (!hashBlock.IsNull())
             hashBestBlock_ = hashBlock;
@@ -113,6 +116,8 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     bool updated_an_entry = false;
     bool found_an_entry = false;
     bool missed_an_entry = false;
+    bool synced_a_cache = false;
+    bool evicted_an_entry = false;
 
     // A simple map to track what we expect the cache stack to represent.
     std::map<uint256, CCoins> result;
@@ -171,10 +176,20 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
         }
 
         if (insecure_rand() % 100 == 0) {
-            // Every 100 iterations, flush an intermediate cache
+            // Every 100 iterations, flush an intermediate cache, or sync it
+            // and trim it to a random size
             if (stack.size() > 1 && insecure_rand() % 2 == 0) {
                 unsigned int flushIndex = insecure_rand() % (stack.size() - 1);
-                stack[flushIndex]->Flush();
+                if (insecure_rand() % 2) {
+                    stack[flushIndex]->Flush();
+                } else {
+                    uint64_t nEvicted = stack[flushIndex]->GetStats().nEvicted;
+                    stack[flushIndex]->Sync(insecure_rand() % (stack[flushIndex]->DynamicMemoryUsage() + 1));
+                    for (CCoinsMap::iterator it = stack[flushIndex]->map().begin(); it != stack[flushIndex]->map().end(); it++)
+                        BOOST_CHECK(it->second.flags == 0 && !it->second.coins.IsPruned());
+                    synced_a_cache = true;
+                    evicted_an_entry |= stack[flushIndex]->GetStats().nEvicted > nEvicted;
+                }
             }
         }
         if (insecure_rand() % 100 == 0) {
@@ -215,6 +230,8 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     BOOST_CHECK(updated_an_entry);
     BOOST_CHECK(found_an_entry);
     BOOST_CHECK(missed_an_entry);
+    BOOST_CHECK(synced_a_cache);
+    BOOST_CHECK(evicted_an_entry);
 }
 
 typedef std::tuple<CTransaction,CTxUndo,CCoins> TxData;
@@ -430,6 +447,101 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
     BOOST_CHECK(spent_a_duplicate_coinbase);
 }
 
+// Random insertions and erasures on CCoinsMap, checked against a std::map.
+// Keys are drawn from a small set so that the table keeps reusing slots that
+// entries were erased from, and goes through several rebuilds.
+BOOST_AUTO_TEST_CASE(ccoins_map_test)
+{
+    std::vector<uint256> txids(3000);
+    for (uint256& txid : txids)
+        txid = GetRandHash();
+
+    CCoinsMap map;
+    std::map<uint256, int> expected;
+    for (int i = 0; i < 100000; i++) {
+        const uint256& txid = txids[insecure_rand() % txids.size()];
+        if (insecure_rand() % 3 == 0) {
+            BOOST_CHECK_EQUAL(map.erase(txid), expected.erase(txid));
+        } else {
+            CCoinsCacheEntry entry;
+            entry.coins.nVersion = i;
+            bool fInserted = map.emplace(txid, std::move(entry)).second;
+            BOOST_CHECK_EQUAL(fInserted, expected.emplace(txid, i).second);
+        }
+        if (i % 10000 == 0) {
+            // Erase some entries while iterating, like BatchWrite does
+            for (CCoinsMap::iterator it = map.begin(); it != map.end(); ) {
+                CCoinsMap::iterator itOld = it++;
+                if (insecure_rand() % 2) {
+                    expected.erase(itOld->first);
+                    map.erase(itOld);
+                }
+            }
+        }
+    }
+
+    BOOST_CHECK_EQUAL(map.size(), expected.size());
+    size_t nFound = 0;
+    for (const auto& entry : map) {
+        BOOST_CHECK_EQUAL(entry.second.coins.nVersion, expected.at(entry.first));
+        nFound++;
+    }
+    BOOST_CHECK_EQUAL(nFound, expected.size());
+    for (const uint256& txid : txids)
+        BOOST_CHECK_EQUAL(map.count(txid), expected.count(txid));
+
+    // Pointers to entries survive the table growing
+    CCoinsCacheEntry* pentry = &map[txids[0]];
+    for (int i = 0; i < 10000; i++)
+        map[GetRandHash()];
+    BOOST_CHECK(&map.find(txids[0])->second == pentry);
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_sync)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    std::vector<uint256> txids(100);
+    CCoins coins;
+    coins.vout.resize(1);
+    coins.vout[0].nValue = 1;
+    for (uint256& txid : txids) {
+        txid = GetRandHash();
+        *cache.ModifyNewCoins(txid, false) = coins;
+    }
+
+    // Syncing without a memory limit writes everything and keeps it all, clean
+    BOOST_CHECK(cache.Sync(std::numeric_limits<size_t>::max()));
+    BOOST_CHECK_EQUAL(cache.GetStats().nRetained, txids.size());
+    for (const uint256& txid : txids) {
+        CCoins written;
+        BOOST_CHECK(base.GetCoins(txid, written) && written == coins);
+        BOOST_CHECK(cache.HaveCoinsInCache(txid));
+        BOOST_CHECK_EQUAL(cache.map().find(txid)->second.flags, 0);
+    }
+    cache.SelfTest();
+
+    // Leave room for 10 entries: the ones used since the last sync stay
+    for (size_t i = 0; i < 10; i++)
+        BOOST_CHECK(cache.AccessCoins(txids[i]));
+    size_t nEntryUsage = CCoinsMap::ENTRY_SIZE + coins.DynamicMemoryUsage();
+    BOOST_CHECK(cache.Sync(cache.DynamicMemoryUsage() - 90 * nEntryUsage));
+    BOOST_CHECK_EQUAL(cache.GetStats().nEvicted, 90);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 10);
+    for (size_t i = 0; i < txids.size(); i++)
+        BOOST_CHECK_EQUAL(cache.HaveCoinsInCache(txids[i]), i < 10);
+    cache.SelfTest();
+
+    uint64_t nMisses = cache.GetStats().nMisses;
+    BOOST_CHECK(cache.AccessCoins(txids[50]));
+    BOOST_CHECK_EQUAL(cache.GetStats().nMisses, nMisses + 1);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0);
+}
+
 BOOST_AUTO_TEST_CASE(ccoins_serialization)
 {
     // Good example
@@ -564,7 +676,7 @@ void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
     CCoinsMap map;
     InsertCoinsMapEntry(map, value, flags);
-    view.BatchWrite(map, {});
+    view.BatchWrite(map, {}, true);
 }
 
 class SingleEntryCacheTest
@@ -3,12 +3,15 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "crypto/aes.h"
+#include "crypto/common.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/muhash.h"
+#include "streams.h"
 #include "utilstrencodings.h"
 #include "test/test_bitcoin.h"
 #include "test/test_random.h"
@@ -439,4 +442,72 @@ BOOST_AUTO_TEST_CASE(aes_cbc_testvectors) {
                   "b2eb05e2c39be9fcda6c19078c6a9d1b3f461796d6b0d6b2e0c2a72b4d80e644");
 }
 
+static std::string MuHashHex(const MuHash3072& muhash)
+{
+    MuHash3072 tmp(muhash);
+    unsigned char out[MuHash3072::OUTPUT_SIZE];
+    tmp.Finalize(out);
+    return HexStr(out, out + sizeof(out));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    unsigned char one[Num3072::BYTE_SIZE] = {1};
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(one, sizeof(one)).Finalize(hash);
+    BOOST_CHECK_EQUAL(MuHashHex(MuHash3072()), HexStr(hash, hash + sizeof(hash)));
+
+    // Division is the inverse of multiplication, including for values above the modulus
+    unsigned char data[Num3072::BYTE_SIZE];
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = i * 7 + 3;
+    Num3072 x(data);
+    x.Multiply(Num3072(data));
+    x.Divide(Num3072(data));
+    x.Divide(Num3072(data));
+    unsigned char out[Num3072::BYTE_SIZE];
+    x.ToBytes(out);
+    BOOST_CHECK(memcmp(out, one, sizeof(one)) == 0);
+    memset(data, 0xff, sizeof(data));
+    x = Num3072(data);
+    x.Divide(Num3072(data));
+    x.ToBytes(out);
+    BOOST_CHECK(memcmp(out, one, sizeof(one)) == 0);
+
+    // Order of insertions and removals does not matter
+    const unsigned char a[] = "a", b[] = "b", c[] = "c";
+    MuHash3072 acb;
+    acb.Insert(a, 1).Insert(b, 1).Insert(c, 1).Remove(b, 1);
+    MuHash3072 ca;
+    ca.Insert(c, 1).Insert(a, 1);
+    BOOST_CHECK_EQUAL(MuHashHex(acb), MuHashHex(ca));
+    BOOST_CHECK(MuHashHex(acb) != MuHashHex(MuHash3072().Insert(a, 1)));
+    MuHash3072 removed;
+    removed.Remove(a, 1).Insert(a, 1);
+    BOOST_CHECK_EQUAL(MuHashHex(removed), MuHashHex(MuHash3072()));
+
+    // Sets combine and split
+    MuHash3072 set(MuHash3072().Insert(a, 1));
+    set *= MuHash3072().Insert(c, 1);
+    BOOST_CHECK_EQUAL(MuHashHex(set), MuHashHex(ca));
+    set /= MuHash3072().Insert(a, 1);
+    BOOST_CHECK_EQUAL(MuHashHex(set), MuHashHex(MuHash3072().Insert(c, 1)));
+
+    // Serialization keeps the pending removals
+    CDataStream ss(SER_DISK, 0);
+    ss << acb;
+    BOOST_CHECK(ss.size() == MuHash3072::SERIALIZED_SIZE);
+    MuHash3072 acb2;
+    ss >> acb2;
+    BOOST_CHECK_EQUAL(MuHashHex(acb2), MuHashHex(ca));
+
+    MuHash3072 many;
+    for (uint32_t i = 0; i < 10000; i++) {
+        unsigned char element[4];
+        WriteLE32(element, i);
+        many.Insert(element, sizeof(element));
+    }
+    BOOST_CHECK_EQUAL(MuHashHex(many), "07809a216a1f5cd88fc3591603bb2c558b13c4d746cfd4b6bc8839eadbed599e");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
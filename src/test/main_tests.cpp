@@ -3,8 +3,11 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chainparams.h"
+#include "consensus/validation.h"
 #include "validation.h"
 #include "net.h"
+#include "pow.h"
+#include "random.h"
 
 #include "test/test_bitcoin.h"
 
@@ -73,4 +76,47 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+BOOST_FIXTURE_TEST_CASE(process_new_block_headers, TestChain100Setup)
+{
+    const CChainParams& chainparams = Params();
+    const Consensus::Params& consensusParams = chainparams.GetConsensus();
+    const int nTipHeight = chainActive.Height();
+
+    std::vector<CBlockHeader> headers;
+    CBlockHeader prev = chainActive.Tip()->GetBlockHeader();
+    for (int i = 0; i < 300; i++) {
+        CBlockHeader header;
+        header.nVersion = 4;
+        header.hashPrevBlock = prev.GetHash();
+        header.hashMerkleRoot = GetRandHash();
+        header.nTime = prev.nTime + 1;
+        header.nBits = prev.nBits;
+        header.nNonce = 0;
+        while (!CheckProofOfWork(header.GetHash(), header.nBits, consensusParams))
+            header.nNonce++;
+        headers.push_back(header);
+        prev = header;
+    }
+
+    // A header with invalid proof of work stops the batch, after the headers before it were added
+    std::vector<CBlockHeader> invalid(headers.begin(), headers.begin() + 200);
+    while (CheckProofOfWork(invalid[150].GetHash(), invalid[150].nBits, consensusParams))
+        invalid[150].nNonce++;
+    CValidationState state;
+    const CBlockIndex* pindex = NULL;
+    BOOST_CHECK(!ProcessNewBlockHeaders(invalid, state, chainparams, &pindex));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+    BOOST_CHECK(pindex != NULL && pindex->GetBlockHash() == headers[149].GetHash());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(mapBlockIndex.count(headers[149].GetHash()));
+        BOOST_CHECK(!mapBlockIndex.count(invalid[150].GetHash()));
+    }
+
+    CValidationState state2;
+    BOOST_CHECK(ProcessNewBlockHeaders(headers, state2, chainparams, &pindex));
+    BOOST_CHECK(pindex->GetBlockHash() == headers.back().GetHash());
+    BOOST_CHECK_EQUAL(pindex->nHeight, nTipHeight + 300);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
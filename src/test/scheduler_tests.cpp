@@ -114,4 +114,75 @@ BOOST_AUTO_TEST_CASE(manythreads)
     BOOST_CHECK_EQUAL(counterSum, 200);
 }
 
+BOOST_AUTO_TEST_CASE(singlethreadedscheduler_ordered)
+{
+    CScheduler scheduler;
+
+    // each queue should be well ordered with respect to itself but not other queues
+    SingleThreadedSchedulerClient queue1(&scheduler);
+    SingleThreadedSchedulerClient queue2(&scheduler);
+
+    // create more threads than queues
+    // if the queues only permit execution of one task at once then
+    // the extra threads should effectively be doing nothing
+    // if they don't we'll get out of order behaviour
+    boost::thread_group threads;
+    for (int i = 0; i < 5; ++i) {
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    }
+
+    // these are not atomic, if SingleThreadedSchedulerClient prevents
+    // parallel execution at the queue level no synchronization should be required here
+    int counter1 = 0;
+    int counter2 = 0;
+    bool fOrdered1 = true;
+    bool fOrdered2 = true;
+
+    // just simply count up on each queue - if execution is properly ordered then
+    // the callbacks should run in exactly the order in which they were enqueued
+    for (int i = 0; i < 100; ++i) {
+        queue1.AddToProcessQueue([i, &counter1, &fOrdered1]() {
+            if (i != counter1++) fOrdered1 = false;
+        });
+
+        queue2.AddToProcessQueue([i, &counter2, &fOrdered2]() {
+            if (i != counter2++) fOrdered2 = false;
+        });
+    }
+
+    // wait for the callbacks, including the one currently running, to finish
+    queue1.WaitForPending(0);
+    queue2.WaitForPending(0);
+    BOOST_CHECK_EQUAL(queue1.CallbacksPending(), 0);
+    BOOST_CHECK_EQUAL(queue2.CallbacksPending(), 0);
+
+    // finish up
+    scheduler.stop(true);
+    threads.join_all();
+
+    BOOST_CHECK(fOrdered1);
+    BOOST_CHECK(fOrdered2);
+    BOOST_CHECK_EQUAL(counter1, 100);
+    BOOST_CHECK_EQUAL(counter2, 100);
+}
+
+BOOST_AUTO_TEST_CASE(singlethreadedscheduler_emptyqueue)
+{
+    CScheduler scheduler;
+    SingleThreadedSchedulerClient queue(&scheduler);
+
+    // without a thread servicing the scheduler, callbacks just pile up...
+    int counter = 0;
+    for (int i = 0; i < 10; ++i) {
+        queue.AddToProcessQueue([&counter]() { counter++; });
+    }
+    BOOST_CHECK_EQUAL(queue.CallbacksPending(), 10);
+    BOOST_CHECK_EQUAL(counter, 0);
+
+    // ...until they are run on the calling thread
+    queue.EmptyQueue();
+    BOOST_CHECK_EQUAL(queue.CallbacksPending(), 0);
+    BOOST_CHECK_EQUAL(counter, 10);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
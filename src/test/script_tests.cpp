@@ -13,6 +13,7 @@
 #include "util.h"
 #include "utilstrencodings.h"
 #include "test/test_bitcoin.h"
+#include "test/test_random.h"
 #include "rpc/server.h"
 
 #if defined(HAVE_CONSENSUS_LIB)
@@ -167,6 +168,10 @@ void DoTest(const CScript& scriptPubKey, const CScript& scriptSig, const CScript
     CMutableTransaction tx2 = tx;
     BOOST_CHECK_MESSAGE(VerifyScript(scriptSig, scriptPubKey, &scriptWitness, flags, MutableTransactionSignatureChecker(&tx, 0, txCredit.vout[0].nValue), &err) == expect, message);
     BOOST_CHECK_MESSAGE(err == scriptError, std::string(FormatScriptError(err)) + " where " + std::string(FormatScriptError((ScriptError_t)scriptError)) + " expected: " + message);
+    // Again, on buffers left over by the previous tests
+    static ScriptExecutionArena arena;
+    BOOST_CHECK_MESSAGE(VerifyScript(scriptSig, scriptPubKey, &scriptWitness, flags, MutableTransactionSignatureChecker(&tx, 0, txCredit.vout[0].nValue), &err, &arena) == expect, message);
+    BOOST_CHECK_MESSAGE(err == scriptError, std::string(FormatScriptError(err)) + " where " + std::string(FormatScriptError((ScriptError_t)scriptError)) + " expected: " + message);
 #if defined(HAVE_CONSENSUS_LIB)
     CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
     stream << tx2;
@@ -1438,4 +1443,135 @@ BOOST_AUTO_TEST_CASE(script_FindAndDelete)
     BOOST_CHECK(s == expect);
 }
 
+/** Signature checker whose answer depends on all of its arguments, so that any difference in them shows */
+class HashSignatureChecker : public BaseSignatureChecker
+{
+    bool fAlwaysValid;
+
+public:
+    HashSignatureChecker(bool fAlwaysValidIn) : fAlwaysValid(fAlwaysValidIn) {}
+
+    bool CheckSig(const std::vector<unsigned char>& vchSig, const std::vector<unsigned char>& vchPubKey, const CScript& scriptCode, SigVersion sigversion) const
+    {
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << vchSig << vchPubKey << static_cast<const CScriptBase&>(scriptCode) << (int)sigversion;
+        return fAlwaysValid || (ss.GetHash().GetCheapHash() & 1);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(script_standard_fastpath)
+{
+    // EvalScript runs P2PKH and multisig scripts without the generic
+    // interpreter; compare the two on random arguments
+    seed_insecure_rand(false);
+
+    std::vector<std::vector<unsigned char> > vKeys;
+    std::vector<std::vector<unsigned char> > vSigs;
+    for (int i = 0; i < 4; i++) {
+        CKey key;
+        key.MakeNewKey(i % 2 == 0);
+        vKeys.push_back(ToByteVector(key.GetPubKey()));
+        for (int j = 0; j < 3; j++) {
+            std::vector<unsigned char> vchSig;
+            BOOST_CHECK(key.Sign(GetRandHash(), vchSig));
+            vchSig.push_back(j == 0 ? (unsigned char)insecure_rand() : (unsigned char)SIGHASH_ALL);
+            vSigs.push_back(vchSig);
+        }
+    }
+    std::vector<unsigned char> vchBadKey(vKeys[0]);
+    vchBadKey[0] = 0x05;
+    vKeys.push_back(vchBadKey);
+    vSigs.push_back(std::vector<unsigned char>());
+    vSigs.push_back(std::vector<unsigned char>(9, 0x30));
+
+    const unsigned int vFlags[] = {SCRIPT_VERIFY_STRICTENC, SCRIPT_VERIFY_DERSIG, SCRIPT_VERIFY_LOW_S, SCRIPT_VERIFY_NULLFAIL,
+                                   SCRIPT_VERIFY_NULLDUMMY, SCRIPT_VERIFY_MINIMALDATA, SCRIPT_VERIFY_WITNESS_PUBKEYTYPE};
+    for (int i = 0; i < 20000; i++) {
+        bool fMultisig = insecure_rand() % 2;
+        CScript script;
+        std::vector<std::vector<unsigned char> > stack;
+        for (int j = insecure_rand() % 3; j > 0; j--)
+            stack.push_back(std::vector<unsigned char>(insecure_rand() % 3, 0));
+
+        if (!fMultisig) {
+            const std::vector<unsigned char>& vchKey = vKeys[insecure_rand() % vKeys.size()];
+            script << OP_DUP << OP_HASH160 << ToByteVector(insecure_rand() % 8 ? Hash160(vchKey) : uint160()) << OP_EQUALVERIFY << OP_CHECKSIG;
+            if (insecure_rand() % 8)
+                stack.push_back(vSigs[insecure_rand() % vSigs.size()]);
+            if (insecure_rand() % 8)
+                stack.push_back(vchKey);
+        } else {
+            int nKeys = 1 + insecure_rand() % 3;
+            int nRequired = 1 + insecure_rand() % nKeys;
+            std::vector<std::vector<unsigned char> > vScriptKeys;
+            for (int j = 0; j < nKeys; j++)
+                vScriptKeys.push_back(vKeys[insecure_rand() % vKeys.size()]);
+            script << CScript::EncodeOP_N(nRequired);
+            for (const std::vector<unsigned char>& vchKey : vScriptKeys)
+                script << vchKey;
+            script << CScript::EncodeOP_N(nKeys) << OP_CHECKMULTISIG;
+
+            stack.push_back(std::vector<unsigned char>(insecure_rand() % 8 ? 0 : 1, 0));
+            for (int j = nRequired - 1 + insecure_rand() % 3; j > 0; j--) {
+                // Signatures that are also pushes of the script exercise FindAndDelete
+                if (insecure_rand() % 8)
+                    stack.push_back(vSigs[insecure_rand() % vSigs.size()]);
+                else
+                    stack.push_back(vScriptKeys[insecure_rand() % nKeys]);
+            }
+        }
+        if (insecure_rand() % 64 == 0)
+            stack.insert(stack.begin(), 997 - insecure_rand() % 4 - stack.size(), std::vector<unsigned char>());
+
+        unsigned int flags = 0;
+        for (unsigned int flag : vFlags) {
+            if (insecure_rand() % 2)
+                flags |= flag;
+        }
+        SigVersion sigversion = insecure_rand() % 2 ? SIGVERSION_BASE : SIGVERSION_WITNESS_V0;
+        HashSignatureChecker checker(insecure_rand() % 2);
+
+        std::vector<std::vector<unsigned char> > stackFast(stack);
+        ScriptError err, errFast;
+        bool fResult = EvalScriptGeneric(stack, script, flags, checker, sigversion, &err);
+        bool fResultFast = EvalScript(stackFast, script, flags, checker, sigversion, &errFast);
+        BOOST_CHECK_EQUAL(fResultFast, fResult);
+        BOOST_CHECK_EQUAL(errFast, err);
+        if (fResult)
+            BOOST_CHECK(stackFast == stack);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(script_arena)
+{
+    typedef std::vector<unsigned char> valtype;
+    ScriptExecutionArena arena;
+    std::vector<valtype> stack;
+    arena.Acquire(stack);
+
+    // Popped elements' buffers are reused by the next pushes
+    arena.Push(stack, valtype(40, 1));
+    const unsigned char* pBuffer = stack.back().data();
+    arena.Pop(stack);
+    arena.Push(stack, valtype(30, 2));
+    BOOST_CHECK(stack.back().data() == pBuffer);
+    BOOST_CHECK(stack.back() == valtype(30, 2));
+
+    // Oversized ones are not kept
+    arena.Push(stack, valtype(MAX_SCRIPT_ELEMENT_SIZE + 1, 3));
+    pBuffer = stack.back().data();
+    arena.Pop(stack);
+    arena.Push(stack, valtype(MAX_SCRIPT_ELEMENT_SIZE + 1, 4));
+    BOOST_CHECK(stack.back().data() != pBuffer);
+
+    // Released stacks are handed out again, without their elements
+    const valtype* pStack = stack.data();
+    arena.Release(stack);
+    BOOST_CHECK(stack.empty());
+    std::vector<valtype> stack2;
+    arena.Acquire(stack2);
+    BOOST_CHECK(stack2.empty());
+    BOOST_CHECK(stack2.data() == pStack);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
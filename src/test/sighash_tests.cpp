@@ -166,6 +166,40 @@ BOOST_AUTO_TEST_CASE(sighash_test)
     #endif
 }
 
+// Goal: check that precomputed legacy hashing matches on transactions with many inputs
+BOOST_AUTO_TEST_CASE(sighash_precomputed)
+{
+    seed_insecure_rand(false);
+
+    for (int i = 0; i < 20; i++) {
+        CMutableTransaction txTo;
+        RandomTransaction(txTo, false);
+        int nInputs = LEGACY_SIGHASH_CACHE_MIN_INPUTS + insecure_rand() % (4 * LEGACY_SIGHASH_MIDSTATE_INTERVAL);
+        while ((int)txTo.vin.size() < nInputs) {
+            txTo.vin.push_back(txTo.vin[insecure_rand() % txTo.vin.size()]);
+            txTo.vin.back().prevout.hash = GetRandHash();
+        }
+        const CTransaction tx(txTo);
+        PrecomputedTransactionData txdata(tx);
+        BOOST_CHECK_EQUAL(txdata.vLegacyMidstates.size(), (tx.vin.size() + LEGACY_SIGHASH_MIDSTATE_INTERVAL - 1) / LEGACY_SIGHASH_MIDSTATE_INTERVAL);
+
+        for (int j = 0; j < 50; j++) {
+            int nHashType = insecure_rand();
+            CScript scriptCode;
+            RandomScript(scriptCode);
+            int nIn = insecure_rand() % tx.vin.size();
+            uint256 sho = SignatureHashOld(scriptCode, tx, nIn, nHashType);
+            BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, 0, SIGVERSION_BASE, &txdata) == sho);
+            BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, SIGHASH_ALL, 0, SIGVERSION_BASE, &txdata) == SignatureHashOld(scriptCode, tx, nIn, SIGHASH_ALL));
+        }
+    }
+
+    // Smaller transactions are hashed without it
+    CMutableTransaction txTo;
+    RandomTransaction(txTo, false);
+    BOOST_CHECK(PrecomputedTransactionData(txTo).vLegacyMidstates.empty());
+}
+
 // Goal: check that SignatureHash generates correct hash
 BOOST_AUTO_TEST_CASE(sighash_from_data)
 {
@@ -121,4 +121,25 @@ BOOST_AUTO_TEST_CASE(streams_serializedata_xor)
             std::string(ds.begin(), ds.end()));  
 }         
 
+BOOST_AUTO_TEST_CASE(streams_plain)
+{
+    // Plain streams read and write like wiping ones, and convert to and from them
+    CPlainDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << std::string("abc") << (uint32_t)42;
+    CDataStream ssWiped(ss.data(), ss.data() + ss.size(), SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK_EQUAL(ssWiped.str(), ss.str());
+
+    CSerializeData data;
+    ssWiped.GetAndClear(data);
+    CPlainDataStream ssCopy(data, SER_NETWORK, PROTOCOL_VERSION);
+    std::string str;
+    uint32_t n;
+    ssCopy >> str >> n;
+    BOOST_CHECK_EQUAL(str, "abc");
+    BOOST_CHECK_EQUAL(n, 42U);
+    BOOST_CHECK(ssCopy.empty());
+    BOOST_CHECK(ss.Rewind(0));
+    BOOST_CHECK_EQUAL((ss + ss).size(), 2 * ss.size());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
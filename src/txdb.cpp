@@ -6,6 +6,7 @@
 #include "txdb.h"
 
 #include "chainparams.h"
+#include "coinstats.h"
 #include "hash.h"
 #include "pow.h"
 #include "uint256.h"
@@ -23,9 +24,12 @@ static const char DB_BEST_BLOCK = 'B';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_UTXO_COMMITMENT = 'M';
+static const char DB_SNAPSHOT_LOAD = 'S';
+static const char DB_BLOCK_INDEX_SNAPSHOT = 'I';
 
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe, const CDBProfile& profile) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true, profile)
 {
 }
 
@@ -44,7 +48,7 @@ uint256 CCoinsViewDB::GetBestBlock() const {
     return hashBestChain;
 }
 
-bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -58,7 +62,8 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
         }
         count++;
         CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        if (fErase)
+            mapCoins.erase(itOld);
     }
     if (!hashBlock.IsNull())
         batch.Write(DB_BEST_BLOCK, hashBlock);
@@ -67,7 +72,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     return db.WriteBatch(batch);
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe, const CDBProfile& profile) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, false, profile) {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -92,20 +97,74 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
-    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper*>(&db)->NewIterator(), GetBestBlock());
-    /* It seems that there are no "const iterators" for LevelDB.  Since we
-       only need read operations on it, use a const-cast to get around
-       that restriction.  */
-    i->pcursor->Seek(DB_COINS);
-    // Cache key of first record
-    i->pcursor->GetKey(i->keyTmp);
-    return i;
+    return PartitionedCursors(1)[0].release();
+}
+
+std::vector<std::unique_ptr<CCoinsViewCursor> > CCoinsViewDB::PartitionedCursors(int nParts) const
+{
+    assert(nParts >= 1 && nParts <= 256);
+    std::shared_ptr<CDBSnapshot> snapshot = std::make_shared<CDBSnapshot>(db);
+    uint256 hashBestChain;
+    if (!snapshot->Read(DB_BEST_BLOCK, hashBestChain))
+        hashBestChain.SetNull();
+
+    std::vector<std::unique_ptr<CCoinsViewCursor> > vCursors;
+    for (int i = 0; i < nParts; i++) {
+        // Split on the first byte of the txids, which are uniformly distributed
+        uint256 txidStart;
+        *txidStart.begin() = 256 * i / nParts;
+        CCoinsViewDBCursor *c = new CCoinsViewDBCursor(snapshot, hashBestChain, 256 * (i + 1) / nParts);
+        vCursors.emplace_back(c);
+        c->pcursor->Seek(std::make_pair(DB_COINS, txidStart));
+        // Cache key of first record
+        if (c->pcursor->Valid()) {
+            c->pcursor->GetKey(c->keyTmp);
+        } else {
+            c->keyTmp.first = 0;
+        }
+    }
+    return vCursors;
+}
+
+bool CCoinsViewDB::ReadUTXOCommitment(CUTXOCommitment &commitment) const {
+    return db.Read(DB_UTXO_COMMITMENT, commitment);
+}
+
+bool CCoinsViewDB::WriteUTXOCommitment(const CUTXOCommitment &commitment) {
+    return db.Write(DB_UTXO_COMMITMENT, commitment);
+}
+
+bool CCoinsViewDB::BeginSnapshotLoad(const uint256 &hashBlock) {
+    return db.Write(DB_SNAPSHOT_LOAD, hashBlock, true);
+}
+
+bool CCoinsViewDB::WriteSnapshotCoins(const std::vector<std::pair<uint256, CCoins> > &vCoins) {
+    CDBBatch batch(db);
+    for (const std::pair<uint256, CCoins> &coins : vCoins)
+        batch.Write(std::make_pair(DB_COINS, coins.first), coins.second);
+    LogPrint("coindb", "Writing %u transactions of a UTXO set snapshot to coin database...\n", (unsigned int)vCoins.size());
+    return db.WriteBatch(batch);
+}
+
+bool CCoinsViewDB::EndSnapshotLoad(const uint256 &hashBlock) {
+    CDBBatch batch(db);
+    batch.Write(DB_BEST_BLOCK, hashBlock);
+    batch.Erase(DB_SNAPSHOT_LOAD);
+    return db.WriteBatch(batch, true);
+}
+
+bool CCoinsViewDB::IsLoadingSnapshot() const {
+    return db.Exists(DB_SNAPSHOT_LOAD);
+}
+
+void CCoinsViewDB::Compact() const {
+    db.CompactHashed(DB_COINS);
 }
 
 bool CCoinsViewDBCursor::GetKey(uint256 &key) const
 {
     // Return cached key
-    if (keyTmp.first == DB_COINS) {
+    if (Valid()) {
         key = keyTmp.second;
         return true;
     }
@@ -124,7 +183,7 @@ unsigned int CCoinsViewDBCursor::GetValueSize() const
 
 bool CCoinsViewDBCursor::Valid() const
 {
-    return keyTmp.first == DB_COINS;
+    return keyTmp.first == DB_COINS && *keyTmp.second.begin() < nEndByte;
 }
 
 void CCoinsViewDBCursor::Next()
@@ -146,15 +205,41 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     return WriteBatch(batch, true);
 }
 
-bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
-    return Read(std::make_pair(DB_TXINDEX, txid), pos);
-}
+bool CBlockTreeDB::MoveTxIndex(CTxIndexDB &txindex) {
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_TXINDEX, uint256()));
+    if (!pcursor->Valid())
+        return true;
+    std::pair<char, uint256> key;
+    if (!pcursor->GetKey(key) || key.first != DB_TXINDEX)
+        return true;
 
-bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(std::make_pair(DB_TXINDEX, it->first), it->second);
-    return WriteBatch(batch);
+    LogPrintf("Moving the transaction index to its own database...\n");
+    size_t nMoved = 0;
+    bool fMore = true;
+    while (fMore) {
+        std::vector<std::pair<uint256, CDiskTxPos> > vMove;
+        CDBBatch batchErase(*this);
+        while (vMove.size() < 100000) {
+            boost::this_thread::interruption_point();
+            if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_TXINDEX) {
+                fMore = false;
+                break;
+            }
+            CDiskTxPos pos;
+            if (!pcursor->GetValue(pos))
+                return error("%s: failed to read transaction index value", __func__);
+            vMove.push_back(std::make_pair(key.second, pos));
+            batchErase.Erase(key);
+            pcursor->Next();
+        }
+        // Erase what was moved only once it is safely in the new database; moving it again is harmless
+        if (!vMove.empty() && (!txindex.WriteTxIndex(vMove) || !txindex.Sync() || !WriteBatch(batchErase, true)))
+            return false;
+        nMoved += vMove.size();
+    }
+    LogPrintf("Moved %u transaction index records\n", nMoved);
+    return true;
 }
 
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
@@ -169,6 +254,36 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
+CTxIndexDB::CTxIndexDB(size_t nCacheSize, bool fMemory, bool fWipe, const CDBProfile& profile) : CDBWrapper(GetDataDir() / "blocks" / "txindex", nCacheSize, fMemory, fWipe, false, profile) {
+}
+
+bool CTxIndexDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
+    return Read(std::make_pair(DB_TXINDEX, txid), pos);
+}
+
+bool CTxIndexDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        batch.Write(std::make_pair(DB_TXINDEX, it->first), it->second);
+    return WriteBatch(batch);
+}
+
+void CTxIndexDB::Compact() const {
+    CompactHashed(DB_TXINDEX);
+}
+
+bool CBlockTreeDB::WriteBlockIndexSnapshot(const uint256 &nonce) {
+    return Write(DB_BLOCK_INDEX_SNAPSHOT, nonce, true);
+}
+
+bool CBlockTreeDB::ReadBlockIndexSnapshot(uint256 &nonce) {
+    return Read(DB_BLOCK_INDEX_SNAPSHOT, nonce);
+}
+
+bool CBlockTreeDB::EraseBlockIndexSnapshot() {
+    return Erase(DB_BLOCK_INDEX_SNAPSHOT, true);
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex)
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
@@ -11,6 +11,7 @@
 #include "chain.h"
 
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -19,6 +20,7 @@
 
 class CBlockIndex;
 class CCoinsViewDBCursor;
+class CUTXOCommitment;
 class uint256;
 
 //! -dbcache default (MiB)
@@ -27,14 +29,22 @@ static const int64_t nDefaultDbCache = 300;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
 static const int64_t nMinDbCache = 4;
+//! -dbcacheretain default (percent)
+static const int nDefaultDbCacheRetain = 50;
+//! max. -dbcacheretain (percent), leaving room for blocks before the next flush
+static const int nMaxDbCacheRetain = 80;
 //! Max memory allocated to block tree DB specific cache, if no -txindex (MiB)
 static const int64_t nMaxBlockDBCache = 2;
-//! Max memory allocated to block tree DB specific cache, if -txindex (MiB)
+//! Max memory allocated to transaction index DB specific cache (MiB)
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
-static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
+static const int64_t nMaxTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Max memory allocated to coin DB specific cache during a bulk load, for larger write buffers (MiB)
+static const int64_t nMaxCoinsDBBulkLoadCache = 64;
+//! -dbstorage default
+static const char* const DEFAULT_DB_STORAGE = "ssd";
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -67,13 +77,37 @@ class CCoinsViewDB : public CCoinsView
 protected:
     CDBWrapper db;
 public:
-    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, const CDBProfile& profile = CDBProfile());
 
     bool GetCoins(const uint256 &txid, CCoins &coins) const;
     bool HaveCoins(const uint256 &txid) const;
     uint256 GetBestBlock() const;
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase);
     CCoinsViewCursor *Cursor() const;
+
+    /**
+     * Cursors over nParts disjoint ranges of txids which together cover the
+     * whole set, all reading from the same snapshot of the database, so they
+     * can be walked concurrently (one per thread) while blocks keep being
+     * connected.
+     */
+    std::vector<std::unique_ptr<CCoinsViewCursor> > PartitionedCursors(int nParts) const;
+
+    bool ReadUTXOCommitment(CUTXOCommitment &commitment) const;
+    bool WriteUTXOCommitment(const CUTXOCommitment &commitment);
+
+    /**
+     * Loading a UTXO set snapshot writes its coins directly to the database,
+     * which is marked meanwhile, so that an interrupted load is detected.
+     */
+    bool BeginSnapshotLoad(const uint256 &hashBlock);
+    bool WriteSnapshotCoins(const std::vector<std::pair<uint256, CCoins> > &vCoins);
+    //! Make hashBlock the best block, and drop the mark
+    bool EndSnapshotLoad(const uint256 &hashBlock);
+    bool IsLoadingSnapshot() const;
+
+    //! Compact the coins, see CDBWrapper::CompactHashed
+    void Compact() const;
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -90,19 +124,24 @@ public:
     void Next();
 
 private:
-    CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
-        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
+    CCoinsViewDBCursor(const std::shared_ptr<CDBSnapshot> &snapshotIn, const uint256 &hashBlockIn, int nEndByteIn):
+        CCoinsViewCursor(hashBlockIn), snapshot(snapshotIn), pcursor(snapshotIn->NewIterator()), nEndByte(nEndByteIn) {}
+    std::shared_ptr<CDBSnapshot> snapshot;
     std::unique_ptr<CDBIterator> pcursor;
     std::pair<char, uint256> keyTmp;
+    //! Txids whose first byte is at least this are past the end of the range
+    int nEndByte;
 
     friend class CCoinsViewDB;
 };
 
+class CTxIndexDB;
+
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
 public:
-    CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, const CDBProfile& profile = CDBProfile());
 private:
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
@@ -112,11 +151,34 @@ public:
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindex);
     bool ReadReindexing(bool &fReindex);
-    bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
-    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
+    //! Move the transaction index records that older versions kept here to txindex
+    bool MoveTxIndex(CTxIndexDB &txindex);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
+    //! Record (synchronously) that a block index snapshot was written, with a nonce it is identified by
+    bool WriteBlockIndexSnapshot(const uint256 &nonce);
+    bool ReadBlockIndexSnapshot(uint256 &nonce);
+    bool EraseBlockIndexSnapshot();
     bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
 };
 
+/**
+ * Access to the transaction index database (blocks/txindex/), kept apart from
+ * the block database so that its compactions, which are large with -txindex,
+ * do not slow down reads of the block index.
+ */
+class CTxIndexDB : public CDBWrapper
+{
+public:
+    CTxIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, const CDBProfile& profile = CDBProfile());
+private:
+    CTxIndexDB(const CTxIndexDB&);
+    void operator=(const CTxIndexDB&);
+public:
+    bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
+    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
+    //! Compact the index, see CDBWrapper::CompactHashed
+    void Compact() const;
+};
+
 #endif // BITCOIN_TXDB_H
@@ -113,6 +113,8 @@ bool fPrintToDebugLog = true;
 bool fLogTimestamps = DEFAULT_LOGTIMESTAMPS;
 bool fLogTimeMicros = DEFAULT_LOGTIMEMICROS;
 bool fLogIPs = DEFAULT_LOGIPS;
+bool fLogAsync = DEFAULT_LOGASYNC;
+unsigned int nLogRateLimit = DEFAULT_LOGRATELIMIT;
 std::atomic<bool> fReopenDebugLog(false);
 CTranslationInterface translationInterface;
 
@@ -188,11 +190,38 @@ static boost::once_flag debugPrintInitFlag = BOOST_ONCE_INIT;
  * are leaked on exit. This is ugly, but will be cleaned up by
  * the OS/libc. When the shutdown sequence is fully audited and
  * tested, explicit destruction of these objects can be implemented.
+ * The same goes for the state of the log writer thread and of the
+ * rate limit.
  */
 static FILE* fileout = NULL;
 static boost::mutex* mutexDebugLog = NULL;
 static std::list<std::string>* vMsgsBeforeOpenLog;
 
+/**
+ * With fLogAsync, messages are appended to strLogBuffer under mutexDebugLog,
+ * and written to fileout by a writer thread, so that logging threads never
+ * wait on the disk. The buffer is bounded: messages that do not fit are
+ * dropped, and only counted.
+ */
+static const size_t MAX_LOG_BUFFER_SIZE = 16 << 20;
+static std::string* strLogBuffer = NULL;
+static uint64_t nLogDropped = 0;
+static boost::condition_variable* condLogBuffer = NULL;
+static boost::thread* threadLogWriter = NULL;
+static bool fStopLogWriter = false;
+
+/** Messages counted and suppressed in the current one-second window, per debug category */
+struct CLogRateLimit
+{
+    int64_t nWindowStart;
+    unsigned int nMessages;
+    uint64_t nSuppressed;
+
+    CLogRateLimit() : nWindowStart(0), nMessages(0), nSuppressed(0) {}
+};
+static boost::mutex* mutexLogRateLimit = NULL;
+static std::map<std::string, CLogRateLimit>* mapLogRateLimits = NULL;
+
 static int FileWriteStr(const std::string &str, FILE *fp)
 {
     return fwrite(str.data(), 1, str.size(), fp);
@@ -203,6 +232,46 @@ static void DebugPrintInit()
     assert(mutexDebugLog == NULL);
     mutexDebugLog = new boost::mutex();
     vMsgsBeforeOpenLog = new std::list<std::string>;
+    strLogBuffer = new std::string();
+    condLogBuffer = new boost::condition_variable();
+    mutexLogRateLimit = new boost::mutex();
+    mapLogRateLimits = new std::map<std::string, CLogRateLimit>();
+}
+
+//! Reopen the log file if requested (by SIGHUP); the caller must be the only one writing to it
+static void ReopenDebugLogIfRequested()
+{
+    if (fReopenDebugLog.exchange(false)) {
+        boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+        if (freopen(pathDebug.string().c_str(),"a",fileout) != NULL && !fLogAsync)
+            setbuf(fileout, NULL); // unbuffered
+    }
+}
+
+static void DebugLogWriterThread()
+{
+    RenameThread("bitcoin-log");
+    std::string strWrite;
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+    while (true) {
+        while (strLogBuffer->empty() && nLogDropped == 0 && !fStopLogWriter)
+            condLogBuffer->wait(scoped_lock);
+        if (strLogBuffer->empty() && nLogDropped == 0)
+            return;
+        strWrite.swap(*strLogBuffer);
+        const uint64_t nDropped = nLogDropped;
+        nLogDropped = 0;
+
+        // Write without holding the lock, so that logging threads can go on
+        scoped_lock.unlock();
+        ReopenDebugLogIfRequested();
+        FileWriteStr(strWrite, fileout);
+        if (nDropped > 0)
+            FileWriteStr(strprintf("%u log messages dropped: the log writer could not keep up\n", nDropped), fileout);
+        fflush(fileout);
+        strWrite.clear();
+        scoped_lock.lock();
+    }
 }
 
 void OpenDebugLog()
@@ -215,18 +284,66 @@ void OpenDebugLog()
     boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
     fileout = fopen(pathDebug.string().c_str(), "a");
     if (fileout) {
-        setbuf(fileout, NULL); // unbuffered
+        if (!fLogAsync)
+            setbuf(fileout, NULL); // unbuffered
         // dump buffered messages from before we opened the log
         while (!vMsgsBeforeOpenLog->empty()) {
             FileWriteStr(vMsgsBeforeOpenLog->front(), fileout);
             vMsgsBeforeOpenLog->pop_front();
         }
+        if (fLogAsync) {
+            fflush(fileout);
+            threadLogWriter = new boost::thread(&DebugLogWriterThread);
+        }
     }
 
     delete vMsgsBeforeOpenLog;
     vMsgsBeforeOpenLog = NULL;
 }
 
+void StopDebugLogWriter()
+{
+    if (!threadLogWriter)
+        return;
+    {
+        boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+        fStopLogWriter = true;
+        condLogBuffer->notify_one();
+    }
+    threadLogWriter->join();
+
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+    delete threadLogWriter;
+    threadLogWriter = NULL;
+    // Anything logged after the writer thread took its last batch
+    FileWriteStr(*strLogBuffer, fileout);
+    strLogBuffer->clear();
+    setbuf(fileout, NULL); // unbuffered (which flushes)
+    fLogAsync = false;
+}
+
+//! Whether a message in category fits in the rate limit, and if so, the number of messages suppressed before it
+static bool LogRateLimitAccept(const char* category, uint64_t& nSuppressed)
+{
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    boost::mutex::scoped_lock scoped_lock(*mutexLogRateLimit);
+    CLogRateLimit& limit = (*mapLogRateLimits)[category];
+    const int64_t nNow = GetTimeMillis();
+    nSuppressed = 0;
+    if (nNow - limit.nWindowStart >= 1000) {
+        nSuppressed = limit.nSuppressed;
+        limit.nWindowStart = nNow;
+        limit.nMessages = 0;
+        limit.nSuppressed = 0;
+    }
+    if (limit.nMessages >= nLogRateLimit) {
+        limit.nSuppressed++;
+        return false;
+    }
+    limit.nMessages++;
+    return true;
+}
+
 bool LogAcceptCategory(const char* category)
 {
     if (category != NULL)
@@ -255,6 +372,14 @@ bool LogAcceptCategory(const char* category)
             setCategories.count(std::string("1")) == 0 &&
             setCategories.count(std::string(category)) == 0)
             return false;
+
+        if (nLogRateLimit > 0) {
+            uint64_t nSuppressed;
+            if (!LogRateLimitAccept(category, nSuppressed))
+                return false;
+            if (nSuppressed > 0)
+                LogPrintStr(strprintf("Suppressed %u messages in category %s (-logratelimit=%u)\n", nSuppressed, category, nLogRateLimit));
+        }
     }
     return true;
 }
@@ -312,16 +437,20 @@ int LogPrintStr(const std::string &str)
             ret = strTimestamped.length();
             vMsgsBeforeOpenLog->push_back(strTimestamped);
         }
-        else
+        else if (threadLogWriter)
         {
-            // reopen the log file, if requested
-            if (fReopenDebugLog) {
-                fReopenDebugLog = false;
-                boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
-                if (freopen(pathDebug.string().c_str(),"a",fileout) != NULL)
-                    setbuf(fileout, NULL); // unbuffered
+            // leave the writing to the log writer thread
+            if (strLogBuffer->size() + strTimestamped.size() > MAX_LOG_BUFFER_SIZE) {
+                nLogDropped++;
+            } else {
+                ret = strTimestamped.length();
+                strLogBuffer->append(strTimestamped);
             }
-
+            condLogBuffer->notify_one();
+        }
+        else
+        {
+            ReopenDebugLogIfRequested();
             ret = FileWriteStr(strTimestamped, fileout);
         }
     }
@@ -32,6 +32,9 @@
 static const bool DEFAULT_LOGTIMEMICROS = false;
 static const bool DEFAULT_LOGIPS        = false;
 static const bool DEFAULT_LOGTIMESTAMPS = true;
+static const bool DEFAULT_LOGASYNC      = true;
+/** Default for -logratelimit, in messages per second per debug category (0 = unlimited) */
+static const unsigned int DEFAULT_LOGRATELIMIT = 0;
 
 /** Signals for translation. */
 class CTranslationInterface
@@ -49,6 +52,8 @@ extern bool fPrintToDebugLog;
 extern bool fLogTimestamps;
 extern bool fLogTimeMicros;
 extern bool fLogIPs;
+extern bool fLogAsync;
+extern unsigned int nLogRateLimit;
 extern std::atomic<bool> fReopenDebugLog;
 extern CTranslationInterface translationInterface;
 
@@ -121,6 +126,8 @@ void ReadConfigFile(const std::string& confPath);
 boost::filesystem::path GetSpecialFolderPath(int nFolder, bool fCreate = true);
 #endif
 void OpenDebugLog();
+/** Write out what the debug log writer thread (with fLogAsync) has buffered, and write synchronously from now on */
+void StopDebugLogWriter();
 void ShrinkDebugFile();
 void runCommand(const std::string& strCommand);
 
@@ -0,0 +1,341 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxosnapshot.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "coinstats.h"
+#include "consensus/validation.h"
+#include "hash.h"
+#include "primitives/block.h"
+#include "protocol.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+#include "validation.h"
+
+#include <functional>
+#include <string.h>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+
+namespace {
+
+const unsigned char SNAPSHOT_MAGIC[5] = {'u', 't', 'x', 'o', 0xff};
+const uint16_t SNAPSHOT_VERSION = 1;
+//! Bytes buffered before writing to the snapshot file
+const size_t SNAPSHOT_WRITE_BUFFER = 1 << 20;
+//! Transactions written to the coins database per batch when loading
+const size_t SNAPSHOT_LOAD_BATCH = 50000;
+//! Headers passed to ProcessNewBlockHeaders at once, as received from peers
+const size_t SNAPSHOT_HEADERS_BATCH = 2000;
+
+struct CSnapshotHeader
+{
+    unsigned char magic[sizeof(SNAPSHOT_MAGIC)];
+    uint16_t nVersion;
+    CMessageHeader::MessageStartChars pchMessageStart;
+    uint256 hashBlock;
+    int32_t nHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(FLATDATA(magic));
+        READWRITE(nVersion);
+        READWRITE(FLATDATA(pchMessageStart));
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+    }
+};
+
+typedef std::vector<std::pair<uint256, CCoins> > CoinsBatch;
+
+/**
+ * Read and check a snapshot file from its start, passing its transactions
+ * to fnCoins (if set) in batches, in which case they were not checked yet.
+ */
+bool ReadSnapshot(CAutoFile& file, const CChainParams& chainparams, CUTXOSnapshotInfo& info,
+                  std::vector<CBlockHeader>& vHeaders, std::vector<unsigned int>& vTxCount,
+                  const std::function<bool(const CoinsBatch&)>& fnCoins, std::string& strError)
+{
+    try {
+        CHashVerifier<CAutoFile> verifier(&file);
+        CSnapshotHeader header;
+        verifier >> header;
+        if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header.nVersion != SNAPSHOT_VERSION) {
+            strError = "Not a UTXO set snapshot, or unsupported version";
+            return false;
+        }
+        if (memcmp(header.pchMessageStart, chainparams.MessageStart(), sizeof(header.pchMessageStart)) != 0) {
+            strError = "UTXO set snapshot of another network";
+            return false;
+        }
+        if (header.nHeight <= 0) {
+            strError = "UTXO set snapshot without blocks";
+            return false;
+        }
+        info.hashBlock = header.hashBlock;
+        info.nHeight = header.nHeight;
+
+        vHeaders.clear();
+        vTxCount.clear();
+        uint256 hashPrev = chainparams.GetConsensus().hashGenesisBlock;
+        for (int nHeight = 1; nHeight <= info.nHeight; nHeight++) {
+            CBlockHeader block;
+            unsigned int nTx;
+            verifier >> block >> VARINT(nTx);
+            if (block.hashPrevBlock != hashPrev || nTx == 0) {
+                strError = strprintf("Invalid block at height %d in UTXO set snapshot", nHeight);
+                return false;
+            }
+            hashPrev = block.GetHash();
+            vHeaders.push_back(block);
+            vTxCount.push_back(nTx);
+        }
+        if (hashPrev != info.hashBlock) {
+            strError = "UTXO set snapshot blocks do not lead to its block";
+            return false;
+        }
+
+        CSerializedUTXOHasher hasher(info.hashBlock);
+        uint64_t nTransactions = 0;
+        uint256 txidLast;
+        CoinsBatch vBatch;
+        while (true) {
+            boost::this_thread::interruption_point();
+            bool fMore;
+            verifier >> fMore;
+            if (!fMore)
+                break;
+            uint256 txid;
+            CCoins coins;
+            verifier >> txid >> coins;
+            // Sorted as in the database, which also rules out duplicates
+            if ((nTransactions > 0 && !(txidLast < txid)) || coins.IsPruned()) {
+                strError = strprintf("Invalid transaction %s in UTXO set snapshot", txid.ToString());
+                return false;
+            }
+            txidLast = txid;
+            hasher.Add(txid, coins);
+            nTransactions++;
+            if (fnCoins) {
+                vBatch.push_back(std::make_pair(txid, coins));
+                if (vBatch.size() >= SNAPSHOT_LOAD_BATCH) {
+                    if (!fnCoins(vBatch)) {
+                        strError = "Failed to write to coin database";
+                        return false;
+                    }
+                    vBatch.clear();
+                }
+            }
+        }
+        if (!vBatch.empty() && !fnCoins(vBatch)) {
+            strError = "Failed to write to coin database";
+            return false;
+        }
+
+        verifier >> info.nTransactions >> info.hashSerialized;
+        uint256 hashChecksum;
+        file >> hashChecksum;
+        if (hashChecksum != verifier.GetHash()) {
+            strError = "UTXO set snapshot checksum mismatch";
+            return false;
+        }
+        if (info.nTransactions != nTransactions || info.hashSerialized != hasher.GetHash()) {
+            strError = "UTXO set snapshot does not match its hash_serialized";
+            return false;
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("Invalid or truncated UTXO set snapshot (%s)", e.what());
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool DumpUTXOSnapshot(const CCoinsViewDB& view, const boost::filesystem::path& path, CUTXOSnapshotInfo& info, std::string& strError)
+{
+    if (boost::filesystem::exists(path)) {
+        strError = path.string() + " already exists";
+        return false;
+    }
+
+    std::unique_ptr<CCoinsViewCursor> pcursor(view.Cursor());
+    info.hashBlock = pcursor->GetBestBlock();
+    std::vector<std::pair<CBlockHeader, unsigned int> > vBlocks;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(info.hashBlock);
+        if (it == mapBlockIndex.end()) {
+            strError = "Unknown best block of the coins database";
+            return false;
+        }
+        info.nHeight = it->second->nHeight;
+        vBlocks.resize(info.nHeight);
+        for (const CBlockIndex* pindex = it->second; pindex->pprev; pindex = pindex->pprev)
+            vBlocks[pindex->nHeight - 1] = std::make_pair(pindex->GetBlockHeader(), pindex->nTx);
+    }
+
+    // Written under another name until complete
+    const boost::filesystem::path pathTmp = path.string() + ".incomplete";
+    CAutoFile file(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        strError = "Unable to open " + pathTmp.string() + " for writing";
+        return false;
+    }
+    try {
+        CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+        CPlainDataStream ss(SER_DISK, CLIENT_VERSION);
+        auto WriteBuffer = [&]() {
+            file.write(ss.data(), ss.size());
+            hasher.write(ss.data(), ss.size());
+            ss.clear();
+        };
+
+        CSnapshotHeader header;
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.nVersion = SNAPSHOT_VERSION;
+        memcpy(header.pchMessageStart, Params().MessageStart(), sizeof(header.pchMessageStart));
+        header.hashBlock = info.hashBlock;
+        header.nHeight = info.nHeight;
+        ss << header;
+        for (std::pair<CBlockHeader, unsigned int>& block : vBlocks) {
+            ss << block.first << VARINT(block.second);
+            if (ss.size() >= SNAPSHOT_WRITE_BUFFER)
+                WriteBuffer();
+        }
+
+        CSerializedUTXOHasher utxoHasher(info.hashBlock);
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            uint256 txid;
+            CCoins coins;
+            if (!pcursor->GetKey(txid) || !pcursor->GetValue(coins)) {
+                strError = "Unable to read UTXO set";
+                return false;
+            }
+            ss << true << txid << coins;
+            utxoHasher.Add(txid, coins);
+            info.nTransactions++;
+            if (ss.size() >= SNAPSHOT_WRITE_BUFFER)
+                WriteBuffer();
+            pcursor->Next();
+        }
+        info.hashSerialized = utxoHasher.GetHash();
+        ss << false << info.nTransactions << info.hashSerialized;
+        WriteBuffer();
+        file << hasher.GetHash();
+        FileCommit(file.Get());
+        file.fclose();
+    } catch (const std::exception& e) {
+        file.fclose();
+        boost::filesystem::remove(pathTmp);
+        strError = strprintf("Failed to write %s (%s)", pathTmp.string(), e.what());
+        return false;
+    }
+    if (!RenameOver(pathTmp, path)) {
+        strError = "Unable to rename " + pathTmp.string() + " to " + path.string();
+        return false;
+    }
+    return true;
+}
+
+bool LoadUTXOSnapshot(const CChainParams& chainparams, const boost::filesystem::path& path, const uint256& hashExpected, CUTXOSnapshotInfo& info, std::string& strError)
+{
+    CAutoFile file(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        strError = "Unable to open " + path.string();
+        return false;
+    }
+
+    // Check the whole file first, so that a bad one does not touch the chain state
+    std::vector<CBlockHeader> vHeaders;
+    std::vector<unsigned int> vTxCount;
+    if (!ReadSnapshot(file, chainparams, info, vHeaders, vTxCount, nullptr, strError))
+        return false;
+    if (!hashExpected.IsNull() && info.hashSerialized != hashExpected) {
+        strError = "UTXO set snapshot hash_serialized " + info.hashSerialized.GetHex() + " is not the expected one";
+        return false;
+    }
+    LogPrintf("Loading UTXO set snapshot of %u transactions at block %s (height %d)\n", info.nTransactions, info.hashBlock.ToString(), info.nHeight);
+
+    {
+        LOCK(cs_main);
+        if (!fPruneMode) {
+            strError = "Loading a UTXO set snapshot requires pruning (-prune), as the blocks it replaces are never downloaded";
+            return false;
+        }
+        if (chainActive.Height() != 0) {
+            strError = "Loading a UTXO set snapshot requires an empty chain state (only the genesis block connected)";
+            return false;
+        }
+        FlushStateToDisk();
+        if (!pcoinsTip->Flush()) {
+            strError = "Failed to write to coin database";
+            return false;
+        }
+        {
+            std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsdbview->Cursor());
+            if (pcursor->Valid()) {
+                strError = "Loading a UTXO set snapshot requires an empty coin database";
+                return false;
+            }
+        }
+
+        CValidationState state;
+        for (size_t i = 0; i < vHeaders.size(); i += SNAPSHOT_HEADERS_BATCH) {
+            std::vector<CBlockHeader> vBatch(vHeaders.begin() + i, vHeaders.begin() + std::min(vHeaders.size(), i + SNAPSHOT_HEADERS_BATCH));
+            if (!ProcessNewBlockHeaders(vBatch, state, chainparams)) {
+                strError = "Invalid block header in UTXO set snapshot: " + FormatStateMessage(state);
+                return false;
+            }
+        }
+        CBlockIndex* pindexSnapshot = mapBlockIndex.at(info.hashBlock);
+
+        // The coins go straight to the database, in txid order as LevelDB
+        // prefers, without growing the coins cache.
+        if (!pcoinsdbview->BeginSnapshotLoad(info.hashBlock)) {
+            strError = "Failed to write to coin database";
+            return false;
+        }
+        CUTXOSnapshotInfo infoLoaded;
+        fseek(file.Get(), 0, SEEK_SET);
+        if (!ReadSnapshot(file, chainparams, infoLoaded, vHeaders, vTxCount, [](const CoinsBatch& vBatch) { return pcoinsdbview->WriteSnapshotCoins(vBatch); }, strError) ||
+            infoLoaded.hashSerialized != info.hashSerialized) {
+            if (strError.empty())
+                strError = "UTXO set snapshot changed while loading";
+            strError += ". Please restart with -reindex-chainstate";
+            return false;
+        }
+        if (!pcoinsdbview->EndSnapshotLoad(info.hashBlock)) {
+            strError = "Failed to write to coin database";
+            return false;
+        }
+        pcoinsTip->SetBestBlock(info.hashBlock);
+
+        if (!ActivateUTXOSnapshot(chainparams, pindexSnapshot, vTxCount)) {
+            strError = "Failed to activate the UTXO set snapshot";
+            return false;
+        }
+        if (pUTXOCommitment && !LoadUTXOCommitment()) {
+            strError = "Failed to compute the UTXO set commitment";
+            return false;
+        }
+    }
+
+    // Connect any blocks already received on top of the snapshot
+    CValidationState state;
+    if (!ActivateBestChain(state, chainparams)) {
+        strError = "Failed to activate the best chain: " + FormatStateMessage(state);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTXOSNAPSHOT_H
+#define BITCOIN_UTXOSNAPSHOT_H
+
+#include "uint256.h"
+
+#include <stdint.h>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+
+class CChainParams;
+class CCoinsViewDB;
+
+/**
+ * A UTXO set snapshot file holds, in order:
+ * - a header: magic bytes, format version, network magic, and the hash and
+ *   height of the block whose UTXO set it is,
+ * - the header and transaction count of every block up to that one,
+ * - the transactions of the UTXO set as in the coins database (txid order),
+ * - their count and the hash_serialized of gettxoutsetinfo,
+ * - the double SHA256 of everything before.
+ */
+struct CUTXOSnapshotInfo
+{
+    uint256 hashBlock;
+    int nHeight;
+    uint64_t nTransactions;
+    uint256 hashSerialized;
+
+    CUTXOSnapshotInfo() : nHeight(0), nTransactions(0) {}
+};
+
+/** Write a snapshot of the UTXO set in the coins database, which must have been flushed */
+bool DumpUTXOSnapshot(const CCoinsViewDB& view, const boost::filesystem::path& path, CUTXOSnapshotInfo& info, std::string& strError);
+
+/**
+ * Replace the chain state of a new pruned node (whose chain is the genesis
+ * block) by a snapshot: the file is checked against its checksum and, if not
+ * null, the expected hash_serialized, and only then are its coins written
+ * straight to the coins database, in batches.
+ */
+bool LoadUTXOSnapshot(const CChainParams& chainparams, const boost::filesystem::path& path, const uint256& hashExpected, CUTXOSnapshotInfo& info, std::string& strError);
+
+#endif // BITCOIN_UTXOSNAPSHOT_H
@@ -6,9 +6,11 @@
 #include "validation.h"
 
 #include "arith_uint256.h"
+#include "blockindexsnapshot.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "coinstats.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
@@ -18,11 +20,13 @@
 #include "policy/policy.h"
 #include "pow.h"
 #include "primitives/block.h"
+#include "primitives/blockview.h"
 #include "primitives/transaction.h"
 #include "random.h"
 #include "script/script.h"
 #include "script/sigcache.h"
 #include "script/standard.h"
+#include "support/allocators/arena.h"
 #include "timedata.h"
 #include "tinyformat.h"
 #include "txdb.h"
@@ -57,6 +61,8 @@
 CCriticalSection cs_main;
 
 BlockMap mapBlockIndex;
+//! Storage of the CBlockIndex entries of mapBlockIndex, guarded by cs_main
+static ObjectArena<CBlockIndex> blockIndexArena;
 CChain chainActive;
 CBlockIndex *pindexBestHeader = NULL;
 CWaitableCriticalSection csBestBlock;
@@ -72,6 +78,7 @@ bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
 size_t nCoinCacheUsage = 5000 * 300;
+int nCoinCacheRetain = 0;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
 bool fEnableReplacement = DEFAULT_ENABLE_REPLACEMENT;
@@ -182,7 +189,7 @@ public:
     ~MemPoolConflictRemovalTracker() {
         pool.NotifyEntryRemoved.disconnect(boost::bind(&MemPoolConflictRemovalTracker::NotifyEntryRemoved, this, _1, _2));
         for (const auto& tx : conflictedTxs) {
-            GetMainSignals().SyncTransaction(*tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+            GetMainSignals().SyncTransaction(tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
         }
         conflictedTxs.clear();
     }
@@ -207,7 +214,10 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewCache *pcoinsTip = NULL;
+CCoinsViewDB *pcoinsdbview = NULL;
+std::unique_ptr<CUTXOCommitment> pUTXOCommitment;
 CBlockTreeDB *pblocktree = NULL;
+CTxIndexDB *ptxindexdb = NULL;
 
 enum FlushStateMode {
     FLUSH_STATE_NONE,
@@ -982,7 +992,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         }
     }
 
-    GetMainSignals().SyncTransaction(tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+    GetMainSignals().SyncTransaction(ptx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
 
     return true;
 }
@@ -1026,7 +1036,7 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
 
     if (fTxIndex) {
         CDiskTxPos postx;
-        if (pblocktree->ReadTxIndex(hash, postx)) {
+        if (ptxindexdb->ReadTxIndex(hash, postx)) {
             CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
             if (file.IsNull())
                 return error("%s: OpenBlockFile failed", __func__);
@@ -1138,6 +1148,48 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+bool ReadRawBlockFromDisk(CBlockView& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, const CMessageHeader::MessageStartChars& messageStart)
+{
+    block.SetNull();
+
+    // Blocks are stored behind their message start and size
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    if (pos.nPos < 8)
+        return error("ReadRawBlockFromDisk: Invalid position %s", pos.ToString());
+    pos.nPos -= 8;
+
+    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("ReadRawBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+    std::shared_ptr<std::vector<unsigned char> > buffer = std::make_shared<std::vector<unsigned char> >();
+    try {
+        CMessageHeader::MessageStartChars blockStart;
+        unsigned int nSize;
+        filein >> FLATDATA(blockStart) >> nSize;
+        if (memcmp(blockStart, messageStart, CMessageHeader::MESSAGE_START_SIZE) != 0)
+            return error("%s: Block magic mismatch at %s", __func__, pos.ToString());
+        if (nSize > MAX_BLOCK_SERIALIZED_SIZE)
+            return error("%s: Block size %u too large at %s", __func__, nSize, pos.ToString());
+        buffer->resize(nSize);
+        filein.read((char*)buffer->data(), nSize);
+    }
+    catch (const std::exception& e) {
+        return error("%s: I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+
+    if (!block.Parse(buffer))
+        return error("%s: Deserialize error at %s", __func__, pos.ToString());
+
+    // Check the header
+    if (!CheckProofOfWork(block.GetHash(), block.GetHeader().nBits, consensusParams))
+        return error("ReadRawBlockFromDisk: Errors in block header at %s", pos.ToString());
+    if (block.GetHash() != pindex->GetBlockHash())
+        return error("ReadRawBlockFromDisk: GetHash() doesn't match index for %s at %s",
+                pindex->ToString(), pos.ToString());
+    return true;
+}
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     int halvings = nHeight / consensusParams.nSubsidyHalvingInterval;
@@ -1327,10 +1379,15 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight)
     UpdateCoins(tx, inputs, txundo, nHeight);
 }
 
+//! Buffers reused by the script checks run on each thread
+static boost::thread_specific_ptr<ScriptExecutionArena> scriptExecutionArena;
+
 bool CScriptCheck::operator()() {
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
     const CScriptWitness *witness = &ptxTo->vin[nIn].scriptWitness;
-    if (!VerifyScript(scriptSig, scriptPubKey, witness, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, amount, cacheStore, *txdata), &error)) {
+    if (!scriptExecutionArena.get())
+        scriptExecutionArena.reset(new ScriptExecutionArena());
+    if (!VerifyScript(scriptSig, scriptPubKey, witness, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, amount, cacheStore, *txdata), &error, scriptExecutionArena.get())) {
         return false;
     }
     return true;
@@ -1657,6 +1714,46 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Closure representing the hashing and proof of work check of one block
+ * header. Neither depends on the block index, so the headers passed to
+ * ProcessNewBlockHeaders are checked in parallel before cs_main is taken.
+ */
+class CHeaderCheck
+{
+private:
+    const CBlockHeader *pheader;
+    const Consensus::Params *pconsensusParams;
+    uint256 *phash;
+    char *pfPowValid;
+
+public:
+    CHeaderCheck(): pheader(NULL), pconsensusParams(NULL), phash(NULL), pfPowValid(NULL) {}
+    CHeaderCheck(const CBlockHeader& header, const Consensus::Params& consensusParams, uint256& hash, char& fPowValid) :
+        pheader(&header), pconsensusParams(&consensusParams), phash(&hash), pfPowValid(&fPowValid) {}
+
+    bool operator()() {
+        *phash = pheader->GetHash();
+        *pfPowValid = CheckProofOfWork(*phash, pheader->nBits, *pconsensusParams);
+        // Failures are reported by AcceptBlockHeader, in order; the other headers still need their hash
+        return true;
+    }
+
+    void swap(CHeaderCheck &check) {
+        std::swap(pheader, check.pheader);
+        std::swap(pconsensusParams, check.pconsensusParams);
+        std::swap(phash, check.phash);
+        std::swap(pfPowValid, check.pfPowValid);
+    }
+};
+
+static CCheckQueue<CHeaderCheck> headercheckqueue(128);
+
+void ThreadHeaderCheck() {
+    RenameThread("bitcoin-headerch");
+    headercheckqueue.Thread();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1941,7 +2038,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     }
 
     if (fTxIndex)
-        if (!pblocktree->WriteTxIndex(vPos))
+        if (!ptxindexdb->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
 
     // add this block to the view's block chain
@@ -2057,7 +2154,17 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode, int n
         if (!CheckDiskSpace(128 * 2 * 2 * pcoinsTip->GetCacheSize()))
             return state.Error("out of disk space");
         // Flush the chainstate (which may refer to block index entries).
-        if (!pcoinsTip->Flush())
+        if (nCoinCacheRetain > 0) {
+            // Keep the cache warm: write it out, but only evict entries if it
+            // is full, down to the retained share, least recently used first.
+            int64_t nMaxUsage = (fCacheLarge || fCacheCritical) ? nTotalSpace * nCoinCacheRetain / 100 : nTotalSpace;
+            if (!pcoinsTip->Sync(std::max<int64_t>(nMaxUsage, 0)))
+                return AbortNode(state, "Failed to write to coin database");
+            LogPrint("coindb", "Kept %u transactions in the coins cache (%.1fMiB)\n", pcoinsTip->GetCacheSize(), pcoinsTip->DynamicMemoryUsage() * (1.0 / 1024 / 1024));
+        } else if (!pcoinsTip->Flush()) {
+            return AbortNode(state, "Failed to write to coin database");
+        }
+        if (pUTXOCommitment && !pcoinsdbview->WriteUTXOCommitment(*pUTXOCommitment))
             return AbortNode(state, "Failed to write to coin database");
         nLastFlush = nNow;
     }
@@ -2152,7 +2259,8 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
     CBlockIndex *pindexDelete = chainActive.Tip();
     assert(pindexDelete);
     // Read block from disk.
-    CBlock block;
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    CBlock& block = *pblock;
     if (!ReadBlockFromDisk(block, pindexDelete, chainparams.GetConsensus()))
         return AbortNode(state, "Failed to read block");
     // Apply the block atomically to the chain state.
@@ -2161,6 +2269,8 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
         CCoinsViewCache view(pcoinsTip);
         if (!DisconnectBlock(block, state, pindexDelete, view))
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
+        if (pUTXOCommitment)
+            pUTXOCommitment->Update(view, *pcoinsTip);
         bool flushed = view.Flush();
         assert(flushed);
     }
@@ -2195,8 +2305,9 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
     for (const auto& tx : block.vtx) {
-        GetMainSignals().SyncTransaction(*tx, pindexDelete->pprev, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+        GetMainSignals().SyncTransaction(tx, pindexDelete->pprev, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
     }
+    GetMainSignals().BlockDisconnected(pblock);
     return true;
 }
 
@@ -2249,6 +2360,8 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
                 InvalidBlockFound(pindexNew, state);
             return error("ConnectTip(): ConnectBlock %s failed", pindexNew->GetBlockHash().ToString());
         }
+        if (pUTXOCommitment)
+            pUTXOCommitment->Update(view, *pcoinsTip);
         nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
         LogPrint("bench", "  - Connect total: %.2fms [%.2fs]\n", (nTime3 - nTime2) * 0.001, nTimeConnectTotal * 0.000001);
         bool flushed = view.Flush();
@@ -2459,6 +2572,10 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
         if (ShutdownRequested())
             break;
 
+        // Notifications are delivered in the background; don't let them
+        // pile up without bound while connecting a long run of blocks.
+        LimitValidationInterfaceQueue(MAX_PENDING_VALIDATION_CALLBACKS);
+
         const CBlockIndex *pindexFork;
         ConnectTrace connectTrace;
         bool fInitialDownload;
@@ -2503,7 +2620,8 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
                 assert(pair.second);
                 const CBlock& block = *(pair.second);
                 for (unsigned int i = 0; i < block.vtx.size(); i++)
-                    GetMainSignals().SyncTransaction(*block.vtx[i], pair.first, i);
+                    GetMainSignals().SyncTransaction(block.vtx[i], pair.first, i);
+                GetMainSignals().BlockConnected(pair.second, pair.first);
             }
         }
         // When we reach this point, we switched to a new tip (stored in pindexNewTip).
@@ -2631,17 +2749,15 @@ bool ResetBlockFailureFlags(CBlockIndex *pindex) {
     return true;
 }
 
-CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
+static CBlockIndex* AddToBlockIndex(const CBlockHeader& block, const uint256& hash)
 {
     // Check for duplicate
-    uint256 hash = block.GetHash();
     BlockMap::iterator it = mapBlockIndex.find(hash);
     if (it != mapBlockIndex.end())
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    CBlockIndex* pindexNew = blockIndexArena.New(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -2666,6 +2782,11 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
     return pindexNew;
 }
 
+CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
+{
+    return AddToBlockIndex(block, block.GetHash());
+}
+
 /** Mark a block as having its data received and checked (up to BLOCK_VALID_TRANSACTIONS). */
 bool ReceivedBlockTransactions(const CBlock &block, CValidationState& state, CBlockIndex *pindexNew, const CDiskBlockPos& pos)
 {
@@ -3057,11 +3178,14 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, const Co
     return true;
 }
 
-static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+/**
+ * Add a block header with the given hash to the block index, after checking it. With fPowValid,
+ * its proof of work is known to be valid already. The caller runs CheckBlockIndex().
+ */
+static bool AcceptBlockHeader(const CBlockHeader& block, const uint256& hash, bool fPowValid, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
-    uint256 hash = block.GetHash();
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = NULL;
     if (hash != chainparams.GetConsensus().hashGenesisBlock) {
@@ -3076,7 +3200,7 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        if (!fPowValid && !CheckBlockHeader(block, state, chainparams.GetConsensus()))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3096,11 +3220,19 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
             return error("%s: Consensus::ContextualCheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
     }
     if (pindex == NULL)
-        pindex = AddToBlockIndex(block);
+        pindex = AddToBlockIndex(block, hash);
 
     if (ppindex)
         *ppindex = pindex;
 
+    return true;
+}
+
+static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+{
+    if (!AcceptBlockHeader(block, block.GetHash(), false, state, chainparams, ppindex))
+        return false;
+
     CheckBlockIndex(chainparams.GetConsensus());
 
     return true;
@@ -3109,17 +3241,36 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex)
 {
+    // Hash the headers and check their proof of work, on the script checking threads as well
+    std::vector<uint256> vHash(headers.size());
+    std::vector<char> vPowValid(headers.size());
+    std::vector<CHeaderCheck> vChecks;
+    vChecks.reserve(headers.size());
+    for (size_t i = 0; i < headers.size(); i++)
+        vChecks.push_back(CHeaderCheck(headers[i], chainparams.GetConsensus(), vHash[i], vPowValid[i]));
+    if (nScriptCheckThreads && vChecks.size() > 1) {
+        CCheckQueueControl<CHeaderCheck> control(&headercheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    } else {
+        for (CHeaderCheck& check : vChecks)
+            check();
+    }
+
+    // Add them to the block index under one lock
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        bool fAccepted = true;
+        for (size_t i = 0; i < headers.size() && fAccepted; i++) {
             CBlockIndex *pindex = NULL; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!AcceptBlockHeader(header, state, chainparams, &pindex)) {
-                return false;
-            }
-            if (ppindex) {
+            fAccepted = AcceptBlockHeader(headers[i], vHash[i], vPowValid[i], state, chainparams, &pindex);
+            if (fAccepted && ppindex) {
                 *ppindex = pindex;
             }
         }
+        CheckBlockIndex(chainparams.GetConsensus());
+        if (!fAccepted)
+            return false;
     }
     NotifyHeaderTip();
     return true;
@@ -3455,36 +3606,107 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw std::runtime_error(std::string(__func__) + ": new CBlockIndex failed");
+    CBlockIndex* pindexNew = blockIndexArena.New();
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
     return pindexNew;
 }
 
-bool static LoadBlockIndexDB(const CChainParams& chainparams)
+static const char* BLOCK_INDEX_SNAPSHOT_FILENAME = "blockindex.dat";
+
+//! Identifies the state of the block tree database a block index snapshot is written for
+static bool GetBlockIndexSnapshotTag(const uint256& nonce, uint256& tag)
 {
-    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex))
+    // The nonce is erased when the snapshot is loaded, and the last block
+    // file info changes with any block written by a node that does not know
+    // about snapshots.
+    int nFile;
+    CBlockFileInfo info;
+    if (!pblocktree->ReadLastBlockFile(nFile) || !pblocktree->ReadBlockFileInfo(nFile, info))
         return false;
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << nonce << nFile << info;
+    tag = ss.GetHash();
+    return true;
+}
 
-    boost::this_thread::interruption_point();
+/**
+ * Load the block index from the snapshot written at the last clean shutdown,
+ * if any, which spares hashing and checking every header and computing the
+ * chain work again.
+ */
+static bool LoadBlockIndexSnapshot(std::vector<CBlockIndex*>& vSortedByHeight)
+{
+    uint256 nonce;
+    if (!pblocktree->ReadBlockIndexSnapshot(nonce))
+        return false;
+    // Any change to the block tree database from now on makes the snapshot stale
+    if (!pblocktree->EraseBlockIndexSnapshot())
+        return false;
+    if (!GetBoolArg("-blockindexsnapshot", DEFAULT_BLOCK_INDEX_SNAPSHOT))
+        return false;
 
-    // Calculate nChainWork
-    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
-    vSortedByHeight.reserve(mapBlockIndex.size());
-    BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
-    {
-        CBlockIndex* pindex = item.second;
-        vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
+    int64_t nStart = GetTimeMicros();
+    uint256 tag;
+    if (!GetBlockIndexSnapshotTag(nonce, tag) ||
+        !ReadBlockIndexSnapshot(GetDataDir() / BLOCK_INDEX_SNAPSHOT_FILENAME, tag, InsertBlockIndex, vSortedByHeight)) {
+        LogPrintf("%s: ignoring the block index snapshot\n", __func__);
+        return false;
     }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end());
-    BOOST_FOREACH(const PAIRTYPE(int, CBlockIndex*)& item, vSortedByHeight)
+    LogPrintf("%s: loaded %u blocks from the block index snapshot in %.2fms\n", __func__, vSortedByHeight.size(), (GetTimeMicros() - nStart) * 0.001);
+    return true;
+}
+
+void DumpBlockIndexSnapshot()
+{
+    LOCK(cs_main);
+    // Only a block index loaded in full, and flushed, matches the database
+    if (!pblocktree || chainActive.Tip() == NULL || !setDirtyBlockIndex.empty() || !GetBoolArg("-blockindexsnapshot", DEFAULT_BLOCK_INDEX_SNAPSHOT))
+        return;
+
+    int64_t nStart = GetTimeMicros();
+    std::vector<const CBlockIndex*> vIndex;
+    vIndex.reserve(mapBlockIndex.size());
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
+        vIndex.push_back(item.second);
+    std::sort(vIndex.begin(), vIndex.end(), [](const CBlockIndex* a, const CBlockIndex* b) { return a->nHeight < b->nHeight; });
+
+    // The file is written first, so it is never used without the nonce recorded after it
+    const uint256 nonce = GetRandHash();
+    uint256 tag;
+    if (!GetBlockIndexSnapshotTag(nonce, tag) ||
+        !WriteBlockIndexSnapshot(GetDataDir() / BLOCK_INDEX_SNAPSHOT_FILENAME, tag, vIndex) ||
+        !pblocktree->WriteBlockIndexSnapshot(nonce)) {
+        LogPrintf("%s: failed to write the block index snapshot\n", __func__);
+        return;
+    }
+    LogPrintf("%s: wrote %u blocks in %.2fms\n", __func__, vIndex.size(), (GetTimeMicros() - nStart) * 0.001);
+}
+
+bool static LoadBlockIndexDB(const CChainParams& chainparams)
+{
+    std::vector<CBlockIndex*> vSortedByHeight;
+    const bool fFromSnapshot = LoadBlockIndexSnapshot(vSortedByHeight);
+    if (!fFromSnapshot) {
+        if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex))
+            return false;
+
+        boost::this_thread::interruption_point();
+
+        vSortedByHeight.reserve(mapBlockIndex.size());
+        BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
+            vSortedByHeight.push_back(item.second);
+        sort(vSortedByHeight.begin(), vSortedByHeight.end(), [](const CBlockIndex* a, const CBlockIndex* b) { return a->nHeight < b->nHeight; });
+    }
+
+    // Calculate nChainWork, unless read from the snapshot
+    BOOST_FOREACH(CBlockIndex* pindex, vSortedByHeight)
     {
-        CBlockIndex* pindex = item.second;
-        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
-        pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
+        if (!fFromSnapshot) {
+            pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+            pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
+        }
         // We can link the chain of blocks for which we've received transactions at some point.
         // Pruned nodes may have deleted the block.
         if (pindex->nTx > 0) {
@@ -3503,7 +3725,7 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
             setBlockIndexCandidates.insert(pindex);
         if (pindex->nStatus & BLOCK_FAILED_MASK && (!pindexBestInvalid || pindex->nChainWork > pindexBestInvalid->nChainWork))
             pindexBestInvalid = pindex;
-        if (pindex->pprev)
+        if (pindex->pprev && !fFromSnapshot)
             pindex->BuildSkip();
         if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
@@ -3767,6 +3989,7 @@ bool RewindBlockIndex(const CChainParams& params)
 void UnloadBlockIndex()
 {
     LOCK(cs_main);
+    pUTXOCommitment.reset();
     setBlockIndexCandidates.clear();
     chainActive.SetTip(NULL);
     pindexBestInvalid = NULL;
@@ -3783,10 +4006,8 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
 
-    BOOST_FOREACH(BlockMap::value_type& entry, mapBlockIndex) {
-        delete entry.second;
-    }
     mapBlockIndex.clear();
+    blockIndexArena.Clear();
     fHavePruned = false;
 }
 
@@ -3798,6 +4019,87 @@ bool LoadBlockIndex(const CChainParams& chainparams)
     return true;
 }
 
+bool LoadUTXOCommitment()
+{
+    LOCK(cs_main);
+    // The commitment is checked against the coins database
+    FlushStateToDisk();
+
+    std::unique_ptr<CUTXOCommitment> commitment(new CUTXOCommitment());
+    if (!pcoinsdbview->ReadUTXOCommitment(*commitment) || commitment->hashBlock != pcoinsTip->GetBestBlock()) {
+        // Missing or stale, as it was not maintained for the latest blocks:
+        // as the UTXO set only depends on the block, rebuild it from scratch.
+        LogPrintf("Computing the UTXO set commitment...\n");
+        int64_t nStart = GetTimeMillis();
+        if (!ComputeUTXOCommitment(*pcoinsdbview, *commitment))
+            return false;
+        if (!pcoinsdbview->WriteUTXOCommitment(*commitment))
+            return error("%s: failed to write the UTXO set commitment", __func__);
+        LogPrintf("Computed the UTXO set commitment for %u outputs in %dms\n", commitment->nTransactionOutputs, GetTimeMillis() - nStart);
+    }
+    pUTXOCommitment = std::move(commitment);
+    return true;
+}
+
+bool ActivateUTXOSnapshot(const CChainParams& chainparams, CBlockIndex* pindexSnapshot, const std::vector<unsigned int>& vTxCount)
+{
+    AssertLockHeld(cs_main);
+    assert(vTxCount.size() == (size_t)pindexSnapshot->nHeight);
+    assert(pcoinsTip->GetBestBlock() == pindexSnapshot->GetBlockHash());
+
+    // The blocks up to the snapshot are then in the same state as on a
+    // pruned node that validated and then deleted them.
+    for (CBlockIndex* pindex = pindexSnapshot; pindex->pprev; pindex = pindex->pprev) {
+        pindex->nTx = vTxCount[pindex->nHeight - 1];
+        if (IsWitnessEnabled(pindex->pprev, chainparams.GetConsensus())) {
+            pindex->nStatus |= BLOCK_OPT_WITNESS;
+        }
+        pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
+        setDirtyBlockIndex.insert(pindex);
+    }
+    fHavePruned = true;
+    pblocktree->WriteFlag("prunedblockfiles", true);
+
+    chainActive.SetTip(pindexSnapshot);
+    for (int nHeight = 1; nHeight < pindexSnapshot->nHeight; nHeight++)
+        chainActive[nHeight]->nChainTx = chainActive[nHeight - 1]->nChainTx + chainActive[nHeight]->nTx;
+
+    // Link the snapshot block, and any descendants whose data we already have
+    std::deque<CBlockIndex*> queue;
+    queue.push_back(pindexSnapshot);
+    while (!queue.empty()) {
+        CBlockIndex *pindex = queue.front();
+        queue.pop_front();
+        pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
+        {
+            LOCK(cs_nBlockSequenceId);
+            pindex->nSequenceId = nBlockSequenceId++;
+        }
+        if (!setBlockIndexCandidates.value_comp()(pindex, chainActive.Tip())) {
+            setBlockIndexCandidates.insert(pindex);
+        }
+        std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindex);
+        while (range.first != range.second) {
+            std::multimap<CBlockIndex*, CBlockIndex*>::iterator it = range.first;
+            queue.push_back(it->second);
+            range.first++;
+            mapBlocksUnlinked.erase(it);
+        }
+    }
+    PruneBlockIndexCandidates();
+
+    CValidationState state;
+    if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS))
+        return false;
+    CheckBlockIndex(chainparams.GetConsensus());
+
+    LogPrintf("%s: hashBestChain=%s height=%d date=%s\n", __func__,
+        chainActive.Tip()->GetBlockHash().ToString(), chainActive.Height(),
+        DateTimeStrFormat("%Y-%m-%d %H:%M:%S", chainActive.Tip()->GetBlockTime()));
+    cvBlockChange.notify_all();
+    return true;
+}
+
 bool InitBlockIndex(const CChainParams& chainparams)
 {
     LOCK(cs_main);
@@ -3836,121 +4138,297 @@ bool InitBlockIndex(const CChainParams& chainparams)
     return true;
 }
 
+// Map of disk positions for blocks with unknown parent (only used for reindex)
+static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+
+/**
+ * Find the blocks in an external file, and pass each to fnBlock, which returns false to stop.
+ * With dbp, dbp->nPos is set to the position of the block first. Deserialization errors are
+ * logged and skipped; I/O errors are thrown as std::runtime_error.
+ */
+static void ReadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp, const std::function<bool(const std::shared_ptr<CBlock>&)>& fnBlock)
+{
+    // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
+    CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
+    uint64_t nRewind = blkdat.GetPos();
+    while (!blkdat.eof()) {
+        boost::this_thread::interruption_point();
+
+        blkdat.SetPos(nRewind);
+        nRewind++; // start one byte further next time, in case of failure
+        blkdat.SetLimit(); // remove former limit
+        unsigned int nSize = 0;
+        try {
+            // locate a header
+            unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+            blkdat.FindByte(chainparams.MessageStart()[0]);
+            nRewind = blkdat.GetPos()+1;
+            blkdat >> FLATDATA(buf);
+            if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
+                continue;
+            // read size
+            blkdat >> nSize;
+            if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                continue;
+        } catch (const std::exception&) {
+            // no valid block header found; don't complain
+            break;
+        }
+        try {
+            // read block
+            uint64_t nBlockPos = blkdat.GetPos();
+            if (dbp)
+                dbp->nPos = nBlockPos;
+            blkdat.SetLimit(nBlockPos + nSize);
+            blkdat.SetPos(nBlockPos);
+            std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+            blkdat >> *pblock;
+            nRewind = blkdat.GetPos();
+
+            if (!fnBlock(pblock))
+                break;
+        } catch (const std::exception& e) {
+            LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+        }
+    }
+}
+
+/** Accept a block read from an external file, and any earlier read blocks waiting for it. Returns false to stop. */
+static bool AcceptExternalBlock(const CChainParams& chainparams, const std::shared_ptr<CBlock>& pblock, CDiskBlockPos *dbp, int& nLoaded)
+{
+    const CBlock& block = *pblock;
+
+    // detect out of order blocks, and store them for later
+    uint256 hash = block.GetHash();
+    if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+        LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                block.hashPrevBlock.ToString());
+        if (dbp)
+            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+        return true;
+    }
+
+    // process in case the block isn't known yet
+    if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+        LOCK(cs_main);
+        CValidationState state;
+        if (AcceptBlock(pblock, state, chainparams, NULL, true, dbp, NULL))
+            nLoaded++;
+        if (state.IsError())
+            return false;
+    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+        LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (hash == chainparams.GetConsensus().hashGenesisBlock) {
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams)) {
+            return false;
+        }
+    }
+
+    NotifyHeaderTip();
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+            if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
+            {
+                LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                        head.ToString());
+                LOCK(cs_main);
+                CValidationState dummy;
+                if (AcceptBlock(pblockrecursive, dummy, chainparams, NULL, true, &it->second, NULL))
+                {
+                    nLoaded++;
+                    queue.push_back(pblockrecursive->GetHash());
+                }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip();
+        }
+    }
+    return true;
+}
+
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
 {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
     int64_t nStart = GetTimeMillis();
 
     int nLoaded = 0;
     try {
-        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
+        ReadExternalBlockFile(chainparams, fileIn, dbp, [&](const std::shared_ptr<CBlock>& pblock) {
+            return AcceptExternalBlock(chainparams, pblock, dbp, nLoaded);
+        });
+    } catch (const std::runtime_error& e) {
+        AbortNode(std::string("System error: ") + e.what());
+    }
+    if (nLoaded > 0)
+        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+    return nLoaded > 0;
+}
 
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
+namespace {
+
+/** The blocks read from one block file by a reindex thread, in file order */
+struct CReindexFile
+{
+    bool fFound;
+    std::string strError;
+    std::vector<std::pair<std::shared_ptr<CBlock>, CDiskBlockPos> > vBlocks;
+
+    CReindexFile() : fFound(true) {}
+};
+
+/**
+ * Block files read ahead of the one being accepted. Reading a block file,
+ * hashing its blocks and the context-free CheckBlock() take most of the time
+ * of a reindex besides connecting blocks, and do not depend on the other
+ * files, so each thread takes the next file that nobody has read yet.
+ * Accepting stays in file order, on the thread that calls Accept(), so that
+ * the result is the same as reading the files one after the other.
+ */
+class CReindexReader
+{
+private:
+    const CChainParams& chainparams;
+    const int nLookahead;
+
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    //! Next file for a thread to read, the file being accepted, and the first file known not to exist
+    int nNextFile;
+    int nAccepting;
+    int nEndFile;
+    std::map<int, CReindexFile> mapFiles;
+    boost::thread_group threads;
+
+    void ThreadRead()
+    {
+        while (true) {
+            int nFile;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (nNextFile < nEndFile && nNextFile >= nAccepting + nLookahead)
+                    cond.wait(lock);
+                if (nNextFile >= nEndFile)
+                    return;
+                nFile = nNextFile++;
             }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
-
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                            block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
 
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    LOCK(cs_main);
-                    CValidationState state;
-                    if (AcceptBlock(pblock, state, chainparams, NULL, true, dbp, NULL))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+            CReindexFile file;
+            CDiskBlockPos pos(nFile, 0);
+            FILE* fileIn = boost::filesystem::exists(GetBlockPosFilename(pos, "blk")) ? OpenBlockFile(pos, true) : NULL;
+            if (!fileIn) {
+                file.fFound = false; // No block files left to reindex
+            } else {
+                try {
+                    ReadExternalBlockFile(chainparams, fileIn, &pos, [&](const std::shared_ptr<CBlock>& pblock) {
+                        // Remembered in the block; an invalid block is left to AcceptBlock() to deal with
+                        CValidationState state;
+                        CheckBlock(*pblock, state, chainparams.GetConsensus());
+                        file.vBlocks.push_back(std::make_pair(pblock, pos));
+                        return true;
+                    });
+                } catch (const std::runtime_error& e) {
+                    file.strError = e.what();
                 }
+            }
 
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
-                    }
-                }
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (!file.fFound)
+                nEndFile = std::min(nEndFile, nFile);
+            mapFiles[nFile] = std::move(file);
+            cond.notify_all();
+        }
+    }
 
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
-                        {
-                            LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (AcceptBlock(pblockrecursive, dummy, chainparams, NULL, true, &it->second, NULL))
-                            {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
-                    }
+public:
+    CReindexReader(const CChainParams& chainparamsIn, int nThreads) :
+        chainparams(chainparamsIn), nLookahead(nThreads), nNextFile(0), nAccepting(0), nEndFile(std::numeric_limits<int>::max())
+    {
+        for (int i = 0; i < nThreads; i++)
+            threads.create_thread(boost::bind(&CReindexReader::ThreadRead, this));
+    }
+
+    ~CReindexReader()
+    {
+        threads.interrupt_all();
+        threads.join_all();
+    }
+
+    //! Accept the blocks of all files in order
+    void Accept()
+    {
+        int nLoaded = 0;
+        int64_t nStart = GetTimeMillis();
+        while (true) {
+            CReindexFile file;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (!mapFiles.count(nAccepting))
+                    cond.wait(lock);
+                file = std::move(mapFiles[nAccepting]);
+                mapFiles.erase(nAccepting);
+            }
+            if (!file.fFound)
+                break;
+            if (!file.strError.empty()) {
+                AbortNode(std::string("System error: ") + file.strError);
+                break;
+            }
+
+            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nAccepting);
+            for (std::pair<std::shared_ptr<CBlock>, CDiskBlockPos>& block : file.vBlocks) {
+                boost::this_thread::interruption_point();
+                try {
+                    if (!AcceptExternalBlock(chainparams, block.first, &block.second, nLoaded))
+                        break;
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
                 }
-            } catch (const std::exception& e) {
-                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            nAccepting++;
+            cond.notify_all();
         }
-    } catch (const std::runtime_error& e) {
-        AbortNode(std::string("System error: ") + e.what());
+        if (nLoaded > 0)
+            LogPrintf("Loaded %i blocks from block files in %dms\n", nLoaded, GetTimeMillis() - nStart);
+    }
+};
+
+} // namespace
+
+void ReindexBlockFiles(const CChainParams& chainparams, int nThreads)
+{
+    if (nThreads > 1) {
+        CReindexReader reader(chainparams, nThreads);
+        reader.Accept();
+        return;
+    }
+
+    int nFile = 0;
+    while (true) {
+        CDiskBlockPos pos(nFile, 0);
+        if (!boost::filesystem::exists(GetBlockPosFilename(pos, "blk")))
+            break; // No block files left to reindex
+        FILE *file = OpenBlockFile(pos, true);
+        if (!file)
+            break; // This error is logged in OpenBlockFile
+        LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
+        LoadExternalBlockFile(chainparams, file, &pos);
+        nFile++;
     }
-    if (nLoaded > 0)
-        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
-    return nLoaded > 0;
 }
 
 void static CheckBlockIndex(const Consensus::Params& consensusParams)
@@ -4297,9 +4775,7 @@ public:
     CMainCleanup() {}
     ~CMainCleanup() {
         // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
         mapBlockIndex.clear();
+        blockIndexArena.Clear();
     }
 } instance_of_cmaincleanup;
@@ -13,6 +13,7 @@
 #include "amount.h"
 #include "chain.h"
 #include "coins.h"
+#include "pooledmap.h"
 #include "protocol.h" // For CMessageHeader::MessageStartChars
 #include "script/script_error.h"
 #include "sync.h"
@@ -28,18 +29,22 @@
 #include <vector>
 
 #include <atomic>
+#include <memory>
 
-#include <boost/unordered_map.hpp>
 #include <boost/filesystem/path.hpp>
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CTxIndexDB;
+class CBlockView;
 class CBloomFilter;
 class CChainParams;
+class CCoinsViewDB;
 class CInv;
 class CConnman;
 class CScriptCheck;
 class CTxMemPool;
+class CUTXOCommitment;
 class CValidationInterface;
 class CValidationState;
 struct ChainTxData;
@@ -80,6 +85,10 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of threads reading block files during -reindex; each holds up to one block file in memory */
+static const int MAX_REINDEX_THREADS = 4;
+/** -reindexthreads default (number of threads reading block files during -reindex, 0 = auto) */
+static const int DEFAULT_REINDEX_THREADS = 0;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -130,6 +139,8 @@ static const int64_t MAX_FEE_ESTIMATION_TIP_AGE = 3 * 60 * 60;
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = false;
+static const bool DEFAULT_UTXO_COMMITMENT = false;
+static const bool DEFAULT_BLOCK_INDEX_SNAPSHOT = true;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
 /** Default for -mempoolreplacement */
@@ -145,6 +156,9 @@ static const int MAX_UNCONNECTING_HEADERS = 10;
 
 static const bool DEFAULT_PEERBLOOMFILTERS = true;
 
+/** Maximum number of queued validation interface callbacks before ActivateBestChain waits for listeners to catch up */
+static const size_t MAX_PENDING_VALIDATION_CALLBACKS = 10000;
+
 struct BlockHasher
 {
     size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
@@ -153,7 +167,11 @@ struct BlockHasher
 extern CScript COINBASE_FLAGS;
 extern CCriticalSection cs_main;
 extern CTxMemPool mempool;
-typedef boost::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
+/**
+ * The block index entries, which live in an arena in creation order, by
+ * hash. phashBlock of each entry points to its key in the map.
+ */
+typedef pooledmap<uint256, CBlockIndex*, BlockHasher> BlockMap;
 extern BlockMap mapBlockIndex;
 extern uint64_t nLastBlockTx;
 extern uint64_t nLastBlockSize;
@@ -170,6 +188,8 @@ extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
 extern size_t nCoinCacheUsage;
+/** Percentage of the coins cache limit kept in memory when the cache is flushed for being full */
+extern int nCoinCacheRetain;
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
 extern CFeeRate minRelayTxFee;
 /** Absolute maximum transaction fee (in satoshis) used by wallet and mempool (rejects high fee in sendrawtransaction) */
@@ -253,14 +273,30 @@ FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = NULL);
+/**
+ * Import the blocks from all block files (blk?????.dat), for -reindex. With nThreads > 1, that many
+ * threads read and check the files ahead, while the blocks are accepted in file order.
+ */
+void ReindexBlockFiles(const CChainParams& chainparams, int nThreads);
 /** Initialize a new block tree database + block data on disk */
 bool InitBlockIndex(const CChainParams& chainparams);
 /** Load the block tree and coins database from disk */
 bool LoadBlockIndex(const CChainParams& chainparams);
 /** Unload database information */
 void UnloadBlockIndex();
+/** Load the commitment to the UTXO set, or compute it if it is not up to date, and keep it updated from now on */
+bool LoadUTXOCommitment();
+/**
+ * Make pindexSnapshot the tip, once the UTXO set snapshot at that block has
+ * been loaded into the coins database, given the number of transactions of
+ * each block up to it (from height 1). The blocks themselves are missing,
+ * like on a pruned node.
+ */
+bool ActivateUTXOSnapshot(const CChainParams& chainparams, CBlockIndex* pindexSnapshot, const std::vector<unsigned int>& vTxCount);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the block header checking thread */
+void ThreadHeaderCheck();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Format a string that describes several potential problems detected by the core.
@@ -470,6 +506,8 @@ public:
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Read a block as it is stored, into a view of it, without deserializing its transactions */
+bool ReadRawBlockFromDisk(CBlockView& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, const CMessageHeader::MessageStartChars& messageStart);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -536,9 +574,18 @@ extern CChain chainActive;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
+/** Global variable that points to the coins database, beneath pcoinsTip */
+extern CCoinsViewDB *pcoinsdbview;
+
+/** Commitment to the UTXO set of pcoinsTip, if -utxocommitment (protected by cs_main) */
+extern std::unique_ptr<CUTXOCommitment> pUTXOCommitment;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
+/** Global variable that points to the transaction index, if -txindex (protected by cs_main) */
+extern CTxIndexDB *ptxindexdb;
+
 /**
  * Return the spend height, which is one more than the inputs.GetBestBlock().
  * While checking, GetBestBlock() refers to the parent block. (protected by cs_main)
@@ -574,4 +621,7 @@ void DumpMempool();
 /** Load the mempool from disk. */
 bool LoadMempool();
 
+/** Write a snapshot of the block index for the next startup, after the last flush. */
+void DumpBlockIndexSnapshot();
+
 #endif // BITCOIN_VALIDATION_H
@@ -4,49 +4,242 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "validationinterface.h"
+#include "chain.h"
+#include "primitives/transaction.h"
+#include "scheduler.h"
+#include "txmempool.h"
+
+#include <boost/signals2/signal.hpp>
+
+struct MainSignalsInstance {
+    boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
+    boost::signals2::signal<void (const CTransaction &, const CBlockIndex *pindex, int posInBlock)> SyncTransaction;
+    boost::signals2::signal<void (const std::shared_ptr<const CTransaction> &)> TransactionAddedToMempool;
+    boost::signals2::signal<void (const std::shared_ptr<const CTransaction> &, MemPoolRemovalReason)> TransactionRemovedFromMempool;
+    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex)> BlockConnected;
+    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &)> BlockDisconnected;
+    boost::signals2::signal<void (const uint256 &)> UpdatedTransaction;
+    boost::signals2::signal<void (const CBlockLocator &)> SetBestChain;
+    boost::signals2::signal<void (const uint256 &)> Inventory;
+    boost::signals2::signal<void (int64_t nBestBlockTime, CConnman* connman)> Broadcast;
+    boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
+    boost::signals2::signal<void (boost::shared_ptr<CReserveScript>&)> ScriptForMining;
+    boost::signals2::signal<void (const uint256 &)> BlockFound;
+    boost::signals2::signal<void (const CBlockIndex *, const std::shared_ptr<const CBlock>&)> NewPoWValidBlock;
+
+    // We are not allowed to assume the scheduler only runs in one thread,
+    // but must ensure all callbacks happen in-order, so we end up creating
+    // our own queue here :(
+    std::unique_ptr<SingleThreadedSchedulerClient> m_schedulerClient;
+    CScheduler* m_scheduler = NULL;
+};
 
 static CMainSignals g_signals;
 
+CMainSignals::CMainSignals() : m_internals(new MainSignalsInstance()) {}
+
+CMainSignals::~CMainSignals() {}
+
 CMainSignals& GetMainSignals()
 {
     return g_signals;
 }
 
+void CMainSignals::RegisterBackgroundSignalScheduler(CScheduler& scheduler) {
+    assert(!m_internals->m_schedulerClient);
+    m_internals->m_schedulerClient.reset(new SingleThreadedSchedulerClient(&scheduler));
+    m_internals->m_scheduler = &scheduler;
+}
+
+void CMainSignals::UnregisterBackgroundSignalScheduler() {
+    // A scheduler thread still running could be in the middle of delivering
+    // a callback; keep the queue around rather than pulling it from under it.
+    if (m_internals->m_scheduler && m_internals->m_scheduler->AreThreadsServicingQueue())
+        return;
+    m_internals->m_schedulerClient.reset();
+    m_internals->m_scheduler = NULL;
+}
+
+void CMainSignals::FlushBackgroundCallbacks() {
+    if (m_internals->m_scheduler && !m_internals->m_scheduler->AreThreadsServicingQueue())
+        m_internals->m_schedulerClient->EmptyQueue();
+}
+
+size_t CMainSignals::CallbacksPending() {
+    if (!m_internals->m_schedulerClient) return 0;
+    return m_internals->m_schedulerClient->CallbacksPending();
+}
+
+void CMainSignals::Dispatch(std::function<void ()> func) {
+    if (m_internals->m_schedulerClient)
+        m_internals->m_schedulerClient->AddToProcessQueue(std::move(func));
+    else
+        func();
+}
+
+void CMainSignals::RegisterWithMempoolSignals(CTxMemPool& pool) {
+    pool.NotifyEntryAdded.connect(boost::bind(&CMainSignals::MempoolEntryAdded, this, _1));
+    pool.NotifyEntryRemoved.connect(boost::bind(&CMainSignals::MempoolEntryRemoved, this, _1, _2));
+}
+
+void CMainSignals::UnregisterWithMempoolSignals(CTxMemPool& pool) {
+    pool.NotifyEntryRemoved.disconnect(boost::bind(&CMainSignals::MempoolEntryRemoved, this, _1, _2));
+    pool.NotifyEntryAdded.disconnect(boost::bind(&CMainSignals::MempoolEntryAdded, this, _1));
+}
+
+void CMainSignals::MempoolEntryAdded(std::shared_ptr<const CTransaction> ptx) {
+    TransactionAddedToMempool(ptx);
+}
+
+void CMainSignals::MempoolEntryRemoved(std::shared_ptr<const CTransaction> ptx, MemPoolRemovalReason reason) {
+    TransactionRemovedFromMempool(ptx, reason);
+}
+
 void RegisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
-    g_signals.UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
-    g_signals.SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
-    g_signals.Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
-    g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
-    g_signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
-    g_signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
-    g_signals.NewPoWValidBlock.connect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
+    MainSignalsInstance& signals = *g_signals.m_internals;
+    signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
+    signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
+    signals.TransactionAddedToMempool.connect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1));
+    signals.TransactionRemovedFromMempool.connect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1, _2));
+    signals.BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2));
+    signals.BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1));
+    signals.UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
+    signals.SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
+    signals.Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
+    signals.Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
+    signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
+    signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
+    signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
+    signals.NewPoWValidBlock.connect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
-    g_signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
-    g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
-    g_signals.Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
-    g_signals.Inventory.disconnect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
-    g_signals.SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.UpdatedTransaction.disconnect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
-    g_signals.SyncTransaction.disconnect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
-    g_signals.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.NewPoWValidBlock.disconnect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
+    MainSignalsInstance& signals = *g_signals.m_internals;
+    signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
+    signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
+    signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
+    signals.Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
+    signals.Inventory.disconnect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
+    signals.SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
+    signals.UpdatedTransaction.disconnect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
+    signals.BlockDisconnected.disconnect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1));
+    signals.BlockConnected.disconnect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2));
+    signals.TransactionRemovedFromMempool.disconnect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1, _2));
+    signals.TransactionAddedToMempool.disconnect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1));
+    signals.SyncTransaction.disconnect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
+    signals.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
+    signals.NewPoWValidBlock.disconnect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
 }
 
 void UnregisterAllValidationInterfaces() {
-    g_signals.BlockFound.disconnect_all_slots();
-    g_signals.ScriptForMining.disconnect_all_slots();
-    g_signals.BlockChecked.disconnect_all_slots();
-    g_signals.Broadcast.disconnect_all_slots();
-    g_signals.Inventory.disconnect_all_slots();
-    g_signals.SetBestChain.disconnect_all_slots();
-    g_signals.UpdatedTransaction.disconnect_all_slots();
-    g_signals.SyncTransaction.disconnect_all_slots();
-    g_signals.UpdatedBlockTip.disconnect_all_slots();
-    g_signals.NewPoWValidBlock.disconnect_all_slots();
+    MainSignalsInstance& signals = *g_signals.m_internals;
+    signals.BlockFound.disconnect_all_slots();
+    signals.ScriptForMining.disconnect_all_slots();
+    signals.BlockChecked.disconnect_all_slots();
+    signals.Broadcast.disconnect_all_slots();
+    signals.Inventory.disconnect_all_slots();
+    signals.SetBestChain.disconnect_all_slots();
+    signals.UpdatedTransaction.disconnect_all_slots();
+    signals.BlockDisconnected.disconnect_all_slots();
+    signals.BlockConnected.disconnect_all_slots();
+    signals.TransactionRemovedFromMempool.disconnect_all_slots();
+    signals.TransactionAddedToMempool.disconnect_all_slots();
+    signals.SyncTransaction.disconnect_all_slots();
+    signals.UpdatedBlockTip.disconnect_all_slots();
+    signals.NewPoWValidBlock.disconnect_all_slots();
+}
+
+void CallFunctionInValidationInterfaceQueue(std::function<void ()> func) {
+    g_signals.Dispatch(std::move(func));
+}
+
+void SyncWithValidationInterfaceQueue() {
+    if (!g_signals.m_internals->m_schedulerClient) return;
+    // Block until the validation queue drains, including the callback
+    // currently being delivered on the scheduler thread.
+    g_signals.m_internals->m_schedulerClient->WaitForPending(0);
+}
+
+void LimitValidationInterfaceQueue(size_t nMaxPending) {
+    if (!g_signals.m_internals->m_schedulerClient) return;
+    g_signals.m_internals->m_schedulerClient->WaitForPending(nMaxPending);
+}
+
+// The notifications below are queued: listeners see them in the order they
+// were generated, but possibly after the caller has released cs_main.
+// Everything a listener needs must therefore be captured by value.
+
+void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {
+    Dispatch([this, pindexNew, pindexFork, fInitialDownload] {
+        m_internals->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
+    });
+}
+
+void CMainSignals::SyncTransaction(const std::shared_ptr<const CTransaction> &ptx, const CBlockIndex *pindex, int posInBlock) {
+    Dispatch([this, ptx, pindex, posInBlock] {
+        m_internals->SyncTransaction(*ptx, pindex, posInBlock);
+    });
+}
+
+void CMainSignals::TransactionAddedToMempool(const std::shared_ptr<const CTransaction> &ptx) {
+    Dispatch([this, ptx] {
+        m_internals->TransactionAddedToMempool(ptx);
+    });
+}
+
+void CMainSignals::TransactionRemovedFromMempool(const std::shared_ptr<const CTransaction> &ptx, MemPoolRemovalReason reason) {
+    Dispatch([this, ptx, reason] {
+        m_internals->TransactionRemovedFromMempool(ptx, reason);
+    });
+}
+
+void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex) {
+    Dispatch([this, block, pindex] {
+        m_internals->BlockConnected(block, pindex);
+    });
+}
+
+void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock> &block) {
+    Dispatch([this, block] {
+        m_internals->BlockDisconnected(block);
+    });
+}
+
+void CMainSignals::UpdatedTransaction(const uint256 &hash) {
+    Dispatch([this, hash] {
+        m_internals->UpdatedTransaction(hash);
+    });
+}
+
+void CMainSignals::SetBestChain(const CBlockLocator &locator) {
+    Dispatch([this, locator] {
+        m_internals->SetBestChain(locator);
+    });
+}
+
+// The notifications below are delivered synchronously, as their listeners
+// depend on state that only holds while the caller is running.
+
+void CMainSignals::Inventory(const uint256 &hash) {
+    m_internals->Inventory(hash);
+}
+
+void CMainSignals::Broadcast(int64_t nBestBlockTime, CConnman* connman) {
+    m_internals->Broadcast(nBestBlockTime, connman);
+}
+
+void CMainSignals::BlockChecked(const CBlock& block, const CValidationState& state) {
+    m_internals->BlockChecked(block, state);
+}
+
+void CMainSignals::ScriptForMining(boost::shared_ptr<CReserveScript>& coinbaseScript) {
+    m_internals->ScriptForMining(coinbaseScript);
+}
+
+void CMainSignals::BlockFound(const uint256 &hash) {
+    m_internals->BlockFound(hash);
+}
+
+void CMainSignals::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {
+    m_internals->NewPoWValidBlock(pindex, block);
 }
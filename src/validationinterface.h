@@ -8,6 +8,7 @@
 
 #include <boost/signals2/signal.hpp>
 #include <boost/shared_ptr.hpp>
+#include <functional>
 #include <memory>
 
 class CBlock;
@@ -16,10 +17,13 @@ struct CBlockLocator;
 class CBlockIndex;
 class CConnman;
 class CReserveScript;
+class CScheduler;
 class CTransaction;
 class CValidationInterface;
 class CValidationState;
+class CTxMemPool;
 class uint256;
+enum class MemPoolRemovalReason;
 
 // These functions dispatch to one or all registered wallets
 
@@ -29,11 +33,31 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn);
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
+/**
+ * Pushes a function to callback onto the notification queue, guaranteeing any
+ * callbacks generated prior to now are finished when the function is called.
+ */
+void CallFunctionInValidationInterfaceQueue(std::function<void ()> func);
+/**
+ * Wait until all callbacks queued so far have been delivered to the listeners.
+ * Must not be called while holding cs_main, as listeners may need it.
+ */
+void SyncWithValidationInterfaceQueue();
+/**
+ * Wait until at most nMaxPending callbacks are left in the validation queue,
+ * to keep producers from running arbitrarily far ahead of the listeners.
+ * Must not be called while holding cs_main, as listeners may need it.
+ */
+void LimitValidationInterfaceQueue(size_t nMaxPending);
 
 class CValidationInterface {
 protected:
     virtual void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {}
     virtual void SyncTransaction(const CTransaction &tx, const CBlockIndex *pindex, int posInBlock) {}
+    virtual void TransactionAddedToMempool(const std::shared_ptr<const CTransaction> &ptx) {}
+    virtual void TransactionRemovedFromMempool(const std::shared_ptr<const CTransaction> &ptx, MemPoolRemovalReason reason) {}
+    virtual void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex) {}
+    virtual void BlockDisconnected(const std::shared_ptr<const CBlock> &block) {}
     virtual void SetBestChain(const CBlockLocator &locator) {}
     virtual void UpdatedTransaction(const uint256 &hash) {}
     virtual void Inventory(const uint256 &hash) {}
@@ -47,9 +71,56 @@ protected:
     friend void ::UnregisterAllValidationInterfaces();
 };
 
-struct CMainSignals {
+struct MainSignalsInstance;
+
+/**
+ * Dispatches validation events to the registered CValidationInterfaces.
+ *
+ * Once a background scheduler is registered, the chain and mempool
+ * notifications (UpdatedBlockTip, SyncTransaction, TransactionAddedToMempool,
+ * TransactionRemovedFromMempool, BlockConnected, BlockDisconnected,
+ * UpdatedTransaction and SetBestChain) are queued and delivered on the
+ * scheduler thread instead of the calling thread, one at a time and in the
+ * order they were generated. The remaining notifications are delivered
+ * synchronously, as their listeners depend on the caller's state.
+ */
+class CMainSignals {
+private:
+    std::unique_ptr<MainSignalsInstance> m_internals;
+
+    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::UnregisterValidationInterface(CValidationInterface*);
+    friend void ::UnregisterAllValidationInterfaces();
+    friend void ::CallFunctionInValidationInterfaceQueue(std::function<void ()> func);
+    friend void ::SyncWithValidationInterfaceQueue();
+    friend void ::LimitValidationInterfaceQueue(size_t nMaxPending);
+
+    /** Queue func for the background scheduler, or run it right away if there is none */
+    void Dispatch(std::function<void ()> func);
+
+    void MempoolEntryAdded(std::shared_ptr<const CTransaction> ptx);
+    void MempoolEntryRemoved(std::shared_ptr<const CTransaction> ptx, MemPoolRemovalReason reason);
+
+public:
+    CMainSignals();
+    ~CMainSignals();
+
+    /** Register a CScheduler to give callbacks which should run in the background (may only be called once) */
+    void RegisterBackgroundSignalScheduler(CScheduler& scheduler);
+    /** Unregister the background CScheduler once its threads have stopped; callbacks are delivered synchronously again afterwards */
+    void UnregisterBackgroundSignalScheduler();
+    /** Call any remaining callbacks on the calling thread; does nothing while scheduler threads are still running */
+    void FlushBackgroundCallbacks();
+    /** Number of queued callbacks not yet delivered */
+    size_t CallbacksPending();
+
+    /** Forward the add/remove notifications of a mempool to TransactionAddedToMempool/TransactionRemovedFromMempool */
+    void RegisterWithMempoolSignals(CTxMemPool& pool);
+    /** Stop forwarding notifications of a mempool registered with RegisterWithMempoolSignals */
+    void UnregisterWithMempoolSignals(CTxMemPool& pool);
+
     /** Notifies listeners of updated block chain tip */
-    boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
     /** A posInBlock value for SyncTransaction calls for transactions not
      * included in connected blocks such as transactions removed from mempool,
      * accepted to mempool or appearing in disconnected blocks.*/
@@ -60,30 +131,39 @@ struct CMainSignals {
      * transaction was accepted to mempool, removed from mempool (only when
      * removal was due to conflict from connected block), or appeared in a
      * disconnected block.*/
-    boost::signals2::signal<void (const CTransaction &, const CBlockIndex *pindex, int posInBlock)> SyncTransaction;
+    void SyncTransaction(const std::shared_ptr<const CTransaction> &ptx, const CBlockIndex *pindex, int posInBlock);
+    /** Notifies listeners of a transaction having been added to mempool. */
+    void TransactionAddedToMempool(const std::shared_ptr<const CTransaction> &ptx);
+    /** Notifies listeners of a transaction leaving mempool, for any reason
+     * (including inclusion in a connected block). */
+    void TransactionRemovedFromMempool(const std::shared_ptr<const CTransaction> &ptx, MemPoolRemovalReason reason);
+    /** Notifies listeners of a block being connected to the active chain. */
+    void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex);
+    /** Notifies listeners of a block being disconnected from the active chain. */
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &block);
     /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
-    boost::signals2::signal<void (const uint256 &)> UpdatedTransaction;
+    void UpdatedTransaction(const uint256 &hash);
     /** Notifies listeners of a new active block chain. */
-    boost::signals2::signal<void (const CBlockLocator &)> SetBestChain;
+    void SetBestChain(const CBlockLocator &locator);
     /** Notifies listeners about an inventory item being seen on the network. */
-    boost::signals2::signal<void (const uint256 &)> Inventory;
+    void Inventory(const uint256 &hash);
     /** Tells listeners to broadcast their data. */
-    boost::signals2::signal<void (int64_t nBestBlockTime, CConnman* connman)> Broadcast;
+    void Broadcast(int64_t nBestBlockTime, CConnman* connman);
     /**
      * Notifies listeners of a block validation result.
      * If the provided CValidationState IsValid, the provided block
      * is guaranteed to be the current best block at the time the
      * callback was generated (not necessarily now)
      */
-    boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
+    void BlockChecked(const CBlock& block, const CValidationState& state);
     /** Notifies listeners that a key for mining is required (coinbase) */
-    boost::signals2::signal<void (boost::shared_ptr<CReserveScript>&)> ScriptForMining;
+    void ScriptForMining(boost::shared_ptr<CReserveScript>& coinbaseScript);
     /** Notifies listeners that a block has been successfully mined */
-    boost::signals2::signal<void (const uint256 &)> BlockFound;
+    void BlockFound(const uint256 &hash);
     /**
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
-    boost::signals2::signal<void (const CBlockIndex *, const std::shared_ptr<const CBlock>&)> NewPoWValidBlock;
+    void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block);
 };
 
 CMainSignals& GetMainSignals();
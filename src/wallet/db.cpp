@@ -160,6 +160,88 @@ CDBEnv::VerifyResult CDBEnv::Verify(const std::string& strFile, bool (*recoverFu
     return (fRecovered ? RECOVER_OK : RECOVER_FAIL);
 }
 
+namespace {
+
+//! Read all records of the CLogDB file strFile
+bool ReadLogDBRecords(const std::string& strFile, std::vector<CDBEnv::KeyValPair>& vResult)
+{
+    CLogDB logdb;
+    std::string strError;
+    if (!logdb.Open(GetDataDir() / strFile, false, strError))
+        return error("%s: %s", __func__, strError);
+    CSerializeData vchCursor;
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    for (bool fFirst = true; logdb.ReadNext(vchCursor, fFirst, ssKey, ssValue); fFirst = false)
+        vResult.push_back(std::make_pair(std::vector<unsigned char>(ssKey.begin(), ssKey.end()), std::vector<unsigned char>(ssValue.begin(), ssValue.end())));
+    return true;
+}
+
+//! Create the database file strFile, in a CLogDB if fLogDB and in Berkeley DB otherwise, holding vRecords
+bool WriteDatabaseFile(const std::string& strFile, bool fLogDB, const std::vector<CDBEnv::KeyValPair>& vRecords)
+{
+    bool fSuccess = true;
+    if (fLogDB) {
+        CLogDB logdb;
+        std::string strError;
+        if (!logdb.Open(GetDataDir() / strFile, true, strError))
+            return error("%s: %s", __func__, strError);
+        BOOST_FOREACH(const CDBEnv::KeyValPair& row, vRecords)
+        {
+            CDataStream ssKey(row.first, SER_DISK, CLIENT_VERSION);
+            CDataStream ssValue(row.second, SER_DISK, CLIENT_VERSION);
+            logdb.Write(ssKey, ssValue, false);
+        }
+        if (!logdb.Flush(true))
+            fSuccess = false;
+        logdb.Close();
+        return fSuccess;
+    }
+
+    std::unique_ptr<Db> pdbCopy(new Db(bitdb.dbenv, 0));
+    int ret = pdbCopy->open(NULL,               // Txn pointer
+                            strFile.c_str(),    // Filename
+                            "main",             // Logical db name
+                            DB_BTREE,           // Database type
+                            DB_CREATE,          // Flags
+                            0);
+    if (ret > 0)
+    {
+        LogPrintf("Cannot create database file %s\n", strFile);
+        return false;
+    }
+
+    DbTxn* ptxn = bitdb.TxnBegin();
+    BOOST_FOREACH(const CDBEnv::KeyValPair& row, vRecords)
+    {
+        Dbt datKey((void*)&row.first[0], row.first.size());
+        Dbt datValue((void*)&row.second[0], row.second.size());
+        int ret2 = pdbCopy->put(ptxn, &datKey, &datValue, DB_NOOVERWRITE);
+        if (ret2 > 0)
+            fSuccess = false;
+    }
+    ptxn->commit(0);
+    pdbCopy->close(0);
+
+    return fSuccess;
+}
+
+//! Rename the database file strFile, wherever it is stored
+bool RenameDatabaseFile(const std::string& strFile, const std::string& strNewFile)
+{
+    if (bitdb.IsLogDB(strFile)) {
+        try {
+            boost::filesystem::rename(GetDataDir() / strFile, GetDataDir() / strNewFile);
+            return true;
+        } catch (const boost::filesystem::filesystem_error&) {
+            return false;
+        }
+    }
+    return bitdb.dbenv->dbrename(NULL, strFile.c_str(), NULL, strNewFile.c_str(), DB_AUTO_COMMIT) == 0;
+}
+
+} // anon namespace
+
 bool CDB::Recover(const std::string& filename, void *callbackDataIn, bool (*recoverKVcallback)(void* callbackData, CDataStream ssKey, CDataStream ssValue))
 {
     // Recovery procedure:
@@ -169,12 +251,13 @@ bool CDB::Recover(const std::string& filename, void *callbackDataIn, bool (*reco
     // Rewrite salvaged data to fresh wallet file
     // Set -rescan so any missing transactions will be
     // found.
+    // Wallets stored in a CLogDB are recovered into a new log, from the
+    // records that remain after discarding an incomplete last batch.
+    bool fLogDB = bitdb.IsLogDB(filename);
     int64_t now = GetTime();
     std::string newFilename = strprintf("wallet.%d.bak", now);
 
-    int result = bitdb.dbenv->dbrename(NULL, filename.c_str(), NULL,
-                                       newFilename.c_str(), DB_AUTO_COMMIT);
-    if (result == 0)
+    if (RenameDatabaseFile(filename, newFilename))
         LogPrintf("Renamed %s to %s\n", filename, newFilename);
     else
     {
@@ -183,7 +266,7 @@ bool CDB::Recover(const std::string& filename, void *callbackDataIn, bool (*reco
     }
 
     std::vector<CDBEnv::KeyValPair> salvagedData;
-    bool fSuccess = bitdb.Salvage(newFilename, true, salvagedData);
+    bool fSuccess = fLogDB ? ReadLogDBRecords(newFilename, salvagedData) : bitdb.Salvage(newFilename, true, salvagedData);
     if (salvagedData.empty())
     {
         LogPrintf("Salvage(aggressive) found no records in %s.\n", newFilename);
@@ -191,42 +274,83 @@ bool CDB::Recover(const std::string& filename, void *callbackDataIn, bool (*reco
     }
     LogPrintf("Salvage(aggressive) found %u records\n", salvagedData.size());
 
-    std::unique_ptr<Db> pdbCopy(new Db(bitdb.dbenv, 0));
-    int ret = pdbCopy->open(NULL,               // Txn pointer
-                            filename.c_str(),   // Filename
-                            "main",             // Logical db name
-                            DB_BTREE,           // Database type
-                            DB_CREATE,          // Flags
-                            0);
-    if (ret > 0)
-    {
-        LogPrintf("Cannot create database file %s\n", filename);
-        return false;
-    }
-
-    DbTxn* ptxn = bitdb.TxnBegin();
+    std::vector<CDBEnv::KeyValPair> recoveredData;
     BOOST_FOREACH(CDBEnv::KeyValPair& row, salvagedData)
     {
         if (recoverKVcallback)
         {
             CDataStream ssKey(row.first, SER_DISK, CLIENT_VERSION);
             CDataStream ssValue(row.second, SER_DISK, CLIENT_VERSION);
-            std::string strType, strErr;
             if (!(*recoverKVcallback)(callbackDataIn, ssKey, ssValue))
                 continue;
         }
-        Dbt datKey(&row.first[0], row.first.size());
-        Dbt datValue(&row.second[0], row.second.size());
-        int ret2 = pdbCopy->put(ptxn, &datKey, &datValue, DB_NOOVERWRITE);
-        if (ret2 > 0)
-            fSuccess = false;
+        recoveredData.push_back(row);
     }
-    ptxn->commit(0);
-    pdbCopy->close(0);
+    if (!WriteDatabaseFile(filename, fLogDB, recoveredData))
+        fSuccess = false;
 
     return fSuccess;
 }
 
+bool CDB::Migrate(const std::string& strFile, const std::string& strBackend)
+{
+    bool fToLogDB = (strBackend == "log");
+    if (!boost::filesystem::exists(GetDataDir() / strFile) || bitdb.IsLogDB(strFile) == fToLogDB)
+        return true;
+
+    LOCK(bitdb.cs_db);
+    if (bitdb.mapFileUseCount.count(strFile) && bitdb.mapFileUseCount[strFile] > 0)
+        return error("CDB::Migrate: %s is in use", strFile);
+
+    LogPrintf("CDB::Migrate: Converting %s to %s storage...\n", strFile, fToLogDB ? "log" : "Berkeley DB");
+    int64_t nStart = GetTimeMillis();
+
+    std::vector<CDBEnv::KeyValPair> vRecords;
+    {
+        CDB db(strFile, "r");
+        CDBCursor* pcursor = db.GetCursor();
+        if (!pcursor)
+            return error("CDB::Migrate: Cannot read %s", strFile);
+        while (true) {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            int ret = db.ReadAtCursor(pcursor, ssKey, ssValue);
+            if (ret == DB_NOTFOUND)
+                break;
+            if (ret != 0) {
+                pcursor->close();
+                return error("CDB::Migrate: Error reading %s", strFile);
+            }
+            vRecords.push_back(std::make_pair(std::vector<unsigned char>(ssKey.begin(), ssKey.end()), std::vector<unsigned char>(ssValue.begin(), ssValue.end())));
+        }
+        pcursor->close();
+    }
+    bitdb.CloseDb(strFile);
+    bitdb.CheckpointLSN(strFile);
+    bitdb.mapFileUseCount.erase(strFile);
+
+    std::string strFileRes = strFile + ".migrate";
+    std::string strFileBak = strprintf("%s.%d.bak", strFile, GetTime());
+    if (!WriteDatabaseFile(strFileRes, fToLogDB, vRecords))
+        return error("CDB::Migrate: Failed to write %s", strFileRes);
+    if (!RenameDatabaseFile(strFile, strFileBak))
+        return error("CDB::Migrate: Failed to rename %s to %s", strFile, strFileBak);
+    if (fToLogDB) {
+        try {
+            boost::filesystem::rename(GetDataDir() / strFileRes, GetDataDir() / strFile);
+        } catch (const boost::filesystem::filesystem_error&) {
+            return error("CDB::Migrate: Failed to rename %s to %s", strFileRes, strFile);
+        }
+    } else {
+        Db db(bitdb.dbenv, 0);
+        if (db.rename(strFileRes.c_str(), NULL, strFile.c_str(), 0))
+            return error("CDB::Migrate: Failed to rename %s to %s", strFileRes, strFile);
+    }
+
+    LogPrintf("CDB::Migrate: Converted %u records in %dms, original kept as %s\n", vRecords.size(), GetTimeMillis() - nStart, strFileBak);
+    return true;
+}
+
 bool CDB::VerifyEnvironment(const std::string& walletFile, const boost::filesystem::path& dataDir, std::string& errorStr)
 {
     LogPrintf("Using BerkeleyDB version %s\n", DbEnv::version(0, 0, 0));
@@ -265,7 +389,17 @@ bool CDB::VerifyDatabaseFile(const std::string& walletFile, const boost::filesys
 {
     if (boost::filesystem::exists(dataDir / walletFile))
     {
-        CDBEnv::VerifyResult r = bitdb.Verify(walletFile, recoverFunc);
+        CDBEnv::VerifyResult r = CDBEnv::VERIFY_OK;
+        if (CLogDB::IsLogDBFile(dataDir / walletFile)) {
+            // Reading the log verifies it (and discards a torn write at its end)
+            CLogDB logdb;
+            std::string strError;
+            if (!logdb.Open(dataDir / walletFile, false, strError)) {
+                LogPrintf("CDB::VerifyDatabaseFile: %s\n", strError);
+                r = (*recoverFunc)(walletFile) ? CDBEnv::RECOVER_OK : CDBEnv::RECOVER_FAIL;
+            }
+        } else
+            r = bitdb.Verify(walletFile, recoverFunc);
         if (r == CDBEnv::RECOVER_OK)
         {
             warningStr = strprintf(_("Warning: Wallet file corrupt, data salvaged!"
@@ -353,13 +487,13 @@ bool CDBEnv::Salvage(const std::string& strFile, bool fAggressive, std::vector<C
 void CDBEnv::CheckpointLSN(const std::string& strFile)
 {
     dbenv->txn_checkpoint(0, 0, 0);
-    if (fMockDb)
+    if (fMockDb || IsLogDB(strFile))
         return;
     dbenv->lsn_reset(strFile.c_str(), 0);
 }
 
 
-CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnCloseIn) : pdb(NULL), activeTxn(NULL)
+CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnCloseIn) : pdb(NULL), plogdb(NULL), activeTxn(NULL), fLogTxn(false)
 {
     int ret;
     fReadOnly = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
@@ -380,7 +514,29 @@ CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnClose
         strFile = strFilename;
         ++bitdb.mapFileUseCount[strFile];
         pdb = bitdb.mapDb[strFile];
-        if (pdb == NULL) {
+        plogdb = bitdb.mapLogDb[strFile];
+        if (pdb == NULL && plogdb == NULL &&
+            (bitdb.IsLogDB(strFile) || (fCreate && !boost::filesystem::exists(GetDataDir() / strFile) && GetArg("-walletbackend", DEFAULT_WALLET_BACKEND) == "log"))) {
+            plogdb = new CLogDB();
+            std::string strError;
+            if (!plogdb->Open(GetDataDir() / strFile, fCreate, strError)) {
+                delete plogdb;
+                plogdb = NULL;
+                --bitdb.mapFileUseCount[strFile];
+                strFile = "";
+                throw std::runtime_error(strprintf("CDB: %s", strError));
+            }
+
+            if (fCreate && !Exists(std::string("version"))) {
+                bool fTmp = fReadOnly;
+                fReadOnly = false;
+                WriteVersion(CLIENT_VERSION);
+                fReadOnly = fTmp;
+            }
+
+            bitdb.mapLogDb[strFile] = plogdb;
+        }
+        if (pdb == NULL && plogdb == NULL) {
             pdb = new Db(bitdb.dbenv, 0);
 
             bool fMockDb = bitdb.IsMock();
@@ -423,6 +579,11 @@ void CDB::Flush()
     if (activeTxn)
         return;
 
+    if (plogdb) {
+        plogdb->Flush(true);
+        return;
+    }
+
     // Flush database activity from memory pool to disk log
     unsigned int nMinutes = 0;
     if (fReadOnly)
@@ -433,14 +594,21 @@ void CDB::Flush()
 
 void CDB::Close()
 {
-    if (!pdb)
+    if (!pdb && !plogdb)
         return;
     if (activeTxn)
         activeTxn->abort();
     activeTxn = NULL;
     pdb = NULL;
 
-    if (fFlushOnClose)
+    if (plogdb) {
+        if (fLogTxn)
+            plogdb->TxnAbort();
+        fLogTxn = false;
+        // Everything written through this handle goes to the log as one batch
+        plogdb->Flush(fFlushOnClose);
+        plogdb = NULL;
+    } else if (fFlushOnClose)
         Flush();
 
     {
@@ -460,9 +628,23 @@ void CDBEnv::CloseDb(const std::string& strFile)
             delete pdb;
             mapDb[strFile] = NULL;
         }
+        if (mapLogDb[strFile] != NULL) {
+            // Reclaim the space of dead records while nothing uses the log
+            CLogDB* plogdb = mapLogDb[strFile];
+            if (plogdb->NeedsCompaction())
+                plogdb->Compact();
+            plogdb->Close();
+            delete plogdb;
+            mapLogDb[strFile] = NULL;
+        }
     }
 }
 
+bool CDBEnv::IsLogDB(const std::string& strFile) const
+{
+    return CLogDB::IsLogDBFile(GetDataDir() / strFile);
+}
+
 bool CDBEnv::RemoveDb(const std::string& strFile)
 {
     this->CloseDb(strFile);
@@ -472,6 +654,42 @@ bool CDBEnv::RemoveDb(const std::string& strFile)
     return (rc == 0);
 }
 
+/** Rewrite for wallets stored in a CLogDB: drop the skipped records, update the version and compact the log */
+static bool RewriteLogDB(const std::string& strFile, const char* pszSkip)
+{
+    LogPrintf("CDB::Rewrite: Rewriting %s...\n", strFile);
+    CLogDB logdb;
+    std::string strError;
+    if (!logdb.Open(GetDataDir() / strFile, false, strError))
+        return error("CDB::Rewrite: %s", strError);
+
+    std::vector<CDataStream> vSkip;
+    CSerializeData vchCursor;
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    for (bool fFirst = true; logdb.ReadNext(vchCursor, fFirst, ssKey, ssValue); fFirst = false) {
+        if (pszSkip &&
+            strncmp(ssKey.data(), pszSkip, std::min(ssKey.size(), strlen(pszSkip))) == 0)
+            vSkip.push_back(ssKey);
+    }
+    BOOST_FOREACH(const CDataStream& ssSkip, vSkip)
+        logdb.Erase(ssSkip);
+
+    ssKey.clear();
+    ssKey << std::string("version");
+    if (logdb.Exists(ssKey)) {
+        ssValue.clear();
+        ssValue << CLIENT_VERSION;
+        logdb.Write(ssKey, ssValue);
+    }
+
+    bool fSuccess = logdb.Compact();
+    logdb.Close();
+    if (!fSuccess)
+        LogPrintf("CDB::Rewrite: Failed to rewrite database file %s\n", strFile);
+    return fSuccess;
+}
+
 bool CDB::Rewrite(const std::string& strFile, const char* pszSkip)
 {
     while (true) {
@@ -483,6 +701,9 @@ bool CDB::Rewrite(const std::string& strFile, const char* pszSkip)
                 bitdb.CheckpointLSN(strFile);
                 bitdb.mapFileUseCount.erase(strFile);
 
+                if (bitdb.IsLogDB(strFile))
+                    return RewriteLogDB(strFile, pszSkip);
+
                 bool fSuccess = true;
                 LogPrintf("CDB::Rewrite: Rewriting %s...\n", strFile);
                 std::string strFileRes = strFile + ".rewrite";
@@ -501,7 +722,7 @@ bool CDB::Rewrite(const std::string& strFile, const char* pszSkip)
                         fSuccess = false;
                     }
 
-                    Dbc* pcursor = db.GetCursor();
+                    CDBCursor* pcursor = db.GetCursor();
                     if (pcursor)
                         while (fSuccess) {
                             CDataStream ssKey(SER_DISK, CLIENT_VERSION);
@@ -576,7 +797,7 @@ void CDBEnv::Flush(bool fShutdown)
                 LogPrint("db", "CDBEnv::Flush: %s checkpoint\n", strFile);
                 dbenv->txn_checkpoint(0, 0, 0);
                 LogPrint("db", "CDBEnv::Flush: %s detach\n", strFile);
-                if (!fMockDb)
+                if (!fMockDb && !IsLogDB(strFile))
                     dbenv->lsn_reset(strFile.c_str(), 0);
                 LogPrint("db", "CDBEnv::Flush: %s closed\n", strFile);
                 mapFileUseCount.erase(mi++);
@@ -11,6 +11,7 @@
 #include "streams.h"
 #include "sync.h"
 #include "version.h"
+#include "wallet/logdb.h"
 
 #include <map>
 #include <string>
@@ -22,6 +23,8 @@
 
 static const unsigned int DEFAULT_WALLET_DBLOGSIZE = 100;
 static const bool DEFAULT_WALLET_PRIVDB = true;
+//! -walletbackend default: storage engine for new wallet files, "bdb" or "log"
+static const char* const DEFAULT_WALLET_BACKEND = "bdb";
 
 class CDBEnv
 {
@@ -39,6 +42,7 @@ public:
     DbEnv *dbenv;
     std::map<std::string, int> mapFileUseCount;
     std::map<std::string, Db*> mapDb;
+    std::map<std::string, CLogDB*> mapLogDb;
 
     CDBEnv();
     ~CDBEnv();
@@ -73,6 +77,8 @@ public:
     void CheckpointLSN(const std::string& strFile);
 
     void CloseDb(const std::string& strFile);
+    //! Whether strFile is stored in a CLogDB rather than in Berkeley DB
+    bool IsLogDB(const std::string& strFile) const;
     bool RemoveDb(const std::string& strFile);
 
     DbTxn* TxnBegin(int flags = DB_TXN_WRITE_NOSYNC)
@@ -88,13 +94,38 @@ public:
 extern CDBEnv bitdb;
 
 
-/** RAII class that provides access to a Berkeley database */
+/** Cursor over the records of a CDB in key order, whichever storage engine backs it */
+class CDBCursor
+{
+public:
+    Dbc* pcursor;
+    //! Key of the last record read from a CLogDB
+    CSerializeData vchKey;
+    bool fStarted;
+
+    explicit CDBCursor(Dbc* pcursorIn) : pcursor(pcursorIn), fStarted(false) {}
+
+    //! Release and delete the cursor, like Dbc::close()
+    void close()
+    {
+        if (pcursor)
+            pcursor->close();
+        delete this;
+    }
+};
+
+/**
+ * RAII class that provides access to a wallet database, which is either a
+ * Berkeley database or a CLogDB (see -walletbackend)
+ */
 class CDB
 {
 protected:
     Db* pdb;
+    CLogDB* plogdb;
     std::string strFile;
     DbTxn* activeTxn;
+    bool fLogTxn;
     bool fReadOnly;
     bool fFlushOnClose;
 
@@ -113,6 +144,8 @@ public:
     static bool VerifyEnvironment(const std::string& walletFile, const boost::filesystem::path& dataDir, std::string& errorStr);
     /* verifies the database file */
     static bool VerifyDatabaseFile(const std::string& walletFile, const boost::filesystem::path& dataDir, std::string& warningStr, std::string& errorStr, bool (*recoverFunc)(const std::string& strFile));
+    /* converts the database file to another storage engine ("bdb" or "log"), keeping the original as a backup */
+    static bool Migrate(const std::string& strFile, const std::string& strBackend);
 
 private:
     CDB(const CDB&);
@@ -122,13 +155,26 @@ protected:
     template <typename K, typename T>
     bool Read(const K& key, T& value)
     {
-        if (!pdb)
+        if (!pdb && !plogdb)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        if (plogdb) {
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            if (!plogdb->Read(ssKey, ssValue))
+                return false;
+            try {
+                ssValue >> value;
+            } catch (const std::exception&) {
+                return false;
+            }
+            return true;
+        }
+
         Dbt datKey(ssKey.data(), ssKey.size());
 
         // Read
@@ -156,7 +202,7 @@ protected:
     template <typename K, typename T>
     bool Write(const K& key, const T& value, bool fOverwrite = true)
     {
-        if (!pdb)
+        if (!pdb && !plogdb)
             return false;
         if (fReadOnly)
             assert(!"Write called on database in read-only mode");
@@ -165,12 +211,16 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
-        Dbt datKey(ssKey.data(), ssKey.size());
 
         // Value
         CDataStream ssValue(SER_DISK, CLIENT_VERSION);
         ssValue.reserve(10000);
         ssValue << value;
+
+        if (plogdb)
+            return plogdb->Write(ssKey, ssValue, fOverwrite);
+
+        Dbt datKey(ssKey.data(), ssKey.size());
         Dbt datValue(ssValue.data(), ssValue.size());
 
         // Write
@@ -185,7 +235,7 @@ protected:
     template <typename K>
     bool Erase(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !plogdb)
             return false;
         if (fReadOnly)
             assert(!"Erase called on database in read-only mode");
@@ -194,6 +244,11 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        if (plogdb) {
+            plogdb->Erase(ssKey);
+            return true;
+        }
         Dbt datKey(ssKey.data(), ssKey.size());
 
         // Erase
@@ -207,13 +262,16 @@ protected:
     template <typename K>
     bool Exists(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !plogdb)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        if (plogdb)
+            return plogdb->Exists(ssKey);
         Dbt datKey(ssKey.data(), ssKey.size());
 
         // Exists
@@ -224,20 +282,33 @@ protected:
         return (ret == 0);
     }
 
-    Dbc* GetCursor()
+    CDBCursor* GetCursor()
     {
+        if (plogdb)
+            return new CDBCursor(NULL);
         if (!pdb)
             return NULL;
         Dbc* pcursor = NULL;
         int ret = pdb->cursor(NULL, &pcursor, 0);
         if (ret != 0)
             return NULL;
-        return pcursor;
+        return new CDBCursor(pcursor);
     }
 
-    int ReadAtCursor(Dbc* pcursor, CDataStream& ssKey, CDataStream& ssValue, bool setRange = false)
+    int ReadAtCursor(CDBCursor* pdbcursor, CDataStream& ssKey, CDataStream& ssValue, bool setRange = false)
     {
+        if (plogdb) {
+            if (setRange)
+                pdbcursor->vchKey.assign(ssKey.begin(), ssKey.end());
+            bool fInclusive = setRange || !pdbcursor->fStarted;
+            pdbcursor->fStarted = true;
+            ssKey.SetType(SER_DISK);
+            ssValue.SetType(SER_DISK);
+            return plogdb->ReadNext(pdbcursor->vchKey, fInclusive, ssKey, ssValue) ? 0 : DB_NOTFOUND;
+        }
+
         // Read at cursor
+        Dbc* pcursor = pdbcursor->pcursor;
         Dbt datKey;
         unsigned int fFlags = DB_NEXT;
         if (setRange) {
@@ -273,6 +344,12 @@ protected:
 public:
     bool TxnBegin()
     {
+        if (plogdb) {
+            if (fLogTxn || !plogdb->TxnBegin())
+                return false;
+            fLogTxn = true;
+            return true;
+        }
         if (!pdb || activeTxn)
             return false;
         DbTxn* ptxn = bitdb.TxnBegin();
@@ -284,6 +361,12 @@ public:
 
     bool TxnCommit()
     {
+        if (plogdb) {
+            if (!fLogTxn)
+                return false;
+            fLogTxn = false;
+            return plogdb->TxnCommit();
+        }
         if (!pdb || !activeTxn)
             return false;
         int ret = activeTxn->commit(0);
@@ -293,6 +376,12 @@ public:
 
     bool TxnAbort()
     {
+        if (plogdb) {
+            if (!fLogTxn)
+                return false;
+            fLogTxn = false;
+            return plogdb->TxnAbort();
+        }
         if (!pdb || !activeTxn)
             return false;
         int ret = activeTxn->abort();
@@ -0,0 +1,427 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "wallet/logdb.h"
+
+#include "clientversion.h"
+#include "crypto/common.h"
+#include "hash.h"
+#include "util.h"
+
+#include <string.h>
+
+#include <boost/filesystem.hpp>
+
+namespace {
+
+//! File header: magic bytes, followed by the format version
+const unsigned char LOGDB_MAGIC[8] = {0x00, 'l', 'o', 'g', 'w', 'a', 'l', 't'};
+const uint32_t LOGDB_VERSION = 1;
+const unsigned int LOGDB_HEADER_SIZE = sizeof(LOGDB_MAGIC) + 4;
+//! Batch header: payload size and checksum
+const unsigned int LOGDB_BATCH_HEADER_SIZE = 8;
+
+const unsigned char LOGDB_PUT = 'p';
+const unsigned char LOGDB_ERASE = 'e';
+
+uint32_t BatchChecksum(const CDataStream& ssBatch)
+{
+    uint256 hash = Hash(ssBatch.begin(), ssBatch.end());
+    return ReadLE32(hash.begin());
+}
+
+CSerializeData KeyData(const CDataStream& ssKey)
+{
+    return CSerializeData(ssKey.begin(), ssKey.end());
+}
+
+} // anon namespace
+
+CLogDB::CLogDB() : file(NULL), ssPending(SER_DISK, CLIENT_VERSION), nFileSize(0), nLiveSize(0), fInTxn(false)
+{
+}
+
+CLogDB::~CLogDB()
+{
+    Close();
+}
+
+bool CLogDB::IsLogDBFile(const boost::filesystem::path& pathIn)
+{
+    FILE* fileIn = fopen(pathIn.string().c_str(), "rb");
+    if (!fileIn)
+        return false;
+    unsigned char magic[sizeof(LOGDB_MAGIC)];
+    bool fRet = fread(magic, 1, sizeof(magic), fileIn) == sizeof(magic) && memcmp(magic, LOGDB_MAGIC, sizeof(magic)) == 0;
+    fclose(fileIn);
+    return fRet;
+}
+
+bool CLogDB::Open(const boost::filesystem::path& pathIn, bool fCreate, std::string& strError)
+{
+    LOCK(cs_logdb);
+    assert(file == NULL);
+
+    path = pathIn;
+    mapRecords.clear();
+    nLiveSize = 0;
+    file = fopen(path.string().c_str(), "rb+");
+    if (!file && fCreate && !boost::filesystem::exists(path)) {
+        file = fopen(path.string().c_str(), "wb+");
+        if (file) {
+            unsigned char header[LOGDB_HEADER_SIZE];
+            memcpy(header, LOGDB_MAGIC, sizeof(LOGDB_MAGIC));
+            WriteLE32(header + sizeof(LOGDB_MAGIC), LOGDB_VERSION);
+            if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+                fclose(file);
+                file = NULL;
+                strError = strprintf("cannot write to %s", path.string());
+                return false;
+            }
+            FileCommit(file);
+            nFileSize = sizeof(header);
+            return true;
+        }
+    }
+    if (!file) {
+        strError = strprintf("cannot open %s", path.string());
+        return false;
+    }
+
+    unsigned char header[LOGDB_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, LOGDB_MAGIC, sizeof(LOGDB_MAGIC)) != 0) {
+        Close();
+        strError = strprintf("%s is not a log database", path.string());
+        return false;
+    }
+    if (ReadLE32(header + sizeof(LOGDB_MAGIC)) > LOGDB_VERSION) {
+        Close();
+        strError = strprintf("%s was written by a newer version of the software", path.string());
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    uint64_t nSize = ftell(file);
+    fseek(file, sizeof(header), SEEK_SET);
+
+    // Replay the log: one sequential pass over all batches
+    uint64_t nPos = sizeof(header);
+    CDataStream ssBatch(SER_DISK, CLIENT_VERSION);
+    while (nPos + LOGDB_BATCH_HEADER_SIZE <= nSize) {
+        unsigned char batchHeader[LOGDB_BATCH_HEADER_SIZE];
+        if (fread(batchHeader, 1, sizeof(batchHeader), file) != sizeof(batchHeader))
+            break;
+        uint32_t nBatchSize = ReadLE32(batchHeader);
+        if (nBatchSize > nSize - nPos - sizeof(batchHeader))
+            break;
+        ssBatch.clear();
+        ssBatch.resize(nBatchSize);
+        if (nBatchSize && fread(&ssBatch[0], 1, nBatchSize, file) != nBatchSize)
+            break;
+        if (BatchChecksum(ssBatch) != ReadLE32(batchHeader + 4))
+            break;
+
+        try {
+            while (!ssBatch.empty()) {
+                unsigned char chType;
+                CSerializeData vchKey;
+                ssBatch >> chType >> vchKey;
+                RecordMap::iterator it = mapRecords.find(vchKey);
+                if (it != mapRecords.end()) {
+                    AddLive(it->first, it->second, -1);
+                    if (chType == LOGDB_ERASE)
+                        mapRecords.erase(it);
+                }
+                if (chType == LOGDB_PUT) {
+                    CSerializeData& vchValue = mapRecords[vchKey];
+                    ssBatch >> vchValue;
+                    AddLive(vchKey, vchValue, 1);
+                } else if (chType != LOGDB_ERASE) {
+                    throw std::ios_base::failure("unknown record type");
+                }
+            }
+        } catch (const std::exception& e) {
+            // A batch with a valid checksum should always parse
+            Close();
+            strError = strprintf("%s is corrupt: %s", path.string(), e.what());
+            return false;
+        }
+        nPos += sizeof(batchHeader) + nBatchSize;
+    }
+
+    if (nPos != nSize) {
+        LogPrintf("CLogDB::Open: discarding %u bytes of incomplete writes at the end of %s\n", nSize - nPos, path.string());
+        if (!TruncateFile(file, nPos)) {
+            Close();
+            strError = strprintf("cannot truncate %s", path.string());
+            return false;
+        }
+        FileCommit(file);
+    }
+    fseek(file, nPos, SEEK_SET);
+    nFileSize = nPos;
+
+    LogPrint("db", "CLogDB::Open: loaded %u records from %s (%u bytes)\n", mapRecords.size(), path.string(), nFileSize);
+    return true;
+}
+
+void CLogDB::Close()
+{
+    LOCK(cs_logdb);
+    if (!file)
+        return;
+    if (fInTxn)
+        TxnAbort();
+    AppendPending();
+    FileCommit(file);
+    fclose(file);
+    file = NULL;
+}
+
+void CLogDB::AddLive(const CSerializeData& vchKey, const CSerializeData& vchValue, int nSign)
+{
+    // One type byte and (usually) one byte for each of the two size prefixes
+    nLiveSize += nSign * (int64_t)(3 + vchKey.size() + vchValue.size());
+}
+
+void CLogDB::SaveUndo(const CSerializeData& vchKey)
+{
+    RecordMap::const_iterator it = mapRecords.find(vchKey);
+    if (it == mapRecords.end())
+        vUndo.push_back(std::make_pair(vchKey, std::make_pair(false, CSerializeData())));
+    else
+        vUndo.push_back(std::make_pair(vchKey, std::make_pair(true, it->second)));
+}
+
+bool CLogDB::Read(const CDataStream& ssKey, CDataStream& ssValue) const
+{
+    LOCK(cs_logdb);
+    RecordMap::const_iterator it = mapRecords.find(KeyData(ssKey));
+    if (it == mapRecords.end())
+        return false;
+    ssValue.clear();
+    ssValue.write(it->second.data(), it->second.size());
+    return true;
+}
+
+bool CLogDB::Exists(const CDataStream& ssKey) const
+{
+    LOCK(cs_logdb);
+    return mapRecords.count(KeyData(ssKey)) > 0;
+}
+
+bool CLogDB::Write(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite)
+{
+    LOCK(cs_logdb);
+    CSerializeData vchKey = KeyData(ssKey);
+    RecordMap::iterator it = mapRecords.find(vchKey);
+    if (it != mapRecords.end() && !fOverwrite)
+        return false;
+    if (fInTxn)
+        SaveUndo(vchKey);
+    if (it != mapRecords.end()) {
+        AddLive(it->first, it->second, -1);
+        it->second.assign(ssValue.begin(), ssValue.end());
+    } else {
+        it = mapRecords.insert(std::make_pair(vchKey, CSerializeData(ssValue.begin(), ssValue.end()))).first;
+    }
+    AddLive(it->first, it->second, 1);
+
+    ssPending << LOGDB_PUT << it->first << it->second;
+    if (!fInTxn && ssPending.size() >= LOGDB_MAX_PENDING)
+        return AppendPending();
+    return true;
+}
+
+void CLogDB::Erase(const CDataStream& ssKey)
+{
+    LOCK(cs_logdb);
+    CSerializeData vchKey = KeyData(ssKey);
+    RecordMap::iterator it = mapRecords.find(vchKey);
+    if (it == mapRecords.end())
+        return;
+    if (fInTxn)
+        SaveUndo(vchKey);
+    AddLive(it->first, it->second, -1);
+    mapRecords.erase(it);
+
+    ssPending << LOGDB_ERASE << vchKey;
+    if (!fInTxn && ssPending.size() >= LOGDB_MAX_PENDING)
+        AppendPending();
+}
+
+bool CLogDB::ReadNext(CSerializeData& vchCursor, bool fInclusive, CDataStream& ssKey, CDataStream& ssValue) const
+{
+    LOCK(cs_logdb);
+    RecordMap::const_iterator it = fInclusive ? mapRecords.lower_bound(vchCursor) : mapRecords.upper_bound(vchCursor);
+    if (it == mapRecords.end())
+        return false;
+    vchCursor = it->first;
+    ssKey.clear();
+    ssKey.write(it->first.data(), it->first.size());
+    ssValue.clear();
+    ssValue.write(it->second.data(), it->second.size());
+    return true;
+}
+
+bool CLogDB::TxnBegin()
+{
+    LOCK(cs_logdb);
+    if (!file || fInTxn)
+        return false;
+    // Start the transaction with an empty batch, so that it is appended whole
+    if (!AppendPending())
+        return false;
+    fInTxn = true;
+    return true;
+}
+
+bool CLogDB::TxnCommit()
+{
+    LOCK(cs_logdb);
+    if (!fInTxn)
+        return false;
+    fInTxn = false;
+    vUndo.clear();
+    return AppendPending();
+}
+
+bool CLogDB::TxnAbort()
+{
+    LOCK(cs_logdb);
+    if (!fInTxn)
+        return false;
+    for (std::vector<std::pair<CSerializeData, std::pair<bool, CSerializeData> > >::reverse_iterator it = vUndo.rbegin(); it != vUndo.rend(); ++it) {
+        RecordMap::iterator mi = mapRecords.find(it->first);
+        if (mi != mapRecords.end()) {
+            AddLive(mi->first, mi->second, -1);
+            mapRecords.erase(mi);
+        }
+        if (it->second.first) {
+            mapRecords[it->first] = it->second.second;
+            AddLive(it->first, it->second.second, 1);
+        }
+    }
+    vUndo.clear();
+    ssPending.clear();
+    fInTxn = false;
+    return true;
+}
+
+bool CLogDB::WriteBatch(FILE* fileOut, const CDataStream& ssBatch, uint64_t& nWritten)
+{
+    unsigned char batchHeader[LOGDB_BATCH_HEADER_SIZE];
+    WriteLE32(batchHeader, ssBatch.size());
+    WriteLE32(batchHeader + 4, BatchChecksum(ssBatch));
+    if (fwrite(batchHeader, 1, sizeof(batchHeader), fileOut) != sizeof(batchHeader) ||
+        fwrite(ssBatch.data(), 1, ssBatch.size(), fileOut) != ssBatch.size())
+        return false;
+    nWritten += sizeof(batchHeader) + ssBatch.size();
+    return true;
+}
+
+bool CLogDB::AppendPending()
+{
+    AssertLockHeld(cs_logdb);
+    if (ssPending.empty())
+        return true;
+    if (!file)
+        return false;
+    uint64_t nWritten = 0;
+    bool fOk = WriteBatch(file, ssPending, nWritten) && fflush(file) == 0;
+    nFileSize += nWritten;
+    ssPending.clear();
+    if (!fOk)
+        return error("CLogDB::AppendPending: failed to write to %s", path.string());
+    return true;
+}
+
+bool CLogDB::Flush(bool fSync)
+{
+    LOCK(cs_logdb);
+    if (!file)
+        return false;
+    // A transaction's writes are only ever appended by TxnCommit
+    if (fInTxn)
+        return true;
+    if (!AppendPending())
+        return false;
+    if (fSync)
+        FileCommit(file);
+    return true;
+}
+
+bool CLogDB::NeedsCompaction() const
+{
+    LOCK(cs_logdb);
+    return nFileSize >= LOGDB_COMPACT_MIN_SIZE && nFileSize > LOGDB_COMPACT_RATIO * nLiveSize;
+}
+
+bool CLogDB::Compact()
+{
+    LOCK(cs_logdb);
+    if (!file || fInTxn)
+        return false;
+    if (!AppendPending())
+        return false;
+
+    int64_t nStart = GetTimeMillis();
+    boost::filesystem::path pathCompact = path.string() + ".compact";
+    FILE* fileOut = fopen(pathCompact.string().c_str(), "wb");
+    if (!fileOut)
+        return error("CLogDB::Compact: cannot create %s", pathCompact.string());
+
+    unsigned char header[LOGDB_HEADER_SIZE];
+    memcpy(header, LOGDB_MAGIC, sizeof(LOGDB_MAGIC));
+    WriteLE32(header + sizeof(LOGDB_MAGIC), LOGDB_VERSION);
+    bool fOk = fwrite(header, 1, sizeof(header), fileOut) == sizeof(header);
+    uint64_t nWritten = sizeof(header);
+
+    CDataStream ssBatch(SER_DISK, CLIENT_VERSION);
+    for (RecordMap::const_iterator it = mapRecords.begin(); fOk && it != mapRecords.end(); ++it) {
+        ssBatch << LOGDB_PUT << it->first << it->second;
+        if (ssBatch.size() >= LOGDB_MAX_PENDING) {
+            fOk = WriteBatch(fileOut, ssBatch, nWritten);
+            ssBatch.clear();
+        }
+    }
+    if (fOk && !ssBatch.empty())
+        fOk = WriteBatch(fileOut, ssBatch, nWritten);
+    if (fOk)
+        FileCommit(fileOut);
+    fclose(fileOut);
+
+    if (!fOk) {
+        boost::filesystem::remove(pathCompact);
+        return error("CLogDB::Compact: failed to write %s", pathCompact.string());
+    }
+
+    // Swap in the compacted file and continue appending to it
+    fclose(file);
+    fOk = RenameOver(pathCompact, path);
+    file = fopen(path.string().c_str(), "rb+");
+    if (!file)
+        return error("CLogDB::Compact: cannot reopen %s", path.string());
+    if (!fOk) {
+        boost::filesystem::remove(pathCompact);
+        fseek(file, 0, SEEK_END);
+        return error("CLogDB::Compact: cannot replace %s", path.string());
+    }
+    fseek(file, 0, SEEK_END);
+    LogPrint("db", "CLogDB::Compact: %s from %u to %u bytes in %dms\n", path.string(), nFileSize, nWritten, GetTimeMillis() - nStart);
+    nFileSize = nWritten;
+    return true;
+}
+
+size_t CLogDB::GetRecordCount() const
+{
+    LOCK(cs_logdb);
+    return mapRecords.size();
+}
+
+uint64_t CLogDB::GetFileSize() const
+{
+    LOCK(cs_logdb);
+    return nFileSize;
+}
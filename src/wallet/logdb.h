@@ -0,0 +1,110 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_WALLET_LOGDB_H
+#define BITCOIN_WALLET_LOGDB_H
+
+#include "streams.h"
+#include "sync.h"
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+//! Append writes made outside of a transaction once this many bytes are pending
+static const unsigned int LOGDB_MAX_PENDING = 1 << 20;
+//! Compact a log once it is this many times the size of its live records...
+static const unsigned int LOGDB_COMPACT_RATIO = 2;
+//! ...and at least this large
+static const uint64_t LOGDB_COMPACT_MIN_SIZE = 1 << 20;
+
+/**
+ * Append-only, log-structured key/value store, used for wallet files as an
+ * alternative to Berkeley DB (see -walletbackend).
+ *
+ * The file is a header followed by checksummed batches of put and erase
+ * records. All live records are kept in memory, so opening a store is a
+ * single sequential read, and writes are buffered and appended one batch at
+ * a time (per transaction, or when the CDB handle doing them is closed). A
+ * torn batch at the end of the file, left by a crash, is discarded on open.
+ * Space taken by overwritten and erased records is reclaimed by Compact(),
+ * which writes the live records to a new file and renames it over the log.
+ */
+class CLogDB
+{
+public:
+    typedef std::map<CSerializeData, CSerializeData> RecordMap;
+
+private:
+    mutable CCriticalSection cs_logdb;
+    boost::filesystem::path path;
+    FILE* file;
+    RecordMap mapRecords;
+
+    //! Records written since the last append to the file, as one batch
+    CDataStream ssPending;
+    //! Size of the file, and an estimate of what its live records take up
+    uint64_t nFileSize;
+    uint64_t nLiveSize;
+
+    bool fInTxn;
+    //! Previous state of the records changed by the active transaction, to restore on abort
+    std::vector<std::pair<CSerializeData, std::pair<bool, CSerializeData> > > vUndo;
+
+    void SaveUndo(const CSerializeData& vchKey);
+    void AddLive(const CSerializeData& vchKey, const CSerializeData& vchValue, int nSign);
+    bool AppendPending();
+    static bool WriteBatch(FILE* fileOut, const CDataStream& ssBatch, uint64_t& nWritten);
+
+    CLogDB(const CLogDB&);
+    void operator=(const CLogDB&);
+
+public:
+    CLogDB();
+    ~CLogDB();
+
+    //! Whether the file at pathIn is a log store (as opposed to, e.g., a Berkeley DB file)
+    static bool IsLogDBFile(const boost::filesystem::path& pathIn);
+
+    /**
+     * Open (or with fCreate, create) the store at pathIn and load its
+     * records. Returns false and sets strError if the file cannot be read
+     * or is not a log store.
+     */
+    bool Open(const boost::filesystem::path& pathIn, bool fCreate, std::string& strError);
+    //! Append pending writes, sync and close the file
+    void Close();
+
+    bool Read(const CDataStream& ssKey, CDataStream& ssValue) const;
+    bool Exists(const CDataStream& ssKey) const;
+    bool Write(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite = true);
+    void Erase(const CDataStream& ssKey);
+
+    /**
+     * Read the first record with a key after vchCursor (or at it or after, if
+     * fInclusive) into ssKey and ssValue, and move vchCursor to its key.
+     * Returns false if there is no such record.
+     */
+    bool ReadNext(CSerializeData& vchCursor, bool fInclusive, CDataStream& ssKey, CDataStream& ssValue) const;
+
+    bool TxnBegin();
+    bool TxnCommit();
+    bool TxnAbort();
+
+    //! Append pending writes to the file, and make them durable if fSync
+    bool Flush(bool fSync);
+    //! Whether enough of the file is taken by dead records to be worth a Compact()
+    bool NeedsCompaction() const;
+    //! Rewrite the log to contain only the live records
+    bool Compact();
+
+    size_t GetRecordCount() const;
+    uint64_t GetFileSize() const;
+};
+
+#endif // BITCOIN_WALLET_LOGDB_H
@@ -18,6 +18,7 @@
 #include "timedata.h"
 #include "util.h"
 #include "utilmoneystr.h"
+#include "validationinterface.h"
 #include "wallet.h"
 #include "walletdb.h"
 
@@ -47,6 +48,10 @@ bool EnsureWalletIsAvailable(CWallet * const pwallet, bool avoidException)
         else
             return false;
     }
+    // Chain notifications reach the wallet in the background; make sure it
+    // has seen everything validation did before answering the call.
+    if (!avoidException)
+        SyncWithValidationInterfaceQueue();
     return true;
 }
 
@@ -2454,6 +2459,49 @@ UniValue getwalletinfo(const JSONRPCRequest& request)
     return obj;
 }
 
+UniValue getrescaninfo(const JSONRPCRequest& request)
+{
+    CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
+    // Unlike other wallet calls, do not wait for the validation interface
+    // queue: it may be held up by the very rescan this reports on.
+    if (!EnsureWalletIsAvailable(pwallet, true)) {
+        if (request.fHelp)
+            return NullUniValue;
+        throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found (disabled)");
+    }
+
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getrescaninfo\n"
+            "Returns the progress of the running wallet rescan, or the statistics of the last one.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"scanning\": true|false,     (boolean) whether a rescan is in progress\n"
+            "  \"duration\": xxxx,           (numeric) elapsed time of the rescan in seconds\n"
+            "  \"progress\": x.xxxx,         (numeric) fraction of the rescan completed, estimated from transaction counts\n"
+            "  \"height\": xxxx,             (numeric) height of the last block scanned, or -1\n"
+            "  \"blocks\": xxxx,             (numeric) number of blocks scanned\n"
+            "  \"blockspersecond\": xxxx,    (numeric) rescan throughput\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getrescaninfo", "")
+            + HelpExampleRpc("getrescaninfo", "")
+        );
+
+    // No locks are taken: a rescan holds cs_main and cs_wallet until it is done.
+    const int64_t nDuration = pwallet->ScanningDuration();
+    const int64_t nBlocks = pwallet->ScanningBlocks();
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("scanning", pwallet->IsScanning()));
+    obj.push_back(Pair("duration", nDuration * 0.001));
+    obj.push_back(Pair("progress", pwallet->ScanningProgress()));
+    obj.push_back(Pair("height", pwallet->ScanningHeight()));
+    obj.push_back(Pair("blocks", nBlocks));
+    obj.push_back(Pair("blockspersecond", nDuration > 0 ? nBlocks * 1000.0 / nDuration : 0.0));
+    return obj;
+}
+
 UniValue resendwallettransactions(const JSONRPCRequest& request)
 {
     CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
@@ -3121,6 +3169,7 @@ static const CRPCCommand commands[] =
     { "wallet",             "getrawchangeaddress",      &getrawchangeaddress,      true,   {} },
     { "wallet",             "getreceivedbyaccount",     &getreceivedbyaccount,     false,  {"account","minconf"} },
     { "wallet",             "getreceivedbyaddress",     &getreceivedbyaddress,     false,  {"address","minconf"} },
+    { "wallet",             "getrescaninfo",            &getrescaninfo,            true,   {} },
     { "wallet",             "gettransaction",           &gettransaction,           false,  {"txid","include_watchonly"} },
     { "wallet",             "getunconfirmedbalance",    &getunconfirmedbalance,    false,  {} },
     { "wallet",             "getwalletinfo",            &getwalletinfo,            false,  {} },
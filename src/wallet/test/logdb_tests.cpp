@@ -0,0 +1,171 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "wallet/logdb.h"
+#include "wallet/wallet.h"
+#include "wallet/walletdb.h"
+
+#include "clientversion.h"
+#include "util.h"
+#include "wallet/test/wallet_test_fixture.h"
+
+#include <stdio.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(logdb_tests, WalletTestingSetup)
+
+static CDataStream Stream(const std::string& str)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << str;
+    return ss;
+}
+
+static std::string ReadString(const CLogDB& logdb, const std::string& strKey)
+{
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    std::string str;
+    if (logdb.Read(Stream(strKey), ssValue))
+        ssValue >> str;
+    return str;
+}
+
+BOOST_AUTO_TEST_CASE(logdb_replay)
+{
+    boost::filesystem::path path = GetDataDir() / "logdb_replay";
+    std::string strError;
+    {
+        CLogDB logdb;
+        BOOST_CHECK(logdb.Open(path, true, strError));
+        BOOST_CHECK(logdb.Write(Stream("a"), Stream("1")));
+        BOOST_CHECK(logdb.Write(Stream("b"), Stream("2")));
+        BOOST_CHECK(!logdb.Write(Stream("b"), Stream("3"), false));
+        BOOST_CHECK(logdb.Write(Stream("b"), Stream("4")));
+        logdb.Erase(Stream("a"));
+        BOOST_CHECK(logdb.Flush(true));
+        BOOST_CHECK(logdb.Write(Stream("c"), Stream("5")));
+    }
+    BOOST_CHECK(CLogDB::IsLogDBFile(path));
+
+    // Reopening replays every batch, including the one appended on close
+    uint64_t nSize;
+    {
+        CLogDB logdb;
+        BOOST_CHECK(logdb.Open(path, false, strError));
+        BOOST_CHECK_EQUAL(logdb.GetRecordCount(), 2U);
+        BOOST_CHECK(!logdb.Exists(Stream("a")));
+        BOOST_CHECK_EQUAL(ReadString(logdb, "b"), "4");
+        BOOST_CHECK_EQUAL(ReadString(logdb, "c"), "5");
+        nSize = logdb.GetFileSize();
+    }
+
+    // A torn batch at the end of the log is discarded
+    FILE* file = fopen(path.string().c_str(), "ab");
+    const char garbage[] = {0x20, 0x00, 0x00, 0x00, 0x01, 0x02};
+    BOOST_CHECK_EQUAL(fwrite(garbage, 1, sizeof(garbage), file), sizeof(garbage));
+    fclose(file);
+    {
+        CLogDB logdb;
+        BOOST_CHECK(logdb.Open(path, false, strError));
+        BOOST_CHECK_EQUAL(logdb.GetRecordCount(), 2U);
+        BOOST_CHECK_EQUAL(logdb.GetFileSize(), nSize);
+        BOOST_CHECK_EQUAL(boost::filesystem::file_size(path), nSize);
+    }
+
+    // Other files are not mistaken for a log
+    boost::filesystem::path pathOther = GetDataDir() / "logdb_other";
+    file = fopen(pathOther.string().c_str(), "wb");
+    BOOST_CHECK_EQUAL(fwrite(garbage, 1, sizeof(garbage), file), sizeof(garbage));
+    fclose(file);
+    BOOST_CHECK(!CLogDB::IsLogDBFile(pathOther));
+    CLogDB logdb;
+    BOOST_CHECK(!logdb.Open(pathOther, false, strError));
+}
+
+BOOST_AUTO_TEST_CASE(logdb_txn_cursor_compact)
+{
+    boost::filesystem::path path = GetDataDir() / "logdb_txn";
+    std::string strError;
+    CLogDB logdb;
+    BOOST_CHECK(logdb.Open(path, true, strError));
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK(logdb.Write(Stream(strprintf("key%03d", i)), Stream(std::string(1000, 'x'))));
+
+    // An aborted transaction leaves no trace, in memory or in the file
+    BOOST_CHECK(logdb.Flush(true));
+    uint64_t nSize = logdb.GetFileSize();
+    BOOST_CHECK(logdb.TxnBegin());
+    BOOST_CHECK(!logdb.TxnBegin());
+    logdb.Erase(Stream("key000"));
+    BOOST_CHECK(logdb.Write(Stream("key001"), Stream("changed")));
+    BOOST_CHECK(logdb.Write(Stream("new"), Stream("added")));
+    BOOST_CHECK(logdb.Flush(true));
+    BOOST_CHECK(logdb.TxnAbort());
+    BOOST_CHECK_EQUAL(logdb.GetFileSize(), nSize);
+    BOOST_CHECK_EQUAL(logdb.GetRecordCount(), 100U);
+    BOOST_CHECK_EQUAL(ReadString(logdb, "key001"), std::string(1000, 'x'));
+    BOOST_CHECK(!logdb.Exists(Stream("new")));
+
+    // A committed one is appended as a single batch
+    BOOST_CHECK(logdb.TxnBegin());
+    for (int i = 0; i < 100; i += 2)
+        logdb.Erase(Stream(strprintf("key%03d", i)));
+    BOOST_CHECK(logdb.TxnCommit());
+    BOOST_CHECK(logdb.GetFileSize() > nSize);
+
+    // Records are visited in key order
+    CSerializeData vchCursor;
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    int nCount = 0;
+    for (bool fFirst = true; logdb.ReadNext(vchCursor, fFirst, ssKey, ssValue); fFirst = false) {
+        std::string strKey;
+        ssKey >> strKey;
+        BOOST_CHECK_EQUAL(strKey, strprintf("key%03d", 2 * nCount + 1));
+        nCount++;
+    }
+    BOOST_CHECK_EQUAL(nCount, 50);
+
+    // Rewriting just the live records roughly halves the log
+    nSize = logdb.GetFileSize();
+    BOOST_CHECK(logdb.Compact());
+    BOOST_CHECK(logdb.GetFileSize() < nSize / 2 + 1000);
+    BOOST_CHECK(logdb.Write(Stream("after"), Stream("compaction")));
+    logdb.Close();
+    BOOST_CHECK(logdb.Open(path, false, strError));
+    BOOST_CHECK_EQUAL(logdb.GetRecordCount(), 51U);
+    BOOST_CHECK_EQUAL(ReadString(logdb, "after"), "compaction");
+}
+
+BOOST_AUTO_TEST_CASE(logdb_walletdb)
+{
+    // New wallet files use the log when -walletbackend=log
+    ForceSetArg("-walletbackend", "log");
+    {
+        CWalletDB walletdb("wallet_log.dat", "cr+");
+        BOOST_CHECK(walletdb.WriteName("address", "label"));
+        CAccountingEntry acentry;
+        acentry.strAccount = "account";
+        acentry.nCreditDebit = 42;
+        BOOST_CHECK(walletdb.WriteAccountingEntry_Backend(acentry));
+    }
+    ForceSetArg("-walletbackend", DEFAULT_WALLET_BACKEND);
+    BOOST_CHECK(bitdb.IsLogDB("wallet_log.dat"));
+    BOOST_CHECK(!bitdb.IsLogDB("wallet_test.dat"));
+
+    // Existing ones keep theirs, and ranged cursor reads work on them
+    bitdb.CloseDb("wallet_log.dat");
+    {
+        CWalletDB walletdb("wallet_log.dat", "r+");
+        int nVersion = 0;
+        BOOST_CHECK(walletdb.ReadVersion(nVersion));
+        BOOST_CHECK_EQUAL(nVersion, CLIENT_VERSION);
+        BOOST_CHECK_EQUAL(walletdb.GetAccountCreditDebit("account"), 42);
+        BOOST_CHECK_EQUAL(walletdb.GetAccountCreditDebit("other"), 0);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -379,6 +379,22 @@ BOOST_FIXTURE_TEST_CASE(rescan, TestChain100Setup)
         BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), 100 * COIN);
     }
 
+    // Same with blocks read by several threads, which must not change the
+    // outcome, and check the progress reported for the finished rescan.
+    {
+        ForceSetArg("-rescanthreads", "4");
+        CWallet wallet;
+        LOCK(wallet.cs_wallet);
+        wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+        BOOST_CHECK_EQUAL(oldTip, wallet.ScanForWalletTransactions(oldTip));
+        BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), 100 * COIN);
+        BOOST_CHECK(!wallet.IsScanning());
+        BOOST_CHECK_EQUAL(wallet.ScanningBlocks(), 2);
+        BOOST_CHECK_EQUAL(wallet.ScanningHeight(), newTip->nHeight);
+        BOOST_CHECK_EQUAL(wallet.ScanningProgress(), 1.0);
+        ForceSetArg("-rescanthreads", std::to_string(DEFAULT_RESCAN_THREADS));
+    }
+
     // Prune the older block file.
     PruneOneBlockFile(oldTip->GetBlockPos().nFile);
     UnlinkPrunedFiles({oldTip->GetBlockPos().nFile});
@@ -426,6 +442,45 @@ BOOST_FIXTURE_TEST_CASE(rescan, TestChain100Setup)
     }
 }
 
+// Check that the filter used by rescans matches every output template IsMine()
+// can consider ours, and nothing unrelated.
+BOOST_AUTO_TEST_CASE(rescan_filter)
+{
+    CWallet wallet;
+    LOCK(wallet.cs_wallet);
+    CKey key, otherKey;
+    key.MakeNewKey(true);
+    otherKey.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+    CPubKey otherPubkey = otherKey.GetPubKey();
+    wallet.AddKeyPubKey(key, pubkey);
+
+    CScript p2pkh = GetScriptForDestination(pubkey.GetID());
+    CScript p2wpkh = CScript() << OP_0 << ToByteVector(pubkey.GetID());
+    CScript multisig = GetScriptForMultisig(1, {otherPubkey, pubkey});
+    CScript p2wsh = GetScriptForWitness(multisig);
+    CScript watched = GetScriptForDestination(otherPubkey.GetID());
+    wallet.AddCScript(p2wpkh);
+    wallet.AddCScript(multisig);
+    wallet.AddCScript(p2wsh);
+    wallet.AddWatchOnly(watched, 0);
+
+    CWalletScanFilter filter(wallet);
+    BOOST_CHECK(filter.IsRelevant(CTxOut(COIN, p2pkh)));
+    BOOST_CHECK(filter.IsRelevant(CTxOut(COIN, GetScriptForRawPubKey(pubkey))));
+    BOOST_CHECK(filter.IsRelevant(CTxOut(COIN, p2wpkh)));
+    BOOST_CHECK(filter.IsRelevant(CTxOut(COIN, GetScriptForDestination(CScriptID(p2wpkh)))));
+    BOOST_CHECK(filter.IsRelevant(CTxOut(COIN, multisig)));
+    BOOST_CHECK(filter.IsRelevant(CTxOut(COIN, GetScriptForDestination(CScriptID(multisig)))));
+    BOOST_CHECK(filter.IsRelevant(CTxOut(COIN, p2wsh)));
+    BOOST_CHECK(filter.IsRelevant(CTxOut(COIN, watched)));
+
+    BOOST_CHECK(!filter.IsRelevant(CTxOut(COIN, GetScriptForRawPubKey(otherPubkey))));
+    BOOST_CHECK(!filter.IsRelevant(CTxOut(COIN, CScript() << OP_0 << ToByteVector(otherPubkey.GetID()))));
+    BOOST_CHECK(!filter.IsRelevant(CTxOut(COIN, GetScriptForDestination(CScriptID(watched)))));
+    BOOST_CHECK(!filter.IsRelevant(CTxOut(0, CScript() << OP_RETURN << ToByteVector(pubkey))));
+}
+
 // Check that GetImmatureCredit() returns a newly calculated value instead of
 // the cached value after a MarkDirty() call.
 //
@@ -451,6 +506,54 @@ BOOST_FIXTURE_TEST_CASE(coin_mark_dirty_immature_credit, TestChain100Setup)
     BOOST_CHECK_EQUAL(wtx.GetImmatureCredit(), 50*COIN);
 }
 
+// Check that balances and available coins, which are served from the wallet's
+// index of unspent outputs and its balance cache, follow chain tip changes and
+// outputs getting spent and unspent again.
+BOOST_FIXTURE_TEST_CASE(wallet_utxo_index_balances, TestChain100Setup)
+{
+    CWallet wallet;
+    LOCK2(cs_main, wallet.cs_wallet);
+    wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+    wallet.ScanForWalletTransactions(chainActive.Genesis());
+
+    // All 100 coinbase outputs are still immature.
+    std::vector<COutput> coins;
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 0);
+    BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), 100 * 50 * COIN);
+    wallet.AvailableCoins(coins);
+    BOOST_CHECK(coins.empty());
+
+    // A new tip makes the first coinbase mature, without the wallet being
+    // told about the block.
+    CKey key;
+    key.MakeNewKey(true);
+    CreateAndProcessBlock({}, GetScriptForRawPubKey(key.GetPubKey()));
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 50 * COIN);
+    BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), 99 * 50 * COIN);
+    wallet.AvailableCoins(coins);
+    BOOST_REQUIRE_EQUAL(coins.size(), 1);
+    BOOST_CHECK(coins[0].tx->GetHash() == coinbaseTxns[0].GetHash());
+
+    // Spending it removes it from the balance and the available coins...
+    CMutableTransaction spend;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 49 * COIN;
+    spend.vout[0].scriptPubKey = GetScriptForRawPubKey(key.GetPubKey());
+    const CTransaction spendTx(spend);
+    wallet.SyncTransaction(spendTx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 0);
+    wallet.AvailableCoins(coins);
+    BOOST_CHECK(coins.empty());
+
+    // ...and abandoning the spend brings it back.
+    BOOST_CHECK(wallet.AbandonTransaction(spendTx.GetHash()));
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 50 * COIN);
+    wallet.AvailableCoins(coins);
+    BOOST_CHECK_EQUAL(coins.size(), 1);
+}
+
 static int64_t AddTx(CWallet& wallet, uint32_t lockTime, int64_t mockTime, int64_t blockTime)
 {
     CMutableTransaction tx;
@@ -458,12 +561,8 @@ static int64_t AddTx(CWallet& wallet, uint32_t lockTime, int64_t mockTime, int64
     SetMockTime(mockTime);
     CBlockIndex* block = nullptr;
     if (blockTime > 0) {
-        auto inserted = mapBlockIndex.emplace(GetRandHash(), new CBlockIndex);
-        assert(inserted.second);
-        const uint256& hash = inserted.first->first;
-        block = inserted.first->second;
+        block = InsertBlockIndex(GetRandHash());
         block->nTime = blockTime;
-        block->phashBlock = &hash;
     }
 
     CWalletTx wtx(&wallet, MakeTransactionRef(tx));
@@ -8,9 +8,11 @@
 #include "base58.h"
 #include "checkpoints.h"
 #include "chain.h"
+#include "checkqueue.h"
 #include "wallet/coincontrol.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "crypto/ripemd160.h"
 #include "key.h"
 #include "keystore.h"
 #include "validation.h"
@@ -445,6 +447,10 @@ bool CWallet::Verify()
     uiInterface.InitMessage(_("Verifying wallet..."));
     std::string walletFile = GetArg("-wallet", DEFAULT_WALLET_DAT);
 
+    std::string strBackend = GetArg("-walletbackend", DEFAULT_WALLET_BACKEND);
+    if (strBackend != "bdb" && strBackend != "log")
+        return InitError(strprintf(_("Unknown wallet storage engine: %s"), strBackend));
+
     std::string strError;
     if (!CWalletDB::VerifyEnvironment(walletFile, GetDataDir().string(), strError))
         return InitError(strError);
@@ -466,6 +472,13 @@ bool CWallet::Verify()
         InitError(strError);
         return false;
     }
+
+    if (GetBoolArg("-migratewallet", false))
+    {
+        uiInterface.InitMessage(_("Converting wallet..."));
+        if (!CDB::Migrate(walletFile, strBackend))
+            return InitError(strprintf(_("Error converting %s to the %s storage engine"), walletFile, strBackend));
+    }
     return true;
 }
 
@@ -820,6 +833,12 @@ void CWallet::MarkDirty()
     }
 }
 
+void CWallet::MarkTxDirty(const uint256& hash) const
+{
+    setWalletUTXOTxs.insert(hash);
+    fBalancesCached = false;
+}
+
 bool CWallet::MarkReplaced(const uint256& originalHash, const uint256& newHash)
 {
     LOCK(cs_wallet);
@@ -1125,6 +1144,15 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex,
     }
 }
 
+void CWallet::TransactionRemovedFromMempool(const std::shared_ptr<const CTransaction> &ptx, MemPoolRemovalReason reason)
+{
+    LOCK(cs_wallet);
+    // Unconfirmed transactions only count towards the balance while they are
+    // in the mempool; evictions and expiries are not reported through
+    // SyncTransaction.
+    if (mapWallet.count(ptx->GetHash()))
+        fBalancesCached = false;
+}
 
 isminetype CWallet::IsMine(const CTxIn &txin) const
 {
@@ -1468,11 +1496,124 @@ void CWalletTx::GetAccountAmounts(const std::string& strAccount, CAmount& nRecei
     }
 }
 
+CWalletScanFilter::CWalletScanFilter(const CWallet& wallet)
+{
+    wallet.GetKeys(setKeyIDs);
+    LOCK(wallet.cs_KeyStore);
+    for (const auto& entry : wallet.mapScripts)
+        setScriptIDs.insert(entry.first);
+    setWatchOnly = wallet.setWatchOnly;
+}
+
+bool CWalletScanFilter::IsRelevant(const CTxOut& txout) const
+{
+    const CScript& scriptPubKey = txout.scriptPubKey;
+    if (!setWatchOnly.empty() && setWatchOnly.count(scriptPubKey))
+        return true;
+
+    // Fast paths for the two most common templates, saving the Solver() call
+    if (scriptPubKey.size() == 25 && scriptPubKey[0] == OP_DUP && scriptPubKey[1] == OP_HASH160 && scriptPubKey[2] == 20 &&
+        scriptPubKey[23] == OP_EQUALVERIFY && scriptPubKey[24] == OP_CHECKSIG) {
+        return setKeyIDs.count(CKeyID(uint160(std::vector<unsigned char>(scriptPubKey.begin() + 3, scriptPubKey.begin() + 23)))) > 0;
+    }
+    if (scriptPubKey.IsPayToScriptHash()) {
+        return setScriptIDs.count(CScriptID(uint160(std::vector<unsigned char>(scriptPubKey.begin() + 2, scriptPubKey.begin() + 22)))) > 0;
+    }
+
+    std::vector<std::vector<unsigned char> > vSolutions;
+    txnouttype whichType;
+    if (!Solver(scriptPubKey, whichType, vSolutions))
+        return false;
+
+    switch (whichType)
+    {
+    case TX_PUBKEY:
+        return setKeyIDs.count(CPubKey(vSolutions[0]).GetID()) > 0;
+    case TX_PUBKEYHASH:
+    case TX_WITNESS_V0_KEYHASH:
+        return setKeyIDs.count(CKeyID(uint160(vSolutions[0]))) > 0;
+    case TX_SCRIPTHASH:
+        return setScriptIDs.count(CScriptID(uint160(vSolutions[0]))) > 0;
+    case TX_WITNESS_V0_SCRIPTHASH:
+    {
+        uint160 hash;
+        CRIPEMD160().Write(&vSolutions[0][0], vSolutions[0].size()).Finalize(hash.begin());
+        return setScriptIDs.count(CScriptID(hash)) > 0;
+    }
+    case TX_MULTISIG:
+        for (size_t i = 1; i + 1 < vSolutions.size(); i++) {
+            if (setKeyIDs.count(CPubKey(vSolutions[i]).GetID()))
+                return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+namespace {
+
+/** A block read by a rescan, and which of its transactions have outputs that may be ours */
+struct CWalletScanBlock
+{
+    bool fRead;
+    CBlock block;
+    std::vector<bool> vRelevant;
+
+    CWalletScanBlock() : fRead(false) {}
+};
+
+/**
+ * Closure representing reading and filtering one block of a rescan, so that
+ * it can be done by a CCheckQueue worker.
+ */
+class CWalletScanCheck
+{
+private:
+    const CBlockIndex* pindex;
+    const CWalletScanFilter* pfilter;
+    CWalletScanBlock* pscan;
+
+public:
+    CWalletScanCheck() : pindex(NULL), pfilter(NULL), pscan(NULL) {}
+    CWalletScanCheck(const CBlockIndex* pindexIn, const CWalletScanFilter* pfilterIn, CWalletScanBlock* pscanIn) :
+        pindex(pindexIn), pfilter(pfilterIn), pscan(pscanIn) {}
+
+    bool operator()()
+    {
+        CWalletScanBlock& scan = *pscan;
+        scan.fRead = ReadBlockFromDisk(scan.block, pindex, Params().GetConsensus());
+        scan.vRelevant.assign(scan.block.vtx.size(), false);
+        for (size_t i = 0; i < scan.block.vtx.size(); i++) {
+            for (const CTxOut& txout : scan.block.vtx[i]->vout) {
+                if (pfilter->IsRelevant(txout)) {
+                    scan.vRelevant[i] = true;
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    void swap(CWalletScanCheck& check)
+    {
+        std::swap(pindex, check.pindex);
+        std::swap(pfilter, check.pfilter);
+        std::swap(pscan, check.pscan);
+    }
+};
+
+} // anon namespace
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
  *
+ * Blocks are read and matched against a snapshot of the wallet's keys and
+ * scripts by -rescanthreads threads, one batch ahead of the transactions
+ * being added to the wallet, which still happens here in chain order.
+ *
  * Returns pointer to the first block in the last contiguous range that was
  * successfully scanned.
  *
@@ -1483,6 +1624,12 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool f
     int64_t nNow = GetTime();
     const CChainParams& chainParams = Params();
 
+    int nThreads = GetArg("-rescanthreads", DEFAULT_RESCAN_THREADS);
+    if (nThreads <= 0)
+        nThreads += GetNumCores();
+    nThreads = std::max(1, std::min(nThreads, MAX_RESCAN_THREADS));
+    const size_t nBatchSize = nThreads > 1 ? 2 * nThreads : 1;
+
     CBlockIndex* pindex = pindexStart;
     {
         LOCK2(cs_main, cs_wallet);
@@ -1492,36 +1639,127 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool f
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - TIMESTAMP_WINDOW)))
             pindex = chainActive.Next(pindex);
 
+        fScanningWallet = true;
+        nScanStartTime = GetTimeMillis();
+        nScanEndTime = 0;
+        dScanProgress = 0;
+        nScanHeight = pindex ? pindex->nHeight : -1;
+        nScanBlocks = 0;
+
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
         double dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
         double dProgressTip = GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
-        while (pindex)
-        {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((GuessVerificationProgress(chainParams.TxData(), pindex) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
 
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
-                for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                    AddToWalletIfInvolvingMe(*block.vtx[posInBlock], pindex, posInBlock, fUpdate);
-                }
-                if (!ret) {
-                    ret = pindex;
-                }
+        // A transaction without outputs of ours is still of interest if it
+        // is already known, spends from the wallet or conflicts with a wallet
+        // transaction.
+        auto involvesWallet = [this](const CTransaction& tx) {
+            if (mapWallet.count(tx.GetHash()))
+                return true;
+            for (const CTxIn& txin : tx.vin) {
+                if (mapWallet.count(txin.prevout.hash) || mapTxSpends.count(txin.prevout))
+                    return true;
+            }
+            return false;
+        };
+
+        const CWalletScanFilter filter(*this);
+        CCheckQueue<CWalletScanCheck> queue(1);
+        boost::thread_group threadGroup;
+        for (int i = 1; i < nThreads; i++)
+            threadGroup.create_thread(boost::bind(&CCheckQueue<CWalletScanCheck>::Thread, &queue));
+
+        std::vector<CBlockIndex*> vBatch[2];
+        std::vector<CWalletScanBlock> vScan[2];
+        // Queue the batch of blocks following pindexPrev (or starting at
+        // pindexFirst) for reading into slot n.
+        auto fetchBatch = [&](CBlockIndex* pindexFirst, int n, CCheckQueueControl<CWalletScanCheck>& control) {
+            vBatch[n].clear();
+            for (CBlockIndex* pindexBatch = pindexFirst; pindexBatch && vBatch[n].size() < nBatchSize; pindexBatch = chainActive.Next(pindexBatch))
+                vBatch[n].push_back(pindexBatch);
+            vScan[n].resize(vBatch[n].size());
+            std::vector<CWalletScanCheck> vChecks;
+            vChecks.reserve(vBatch[n].size());
+            for (size_t i = 0; i < vBatch[n].size(); i++)
+                vChecks.push_back(CWalletScanCheck(vBatch[n][i], &filter, &vScan[n][i]));
+            if (nThreads > 1) {
+                control.Add(vChecks);
             } else {
-                ret = nullptr;
+                for (CWalletScanCheck& check : vChecks)
+                    check();
             }
-            pindex = chainActive.Next(pindex);
-            if (GetTime() >= nNow + 60) {
-                nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
+        };
+
+        try {
+            int nCurrent = 0;
+            {
+                CCheckQueueControl<CWalletScanCheck> control(nThreads > 1 ? &queue : NULL);
+                fetchBatch(pindex, nCurrent, control);
             }
+            while (!vBatch[nCurrent].empty())
+            {
+                // Read the next batch while this one is added to the wallet
+                CCheckQueueControl<CWalletScanCheck> control(nThreads > 1 ? &queue : NULL);
+                fetchBatch(chainActive.Next(vBatch[nCurrent].back()), nCurrent ^ 1, control);
+
+                for (size_t i = 0; i < vBatch[nCurrent].size(); i++)
+                {
+                    pindex = vBatch[nCurrent][i];
+                    CWalletScanBlock& scan = vScan[nCurrent][i];
+                    if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+                        ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((GuessVerificationProgress(chainParams.TxData(), pindex) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+
+                    if (scan.fRead) {
+                        for (size_t posInBlock = 0; posInBlock < scan.block.vtx.size(); ++posInBlock) {
+                            const CTransaction& tx = *scan.block.vtx[posInBlock];
+                            if (scan.vRelevant[posInBlock] || involvesWallet(tx))
+                                AddToWalletIfInvolvingMe(tx, pindex, posInBlock, fUpdate);
+                        }
+                        if (!ret) {
+                            ret = pindex;
+                        }
+                    } else {
+                        ret = nullptr;
+                    }
+                    scan.block.SetNull();
+
+                    nScanBlocks++;
+                    nScanHeight = pindex->nHeight;
+                    if (dProgressTip - dProgressStart > 0.0)
+                        dScanProgress = std::max(0.0, std::min(1.0, (GuessVerificationProgress(chainParams.TxData(), pindex) - dProgressStart) / (dProgressTip - dProgressStart)));
+                    if (GetTime() >= nNow + 60) {
+                        nNow = GetTime();
+                        LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
+                    }
+                }
+
+                control.Wait();
+                nCurrent ^= 1;
+            }
+        } catch (...) {
+            threadGroup.interrupt_all();
+            threadGroup.join_all();
+            fScanningWallet = false;
+            throw;
         }
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+
+        dScanProgress = 1.0;
+        nScanEndTime = GetTimeMillis();
+        fScanningWallet = false;
         ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     }
     return ret;
 }
 
+int64_t CWallet::ScanningDuration() const
+{
+    if (!nScanStartTime)
+        return 0;
+    return (fScanningWallet ? GetTimeMillis() : (int64_t)nScanEndTime) - nScanStartTime;
+}
+
 void CWallet::ReacceptWalletTransactions()
 {
     // If transactions aren't being broadcasted, don't let them into local mempool either
@@ -1589,6 +1827,21 @@ std::set<uint256> CWalletTx::GetConflicts() const
     return result;
 }
 
+void CWalletTx::MarkDirty()
+{
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fImmatureCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+    if (pwallet)
+        pwallet->MarkTxDirty(GetHash());
+}
+
 CAmount CWalletTx::GetDebit(const isminefilter& filter) const
 {
     if (tx->vin.empty())
@@ -1856,94 +2109,88 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman
  */
 
 
-CAmount CWallet::GetBalance() const
+bool CWallet::HasUnspentOutputs(const CWalletTx& wtx) const
 {
-    CAmount nTotal = 0;
+    const uint256& hash = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        if (IsMine(wtx.tx->vout[i]) != ISMINE_NO && !IsSpent(hash, i))
+            return true;
+    }
+    return false;
+}
+
+const CWallet::CWalletBalances& CWallet::GetBalances() const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    // Depth, maturity and finality of every wallet transaction depend on the tip
+    const uint256 hashTip = chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256();
+    if (fBalancesCached && hashBalancesTip == hashTip)
+        return cachedBalances;
+
+    CWalletBalances balances = {};
+    std::set<uint256>::iterator it = setWalletUTXOTxs.begin();
+    while (it != setWalletUTXOTxs.end())
     {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+        std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(*it);
+        if (mit == mapWallet.end() || !HasUnspentOutputs(mit->second)) {
+            setWalletUTXOTxs.erase(it++);
+            continue;
         }
+        const CWalletTx* pcoin = &(*mit).second;
+        if (pcoin->IsTrusted()) {
+            balances.nTrusted += pcoin->GetAvailableCredit();
+            balances.nWatchTrusted += pcoin->GetAvailableWatchOnlyCredit();
+        } else if (pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool()) {
+            balances.nUntrustedPending += pcoin->GetAvailableCredit();
+            balances.nWatchUntrustedPending += pcoin->GetAvailableWatchOnlyCredit();
+        }
+        balances.nImmature += pcoin->GetImmatureCredit();
+        balances.nWatchImmature += pcoin->GetImmatureWatchOnlyCredit();
+        ++it;
     }
 
-    return nTotal;
+    cachedBalances = balances;
+    hashBalancesTip = hashTip;
+    fBalancesCached = true;
+    return cachedBalances;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nTrusted;
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nUntrustedPending;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nWatchTrusted;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nWatchUntrustedPending;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nWatchImmature;
 }
 
 void CWallet::AvailableCoins(std::vector<COutput>& vCoins, bool fOnlySafe, const CCoinControl *coinControl, bool fIncludeZeroValue) const
@@ -1952,8 +2199,16 @@ void CWallet::AvailableCoins(std::vector<COutput>& vCoins, bool fOnlySafe, const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        std::set<uint256>::iterator utxoit = setWalletUTXOTxs.begin();
+        while (utxoit != setWalletUTXOTxs.end())
         {
+            std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(*utxoit);
+            if (it == mapWallet.end() || !HasUnspentOutputs(it->second)) {
+                setWalletUTXOTxs.erase(utxoit++);
+                continue;
+            }
+            ++utxoit;
+
             const uint256& wtxid = it->first;
             const CWalletTx* pcoin = &(*it).second;
 
@@ -3523,6 +3778,9 @@ std::string CWallet::GetWalletHelpString(bool showDebug)
     strUsage += HelpMessageOpt("-paytxfee=<amt>", strprintf(_("Fee (in %s/kB) to add to transactions you send (default: %s)"),
                                                             CURRENCY_UNIT, FormatMoney(payTxFee.GetFeePerK())));
     strUsage += HelpMessageOpt("-rescan", _("Rescan the block chain for missing wallet transactions on startup"));
+    strUsage += HelpMessageOpt("-rescanthreads=<n>", strprintf(_("Set the number of threads reading blocks during rescans (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
+        -GetNumCores(), MAX_RESCAN_THREADS, DEFAULT_RESCAN_THREADS));
+    strUsage += HelpMessageOpt("-migratewallet", _("Convert the wallet file to the -walletbackend storage engine on startup, keeping the original as a backup"));
     strUsage += HelpMessageOpt("-salvagewallet", _("Attempt to recover private keys from a corrupt wallet on startup"));
     strUsage += HelpMessageOpt("-spendzeroconfchange", strprintf(_("Spend unconfirmed change when sending transactions (default: %u)"), DEFAULT_SPEND_ZEROCONF_CHANGE));
     strUsage += HelpMessageOpt("-txconfirmtarget=<n>", strprintf(_("If paytxfee is not set, include enough fee so transactions begin confirmation on average within n blocks (default: %u)"), DEFAULT_TX_CONFIRM_TARGET));
@@ -3530,6 +3788,7 @@ std::string CWallet::GetWalletHelpString(bool showDebug)
     strUsage += HelpMessageOpt("-walletrbf", strprintf(_("Send transactions with full-RBF opt-in enabled (default: %u)"), DEFAULT_WALLET_RBF));
     strUsage += HelpMessageOpt("-upgradewallet", _("Upgrade wallet to latest format on startup"));
     strUsage += HelpMessageOpt("-wallet=<file>", _("Specify wallet file (within data directory)") + " " + strprintf(_("(default: %s)"), DEFAULT_WALLET_DAT));
+    strUsage += HelpMessageOpt("-walletbackend=<engine>", strprintf(_("Storage engine for new wallet files and -migratewallet: bdb (Berkeley DB) or log (append-only log) (default: %s)"), DEFAULT_WALLET_BACKEND));
     strUsage += HelpMessageOpt("-walletbroadcast", _("Make the wallet broadcast transactions") + " " + strprintf(_("(default: %u)"), DEFAULT_WALLETBROADCAST));
     strUsage += HelpMessageOpt("-walletnotify=<cmd>", _("Execute command when a wallet transaction changes (%s in cmd is replaced by TxID)"));
     strUsage += HelpMessageOpt("-zapwallettxes=<mode>", _("Delete all wallet transactions and only recover those parts of the blockchain through -rescan on startup") +
@@ -65,6 +65,10 @@ static const bool DEFAULT_WALLETBROADCAST = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
 //! if set, all keys will be derived by using BIP32
 static const bool DEFAULT_USE_HD_WALLET = true;
+//! -rescanthreads default (0 = auto)
+static const int DEFAULT_RESCAN_THREADS = 0;
+//! Maximum number of block reading threads used by a rescan
+static const int MAX_RESCAN_THREADS = 16;
 
 extern const char * DEFAULT_WALLET_DAT;
 
@@ -404,18 +408,7 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fImmatureCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    void MarkDirty();
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -608,8 +601,22 @@ private:
 class CWallet : public CCryptoKeyStore, public CValidationInterface
 {
 private:
+    friend class CWalletScanFilter;
+
     static std::atomic<bool> fFlushScheduled;
 
+    /**
+     * State of the current (or last) ScanForWalletTransactions call. Updated
+     * by the scanning thread and readable without cs_wallet, which the
+     * caller of a rescan usually holds until it is done.
+     */
+    std::atomic<bool> fScanningWallet;
+    std::atomic<int64_t> nScanStartTime;
+    std::atomic<int64_t> nScanEndTime;
+    std::atomic<double> dScanProgress;
+    std::atomic<int> nScanHeight;
+    std::atomic<int64_t> nScanBlocks;
+
     /**
      * Select a set of coins such that nValueRet >= nTargetValue and at least
      * all coins from coinControl are selected; Never select unconfirmed coins
@@ -644,6 +651,40 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /**
+     * Wallet transactions which may still hold unspent outputs of ours: a
+     * superset of the wallet's UTXO set, grouped by transaction. Balance
+     * queries and coin selection only visit these instead of all of mapWallet.
+     * Transactions found to be fully spent are dropped lazily; anything that
+     * can make one of their outputs unspent again marks the transaction dirty,
+     * which puts it back (see MarkTxDirty).
+     */
+    mutable std::set<uint256> setWalletUTXOTxs;
+
+    /** Wallet balances by confirmation state, as returned by GetBalance() and friends */
+    struct CWalletBalances
+    {
+        CAmount nTrusted;
+        CAmount nUntrustedPending;
+        CAmount nImmature;
+        CAmount nWatchTrusted;
+        CAmount nWatchUntrustedPending;
+        CAmount nWatchImmature;
+    };
+
+    /**
+     * Cached balances, valid until a wallet transaction is marked dirty, a
+     * wallet transaction leaves the mempool or the chain tip changes.
+     */
+    mutable CWalletBalances cachedBalances;
+    mutable bool fBalancesCached;
+    mutable uint256 hashBalancesTip;
+
+    /** Whether wtx has an output of ours which is not spent */
+    bool HasUnspentOutputs(const CWalletTx& wtx) const;
+    /** Compute (or return the cached) balances; requires cs_main and cs_wallet */
+    const CWalletBalances& GetBalances() const;
+
     /* the HD chain data model (external chain counters) */
     CHDChain hdChain;
 
@@ -726,6 +767,13 @@ public:
         nTimeFirstKey = 0;
         fBroadcastTransactions = false;
         nRelockTime = 0;
+        fBalancesCached = false;
+        fScanningWallet = false;
+        nScanStartTime = 0;
+        nScanEndTime = 0;
+        dScanProgress = 0;
+        nScanHeight = -1;
+        nScanBlocks = 0;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -828,11 +876,25 @@ public:
     bool GetAccountPubkey(CPubKey &pubKey, std::string strAccount, bool bForceNew = false);
 
     void MarkDirty();
+    /**
+     * Called by CWalletTx::MarkDirty: the spent state or credit of a wallet
+     * transaction may have changed, so reconsider it for the UTXO index and
+     * drop the cached balances.
+     */
+    void MarkTxDirty(const uint256& hash) const;
     bool AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose=true);
     bool LoadToWallet(const CWalletTx& wtxIn);
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock) override;
+    void TransactionRemovedFromMempool(const std::shared_ptr<const CTransaction> &ptx, MemPoolRemovalReason reason) override;
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlockIndex* pIndex, int posInBlock, bool fUpdate);
     CBlockIndex* ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    //! Whether a rescan is running; the Scanning* accessors below describe it, or the last one if none is.
+    bool IsScanning() const { return fScanningWallet; }
+    //! Time spent by the rescan so far, in milliseconds
+    int64_t ScanningDuration() const;
+    double ScanningProgress() const { return dScanProgress; }
+    int ScanningHeight() const { return nScanHeight; }
+    int64_t ScanningBlocks() const { return nScanBlocks; }
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman) override;
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime, CConnman* connman);
@@ -1039,6 +1101,27 @@ public:
     bool SetHDMasterKey(const CPubKey& key);
 };
 
+/**
+ * Read-only snapshot of the keys, scripts and watch-only scripts of a wallet,
+ * used by rescans to find the transactions worth handing to
+ * AddToWalletIfInvolvingMe without holding cs_wallet. It may match outputs
+ * IsMine() does not consider ours (e.g. partially owned multisig), but never
+ * misses one that IsMine() does.
+ */
+class CWalletScanFilter
+{
+private:
+    std::set<CKeyID> setKeyIDs;
+    std::set<CScriptID> setScriptIDs;
+    std::set<CScript> setWatchOnly;
+
+public:
+    explicit CWalletScanFilter(const CWallet& wallet);
+
+    //! Whether txout may pay to the wallet
+    bool IsRelevant(const CTxOut& txout) const;
+};
+
 /** A key allocated from the key pool. */
 class CReserveKey : public CReserveScript
 {
@@ -9,6 +9,8 @@
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
+class CZMQSpillBuffer;
+enum class MemPoolRemovalReason;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
@@ -32,8 +34,15 @@ public:
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
+    /** Spill buffer retaining the recently published messages, if any */
+    virtual CZMQSpillBuffer* GetSpillBuffer() { return NULL; }
+
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    virtual bool NotifyBlockConnect(const CBlockIndex *pindex);
+    virtual bool NotifyBlockDisconnect(const CBlock &block);
+    virtual bool NotifyTransactionAcceptance(const CTransaction &transaction);
+    virtual bool NotifyTransactionRemoval(const CTransaction &transaction, MemPoolRemovalReason reason);
 
 protected:
     void *psocket;
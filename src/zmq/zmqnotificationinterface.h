@@ -11,6 +11,7 @@
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
+class CZMQSpillBuffer;
 
 class CZMQNotificationInterface : public CValidationInterface
 {
@@ -19,6 +20,9 @@ public:
 
     static CZMQNotificationInterface* Create();
 
+    /** The spill buffer of the first notifier that keeps one, or NULL */
+    CZMQSpillBuffer* GetSpillBuffer();
+
 protected:
     bool Initialize();
     void Shutdown();
@@ -26,6 +30,10 @@ protected:
     // CValidationInterface
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock);
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
+    void TransactionAddedToMempool(const std::shared_ptr<const CTransaction> &ptx);
+    void TransactionRemovedFromMempool(const std::shared_ptr<const CTransaction> &ptx, MemPoolRemovalReason reason);
+    void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex);
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &block);
 
 private:
     CZMQNotificationInterface();
@@ -34,4 +42,6 @@ private:
     std::list<CZMQAbstractNotifier*> notifiers;
 };
 
+extern CZMQNotificationInterface* g_zmq_notification_interface;
+
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
@@ -4,6 +4,7 @@
 
 #include "chainparams.h"
 #include "streams.h"
+#include "txmempool.h"
 #include "zmqpublishnotifier.h"
 #include "validation.h"
 #include "util.h"
@@ -15,6 +16,13 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_SEQUENCE  = "sequence";
+
+// Labels of the events published on the sequence topic
+static const char SEQUENCE_BLOCK_CONNECT    = 'C';
+static const char SEQUENCE_BLOCK_DISCONNECT = 'D';
+static const char SEQUENCE_TX_ACCEPTANCE    = 'A';
+static const char SEQUENCE_TX_REMOVAL       = 'R';
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -75,7 +83,16 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
             return false;
         }
 
-        int rc = zmq_bind(psocket, address.c_str());
+        int hwm = GetArg("-zmqpubhwm", DEFAULT_ZMQ_SNDHWM);
+        int rc = zmq_setsockopt(psocket, ZMQ_SNDHWM, &hwm, sizeof(hwm));
+        if (rc!=0)
+        {
+            zmqError("Failed to set outbound message high water mark");
+            zmq_close(psocket);
+            return false;
+        }
+
+        rc = zmq_bind(psocket, address.c_str());
         if (rc!=0)
         {
             zmqError("Failed to bind address");
@@ -132,6 +149,9 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
 {
     assert(psocket);
 
+    if (spill)
+        spill->Append(nSequence, command, data, size);
+
     /* send three parts, command & data & a LE 4byte sequence number */
     unsigned char msgseq[sizeof(uint32_t)];
     WriteLE32(&msgseq[0], nSequence);
@@ -170,7 +190,7 @@ bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
     const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    CPlainDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
     {
         LOCK(cs_main);
         CBlock block;
@@ -190,7 +210,60 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish rawtx %s\n", hash.GetHex());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    CPlainDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishSequenceNotifier::Initialize(void *pcontext)
+{
+    uint64_t nSpillSize = GetArg("-zmqspillsize", DEFAULT_ZMQ_SPILL_SIZE) * 1024 * 1024;
+    if (nSpillSize > 0)
+        spill.reset(new CZMQSpillBuffer(GetDataDir() / "zmq", MSG_SEQUENCE, nSpillSize));
+    return CZMQAbstractPublishNotifier::Initialize(pcontext);
+}
+
+/* body: 32 byte hash, 1 byte event label, optional event specific payload */
+static bool SendSequenceMessage(CZMQAbstractPublishNotifier& notifier, const uint256& hash, char label, const unsigned char* payload = NULL, size_t payloadSize = 0)
+{
+    unsigned char data[32 + 1 + 1];
+    assert(payloadSize <= 1);
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    data[32] = label;
+    if (payloadSize)
+        memcpy(&data[33], payload, payloadSize);
+    return notifier.SendMessage(MSG_SEQUENCE, data, 33 + payloadSize);
+}
+
+bool CZMQPublishSequenceNotifier::NotifyBlockConnect(const CBlockIndex *pindex)
+{
+    uint256 hash = pindex->GetBlockHash();
+    LogPrint("zmq", "zmq: Publish sequence block connect %s\n", hash.GetHex());
+    return SendSequenceMessage(*this, hash, SEQUENCE_BLOCK_CONNECT);
+}
+
+bool CZMQPublishSequenceNotifier::NotifyBlockDisconnect(const CBlock &block)
+{
+    uint256 hash = block.GetHash();
+    LogPrint("zmq", "zmq: Publish sequence block disconnect %s\n", hash.GetHex());
+    return SendSequenceMessage(*this, hash, SEQUENCE_BLOCK_DISCONNECT);
+}
+
+bool CZMQPublishSequenceNotifier::NotifyTransactionAcceptance(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    LogPrint("zmq", "zmq: Publish sequence mempool acceptance %s\n", hash.GetHex());
+    return SendSequenceMessage(*this, hash, SEQUENCE_TX_ACCEPTANCE);
+}
+
+bool CZMQPublishSequenceNotifier::NotifyTransactionRemoval(const CTransaction &transaction, MemPoolRemovalReason reason)
+{
+    // Removals for block inclusion are implied by the block connect message.
+    if (reason == MemPoolRemovalReason::BLOCK)
+        return true;
+    uint256 hash = transaction.GetHash();
+    LogPrint("zmq", "zmq: Publish sequence mempool removal %s\n", hash.GetHex());
+    unsigned char payload = (unsigned char)reason;
+    return SendSequenceMessage(*this, hash, SEQUENCE_TX_REMOVAL, &payload, 1);
+}
@@ -6,14 +6,23 @@
 #define BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
 
 #include "zmqabstractnotifier.h"
+#include "zmqspillbuffer.h"
+
+#include <memory>
 
 class CBlockIndex;
 
+/** Default for -zmqpubhwm, the ZeroMQ default */
+static const int DEFAULT_ZMQ_SNDHWM = 1000;
+
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
     uint32_t nSequence; //!< upcounting per message sequence number
 
+protected:
+    std::unique_ptr<CZMQSpillBuffer> spill; //!< optional on-disk copy of published messages
+
 public:
 
     /* send zmq multipart message
@@ -21,11 +30,14 @@ public:
           * command
           * data
           * message sequence number
+       and record it in the spill buffer, if one is attached
     */
     bool SendMessage(const char *command, const void* data, size_t size);
 
     bool Initialize(void *pcontext);
     void Shutdown();
+
+    CZMQSpillBuffer* GetSpillBuffer() { return spill.get(); }
 };
 
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
@@ -52,4 +64,18 @@ public:
     bool NotifyTransaction(const CTransaction &transaction);
 };
 
+/**
+ * Publishes block connect/disconnect and mempool acceptance/removal events
+ * on a single topic, so subscribers see them in the order they happened.
+ */
+class CZMQPublishSequenceNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool Initialize(void *pcontext);
+    bool NotifyBlockConnect(const CBlockIndex *pindex);
+    bool NotifyBlockDisconnect(const CBlock &block);
+    bool NotifyTransactionAcceptance(const CTransaction &transaction);
+    bool NotifyTransactionRemoval(const CTransaction &transaction, MemPoolRemovalReason reason);
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
@@ -0,0 +1,79 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zmq/zmqrpc.h"
+
+#include "rpc/server.h"
+#include "utilstrencodings.h"
+#include "zmq/zmqnotificationinterface.h"
+#include "zmq/zmqspillbuffer.h"
+
+#include <univalue.h>
+
+UniValue getzmqspill(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "getzmqspill from_sequence\n"
+            "\nReturns the ZMQ notifications retained in the spill buffer (see -zmqspillsize),\n"
+            "starting at the given sequence number. Subscribers that detect a gap in the\n"
+            "sequence numbers of the \"sequence\" topic can use this to resynchronize.\n"
+            "\nArguments:\n"
+            "1. from_sequence    (numeric, required) The sequence number of the first message to return\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"oldest\": n,           (numeric) The sequence number of the oldest retained message\n"
+            "  \"complete\": true|false, (boolean) Whether all messages since from_sequence were retained\n"
+            "  \"messages\": [          (array of json objects)\n"
+            "    {\n"
+            "      \"sequence\": n,     (numeric) The message sequence number\n"
+            "      \"topic\": \"topic\",  (string) The message topic\n"
+            "      \"body\": \"hex\"      (string) The message body\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getzmqspill", "1000")
+            + HelpExampleRpc("getzmqspill", "1000")
+        );
+
+    int64_t nFrom = request.params[0].get_int64();
+    if (nFrom < 0 || nFrom > std::numeric_limits<uint32_t>::max())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "from_sequence out of range");
+
+    CZMQSpillBuffer* spill = g_zmq_notification_interface ? g_zmq_notification_interface->GetSpillBuffer() : NULL;
+    if (!spill)
+        throw JSONRPCError(RPC_MISC_ERROR, "No ZMQ spill buffer (requires -zmqpubsequence and -zmqspillsize > 0)");
+
+    std::vector<CZMQSpillEntry> entries;
+    uint32_t nOldest;
+    bool fComplete = spill->Read((uint32_t)nFrom, entries, nOldest);
+
+    UniValue messages(UniValue::VARR);
+    for (const CZMQSpillEntry& entry : entries) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("sequence", (int64_t)entry.nSequence));
+        obj.push_back(Pair("topic", entry.command));
+        obj.push_back(Pair("body", HexStr(entry.data)));
+        messages.push_back(obj);
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("oldest", (int64_t)nOldest));
+    result.push_back(Pair("complete", fComplete));
+    result.push_back(Pair("messages", messages));
+    return result;
+}
+
+static const CRPCCommand commands[] =
+{ //  category              name                      actor (function)         okSafeMode
+  //  --------------------- ------------------------  -----------------------  ----------
+    { "zmq",                "getzmqspill",            &getzmqspill,            true,  {"from_sequence"} },
+};
+
+void RegisterZMQRPCCommands(CRPCTable& t)
+{
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
+        t.appendCommand(commands[vcidx].name, &commands[vcidx]);
+}
@@ -0,0 +1,117 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zmqspillbuffer.h"
+
+#include "clientversion.h"
+#include "streams.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+
+CZMQSpillBuffer::CZMQSpillBuffer(const boost::filesystem::path& dir, const std::string& name, uint64_t nMaxSizeIn) :
+    pathCurrent(dir / (name + ".dat")), pathOld(dir / (name + ".old.dat")), nMaxSize(nMaxSizeIn),
+    nCurrentSize(0), file(NULL), fHaveEntries(false), nOldestSequence(0), nOldestCurrentSequence(0)
+{
+    TryCreateDirectory(dir);
+    boost::filesystem::remove(pathOld);
+    file = fopen(pathCurrent.string().c_str(), "wb");
+    if (!file)
+        LogPrintf("zmq: Unable to open spill buffer %s\n", pathCurrent.string());
+}
+
+CZMQSpillBuffer::~CZMQSpillBuffer()
+{
+    if (file)
+        fclose(file);
+}
+
+bool CZMQSpillBuffer::Rotate()
+{
+    fclose(file);
+    file = NULL;
+    if (!RenameOver(pathCurrent, pathOld)) {
+        LogPrintf("zmq: Unable to rotate spill buffer %s\n", pathCurrent.string());
+        return false;
+    }
+    file = fopen(pathCurrent.string().c_str(), "wb");
+    if (!file) {
+        LogPrintf("zmq: Unable to open spill buffer %s\n", pathCurrent.string());
+        return false;
+    }
+    nOldestSequence = nOldestCurrentSequence;
+    nCurrentSize = 0;
+    return true;
+}
+
+bool CZMQSpillBuffer::Append(uint32_t nSequence, const char *command, const void* data, size_t size)
+{
+    LOCK(cs);
+    if (!file)
+        return false;
+
+    CZMQSpillEntry entry;
+    entry.nSequence = nSequence;
+    entry.command = command;
+    entry.data.assign((const unsigned char*)data, (const unsigned char*)data + size);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << entry;
+    if (fwrite(ss.data(), 1, ss.size(), file) != ss.size() || fflush(file) != 0) {
+        LogPrintf("zmq: Unable to write to spill buffer %s\n", pathCurrent.string());
+        return false;
+    }
+
+    if (!fHaveEntries) {
+        nOldestSequence = nSequence;
+        fHaveEntries = true;
+    }
+    if (nCurrentSize == 0)
+        nOldestCurrentSequence = nSequence;
+    nCurrentSize += ss.size();
+
+    if (nCurrentSize > nMaxSize / 2)
+        return Rotate();
+    return true;
+}
+
+static void ReadSpillFile(const boost::filesystem::path& path, uint32_t nFrom, std::vector<CZMQSpillEntry>& entries)
+{
+    FILE *filein = fopen(path.string().c_str(), "rb");
+    if (!filein)
+        return;
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    char buf[65536];
+    size_t nRead;
+    while ((nRead = fread(buf, 1, sizeof(buf), filein)) > 0)
+        ss.write(buf, nRead);
+    fclose(filein);
+
+    try {
+        while (!ss.empty()) {
+            CZMQSpillEntry entry;
+            ss >> entry;
+            if (entry.nSequence >= nFrom)
+                entries.push_back(entry);
+        }
+    } catch (const std::exception& e) {
+        // A truncated trailing record is the result of a failed write; skip it.
+        LogPrint("zmq", "zmq: Ignoring truncated record in %s: %s\n", path.string(), e.what());
+    }
+}
+
+bool CZMQSpillBuffer::Read(uint32_t nFrom, std::vector<CZMQSpillEntry>& entries, uint32_t& nOldest)
+{
+    LOCK(cs);
+    entries.clear();
+    nOldest = nOldestSequence;
+    if (!fHaveEntries)
+        return true;
+    if (nFrom < nOldestSequence)
+        return false;
+
+    ReadSpillFile(pathOld, nFrom, entries);
+    ReadSpillFile(pathCurrent, nFrom, entries);
+    return true;
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ZMQ_ZMQSPILLBUFFER_H
+#define BITCOIN_ZMQ_ZMQSPILLBUFFER_H
+
+#include "serialize.h"
+#include "sync.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+/** Default for -zmqspillsize, in MiB */
+static const unsigned int DEFAULT_ZMQ_SPILL_SIZE = 16;
+
+/** A notification as it was handed to the ZMQ socket */
+struct CZMQSpillEntry
+{
+    uint32_t nSequence;
+    std::string command;
+    std::vector<unsigned char> data;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nSequence);
+        READWRITE(command);
+        READWRITE(data);
+    }
+};
+
+/**
+ * Bounded on-disk record of the most recently published notifications.
+ *
+ * PUB sockets silently drop messages once a subscriber reaches the high
+ * water mark, so subscribers that notice a gap in the sequence numbers can
+ * fetch the missed messages from here (see the getzmqspill RPC) instead of
+ * rebuilding their state from scratch.
+ *
+ * Entries are appended to <name>.dat; when that file grows beyond half of
+ * the size limit it is rotated to <name>.old.dat, replacing the previous
+ * one. The buffer thus never holds more than the limit on disk, while
+ * always retaining at least the last half of it. Sequence numbers restart
+ * at zero with each run, so the buffer is wiped on startup.
+ */
+class CZMQSpillBuffer
+{
+public:
+    CZMQSpillBuffer(const boost::filesystem::path& dir, const std::string& name, uint64_t nMaxSizeIn);
+    ~CZMQSpillBuffer();
+
+    bool Append(uint32_t nSequence, const char *command, const void* data, size_t size);
+
+    /**
+     * Collect all retained entries with a sequence number of at least nFrom.
+     * Returns false if nFrom is older than the oldest retained entry, in
+     * which case the caller cannot resynchronize from the buffer alone.
+     */
+    bool Read(uint32_t nFrom, std::vector<CZMQSpillEntry>& entries, uint32_t& nOldest);
+
+private:
+    CCriticalSection cs;
+    boost::filesystem::path pathCurrent;
+    boost::filesystem::path pathOld;
+    uint64_t nMaxSize;
+    uint64_t nCurrentSize;
+    FILE *file;
+    bool fHaveEntries;
+    uint32_t nOldestSequence;
+    uint32_t nOldestCurrentSequence;
+
+    bool Rotate();
+};
+
+#endif // BITCOIN_ZMQ_ZMQSPILLBUFFER_H
@@ -6,8 +6,12 @@
 
 Test the following RPCs:
     - gettxoutsetinfo
+    - getcoinscacheinfo
     - verifychain
 
+Node 1 runs with -utxocommitment, so its muhash comes from the rolling UTXO
+set commitment rather than a scan.
+
 Tests correspond to code in rpc/blockchain.cpp.
 """
 
@@ -19,7 +23,9 @@ from test_framework.util import (
     assert_raises_jsonrpc,
     assert_is_hex_string,
     assert_is_hash_string,
+    start_node,
     start_nodes,
+    stop_node,
     connect_nodes_bi,
 )
 
@@ -32,15 +38,17 @@ class BlockchainTest(BitcoinTestFramework):
         self.num_nodes = 2
 
     def setup_network(self, split=False):
-        self.nodes = start_nodes(self.num_nodes, self.options.tmpdir)
+        self.nodes = start_nodes(self.num_nodes, self.options.tmpdir, [[], ["-utxocommitment"]])
         connect_nodes_bi(self.nodes, 0, 1)
         self.is_network_split = False
         self.sync_all()
 
     def run_test(self):
         self._test_gettxoutsetinfo()
+        self._test_getcoinscacheinfo()
         self._test_getblockheader()
         self.nodes[0].verifychain(4, 0)
+        self._test_gettxoutsetinfo_muhash()
 
     def _test_gettxoutsetinfo(self):
         node = self.nodes[0]
@@ -54,6 +62,34 @@ class BlockchainTest(BitcoinTestFramework):
         assert_equal(len(res['bestblock']), 64)
         assert_equal(len(res['hash_serialized']), 64)
 
+        res2 = node.gettxoutsetinfo("none")
+        assert 'hash_serialized' not in res2
+        assert 'muhash' not in res2
+        for key in ['total_amount', 'transactions', 'height', 'txouts', 'bytes_serialized', 'bestblock']:
+            assert_equal(res2[key], res[key])
+
+        assert_raises_jsonrpc(-8, "Invalid hash_type", node.gettxoutsetinfo, "sha256")
+
+    def _test_getcoinscacheinfo(self):
+        node = self.nodes[0]
+        res = node.getcoinscacheinfo()
+        assert_equal(res['retain'], 50)
+        # gettxoutsetinfo wrote the cache out, keeping it all
+        assert res['flushes'] >= 1
+        assert_equal(res['evicted'], 0)
+        assert_equal(res['retained'], res['transactions'])
+
+        # A coin is read from the database once, then found in the cache
+        txid = node.getblock(node.getbestblockhash())['tx'][0]
+        node.gettxout(txid, 0)
+        res = node.getcoinscacheinfo()
+        node.gettxout(txid, 0)
+        res2 = node.getcoinscacheinfo()
+        assert_equal(res2['hits'], res['hits'] + 1)
+        assert_equal(res2['misses'], res['misses'])
+        assert_equal(res2['transactions'], res['transactions'])
+        assert res2['usage'] > 0
+
     def _test_getblockheader(self):
         node = self.nodes[0]
 
@@ -79,5 +115,49 @@ class BlockchainTest(BitcoinTestFramework):
         assert isinstance(int(header['versionHex'], 16), int)
         assert isinstance(header['difficulty'], Decimal)
 
+    def _assert_muhash_equal(self):
+        # Node 0 scans its database, node 1 reads its commitment
+        res0 = self.nodes[0].gettxoutsetinfo("muhash")
+        res1 = self.nodes[1].gettxoutsetinfo("muhash")
+        assert 'bytes_serialized' in res0
+        assert 'bytes_serialized' not in res1
+        for key in ['muhash', 'total_amount', 'transactions', 'height', 'txouts', 'bestblock']:
+            assert_equal(res0[key], res1[key])
+        assert_is_hash_string(res0['muhash'])
+        return res0['muhash']
+
+    def _test_gettxoutsetinfo_muhash(self):
+        muhash_before = self._assert_muhash_equal()
+
+        # Spend an output, so that the commitment follows spends and partial spends
+        self.nodes[0].sendtoaddress(self.nodes[1].getnewaddress(), 1)
+        self.nodes[0].generate(1)
+        self.sync_all()
+        muhash_after = self._assert_muhash_equal()
+        assert muhash_after != muhash_before
+
+        # Disconnecting the block restores the outputs
+        besthash = self.nodes[0].getbestblockhash()
+        for node in self.nodes:
+            node.invalidateblock(besthash)
+        assert_equal(self._assert_muhash_equal(), muhash_before)
+        for node in self.nodes:
+            node.reconsiderblock(besthash)
+        assert_equal(self._assert_muhash_equal(), muhash_after)
+
+        # The commitment is saved, and recomputed when stale
+        stop_node(self.nodes[1], 1)
+        self.nodes[1] = start_node(1, self.options.tmpdir, ["-utxocommitment"])
+        connect_nodes_bi(self.nodes, 0, 1)
+        assert_equal(self._assert_muhash_equal(), muhash_after)
+        stop_node(self.nodes[1], 1)
+        self.nodes[1] = start_node(1, self.options.tmpdir)
+        self.nodes[1].generate(1)
+        stop_node(self.nodes[1], 1)
+        self.nodes[1] = start_node(1, self.options.tmpdir, ["-utxocommitment"])
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.sync_all()
+        self._assert_muhash_equal()
+
 if __name__ == '__main__':
     BlockchainTest().main()
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the block index snapshot written at shutdown.
+
+- A clean restart loads the block index from the snapshot, with the same
+  chain tips, chain work and block statuses as from the database.
+- A corrupt snapshot is ignored.
+- -blockindexsnapshot=0 neither writes nor loads snapshots.
+"""
+
+import os
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    start_node,
+    stop_node,
+)
+
+class BlockIndexSnapshotTest(BitcoinTestFramework):
+
+    def __init__(self):
+        super().__init__()
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def setup_network(self, split=False):
+        self.nodes = [start_node(0, self.options.tmpdir)]
+
+    def datadir_file(self, name):
+        return os.path.join(self.options.tmpdir, "node0", "regtest", name)
+
+    def restart(self, extra_args=None):
+        stop_node(self.nodes[0], 0)
+        # Only look at the log of the new run
+        os.remove(self.datadir_file("debug.log"))
+        self.nodes[0] = start_node(0, self.options.tmpdir, extra_args)
+
+    def loaded_from_snapshot(self):
+        with open(self.datadir_file("debug.log"), encoding="utf-8") as f:
+            return "from the block index snapshot" in f.read()
+
+    def chain_state(self):
+        node = self.nodes[0]
+        tips = node.getchaintips()
+        headers = [node.getblockheader(tip['hash']) for tip in tips]
+        return tips, headers, node.getblockchaininfo()
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(120)
+        # A fork with an invalid block, so that statuses other than active count too
+        invalid = node.getblockhash(110)
+        node.invalidateblock(invalid)
+        node.generate(15)
+        state = self.chain_state()
+
+        self.log.info("Load the block index from the snapshot")
+        self.restart()
+        assert self.loaded_from_snapshot()
+        assert_equal(self.chain_state(), state)
+        assert_equal(self.nodes[0].getblockheader(invalid)['confirmations'], -1)
+        self.nodes[0].generate(1)
+        self.nodes[0].verifychain(4, 0)
+        state = self.chain_state()
+
+        self.log.info("Ignore a corrupt snapshot")
+        self.restart()
+        stop_node(self.nodes[0], 0)
+        with open(self.datadir_file("blockindex.dat"), "r+b") as f:
+            f.seek(100)
+            byte = f.read(1)
+            f.seek(100)
+            f.write(bytes([byte[0] ^ 1]))
+        os.remove(self.datadir_file("debug.log"))
+        self.nodes[0] = start_node(0, self.options.tmpdir)
+        assert not self.loaded_from_snapshot()
+        assert_equal(self.chain_state(), state)
+
+        self.log.info("Do not write or load snapshots with -blockindexsnapshot=0")
+        self.restart(["-blockindexsnapshot=0"])
+        assert not self.loaded_from_snapshot()
+        self.restart()
+        assert not self.loaded_from_snapshot()
+        assert_equal(self.chain_state(), state)
+
+if __name__ == '__main__':
+    BlockIndexSnapshotTest().main()
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test writing debug.log.
+
+- With the asynchronous log writer (the default), everything logged before
+  shutdown ends up in debug.log.
+- -logratelimit suppresses messages over the limit in a debug category, and
+  logs how many it suppressed.
+"""
+
+import os
+import re
+import time
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    start_node,
+    stop_node,
+)
+
+class DebugLogTest(BitcoinTestFramework):
+
+    def __init__(self):
+        super().__init__()
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def setup_network(self, split=False):
+        self.nodes = [start_node(0, self.options.tmpdir, ["-debug=rpc"])]
+
+    def read_log(self):
+        with open(os.path.join(self.options.tmpdir, "node0", "regtest", "debug.log"), encoding="utf-8") as f:
+            return f.read()
+
+    def start(self, extra_args):
+        # Only look at the log of the new run
+        os.remove(os.path.join(self.options.tmpdir, "node0", "regtest", "debug.log"))
+        self.nodes[0] = start_node(0, self.options.tmpdir, extra_args)
+
+    def run_test(self):
+        calls = 200
+        # Starting a node calls getblockcount once, to wait for it to come up
+        calls_on_start = 1
+
+        self.log.info("Write all messages with the asynchronous writer")
+        for _ in range(calls):
+            self.nodes[0].getblockcount()
+        stop_node(self.nodes[0], 0)
+        log = self.read_log()
+        assert_equal(log.count("method=getblockcount"), calls_on_start + calls)
+        assert "Shutdown: done" in log
+
+        self.log.info("Suppress messages over -logratelimit")
+        self.start(["-debug=rpc", "-logratelimit=5"])
+        for _ in range(calls):
+            self.nodes[0].getblockcount()
+        # A message in a new one-second window logs what was suppressed in the last
+        time.sleep(1.1)
+        self.nodes[0].getblockcount()
+        stop_node(self.nodes[0], 0)
+        log = self.read_log()
+        logged = log.count("method=getblockcount")
+        suppressed = sum(int(n) for n in re.findall(r"Suppressed (\d+) messages in category rpc", log))
+        assert suppressed > 0
+        assert logged < calls
+        assert_equal(logged + suppressed, calls_on_start + calls + 1)
+
+        self.log.info("Write synchronously with -logasync=0")
+        self.start(["-debug=rpc", "-logasync=0"])
+        for _ in range(calls):
+            self.nodes[0].getblockcount()
+        assert_equal(self.read_log().count("method=getblockcount"), calls_on_start + calls)
+
+if __name__ == '__main__':
+    DebugLogTest().main()
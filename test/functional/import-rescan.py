@@ -21,7 +21,7 @@ happened previously.
 
 from test_framework.authproxy import JSONRPCException
 from test_framework.test_framework import BitcoinTestFramework
-from test_framework.util import (start_nodes, connect_nodes, sync_blocks, assert_equal, set_node_times)
+from test_framework.util import (start_nodes, connect_nodes, sync_blocks, assert_equal, assert_greater_than, set_node_times)
 
 import collections
 import enum
@@ -120,6 +120,10 @@ class ImportRescanTest(BitcoinTestFramework):
         for i, import_node in enumerate(IMPORT_NODES, 2):
             if import_node.prune:
                 extra_args[i] += ["-prune=1"]
+            else:
+                # Rescan serially on the unpruned nodes, with the default
+                # number of block reading threads on the pruned ones.
+                extra_args[i] += ["-rescanthreads=1"]
 
         self.nodes = start_nodes(self.num_nodes, self.options.tmpdir, extra_args)
         for i in range(1, self.num_nodes):
@@ -160,6 +164,15 @@ class ImportRescanTest(BitcoinTestFramework):
                 variant.expected_txs = 0
                 variant.check()
 
+        # Nodes which rescanned report a finished rescan up to the tip.
+        for i, import_node in enumerate(IMPORT_NODES, 2):
+            info = self.nodes[i].getrescaninfo()
+            assert_equal(info["scanning"], False)
+            if import_node.rescan:
+                assert_equal(info["height"], self.nodes[i].getblockcount())
+                assert_equal(info["progress"], 1)
+                assert_greater_than(info["blocks"], 0)
+
         # Create new transactions sending to each address.
         fee = self.nodes[0].getnetworkinfo()["relayfee"]
         for i, variant in enumerate(IMPORT_VARIANTS):
@@ -7,6 +7,8 @@
 - Start a single node and generate 3 blocks.
 - Stop the node and restart it with -reindex. Verify that the node has reindexed up to block 3.
 - Stop the node and restart it with -reindex-chainstate. Verify that the node has reindexed up to block 3.
+- Split the blocks over several block files, with later blocks in earlier files, and reindex
+  with one and with several -reindexthreads.
 """
 
 from test_framework.test_framework import BitcoinTestFramework
@@ -15,8 +17,12 @@ from test_framework.util import (
     stop_nodes,
     assert_equal,
 )
+import os
+import struct
 import time
 
+MAGIC = b"\xfa\xbf\xb5\xda"
+
 class ReindexTest(BitcoinTestFramework):
 
     def __init__(self):
@@ -38,11 +44,50 @@ class ReindexTest(BitcoinTestFramework):
         assert_equal(self.nodes[0].getblockcount(), blockcount)
         self.log.info("Success")
 
+    def split_block_files(self):
+        """Spread the blocks over four block files, in reverse order"""
+        blocksdir = os.path.join(self.options.tmpdir, "node0", "regtest", "blocks")
+        blocks = []
+        for name in sorted(os.listdir(blocksdir)):
+            if not name.startswith("blk"):
+                continue
+            with open(os.path.join(blocksdir, name), "rb") as f:
+                data = f.read()
+            # Blocks may be separated by unused space, and be stored more than once
+            pos = data.find(MAGIC)
+            while pos >= 0 and pos + 8 <= len(data):
+                size = struct.unpack("<I", data[pos + 4:pos + 8])[0]
+                block = data[pos:pos + 8 + size]
+                if block not in blocks:
+                    blocks.append(block)
+                pos = data.find(MAGIC, pos + 8 + size)
+            os.remove(os.path.join(blocksdir, name))
+        per_file = (len(blocks) + 3) // 4
+        for n in range(4):
+            with open(os.path.join(blocksdir, "blk%05d.dat" % (3 - n)), "wb") as f:
+                f.write(b"".join(blocks[n * per_file:(n + 1) * per_file]))
+        return len(blocks)
+
+    def reindex_split_files(self, threads):
+        self.nodes[0].generate(10)
+        blockcount = self.nodes[0].getblockcount()
+        besthash = self.nodes[0].getbestblockhash()
+        stop_nodes(self.nodes)
+        assert_equal(self.split_block_files(), blockcount + 1)
+        extra_args = [["-reindex", "-reindexthreads=%d" % threads, "-checkblockindex=1"]]
+        self.nodes = start_nodes(self.num_nodes, self.options.tmpdir, extra_args)
+        while self.nodes[0].getblockcount() < blockcount:
+            time.sleep(0.1)
+        assert_equal(self.nodes[0].getbestblockhash(), besthash)
+        self.log.info("Success")
+
     def run_test(self):
         self.reindex(False)
         self.reindex(True)
         self.reindex(False)
         self.reindex(True)
+        self.reindex_split_files(1)
+        self.reindex_split_files(4)
 
 if __name__ == '__main__':
     ReindexTest().main()
@@ -47,6 +47,7 @@ BASE_SCRIPTS= [
     # vv Tests less than 60s vv
     'sendheaders.py',
     'zapwallettxes.py',
+    'wallet-logdb.py',
     'importmulti.py',
     'mempool_limit.py',
     'merkle_blocks.py',
@@ -70,6 +71,9 @@ BASE_SCRIPTS= [
     'nodehandling.py',
     'decodescript.py',
     'blockchain.py',
+    'utxo_snapshot.py',
+    'blockindex_snapshot.py',
+    'debug_log.py',
     'disablewallet.py',
     'keypool.py',
     'p2p-mempool.py',
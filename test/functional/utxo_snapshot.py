@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the dumptxoutset and loadtxoutset RPCs.
+
+Node 0 dumps its UTXO set to a snapshot file. Node 1, a new pruned node,
+loads it and carries on from the block of the snapshot, without ever
+downloading the blocks before it.
+"""
+
+import os
+import shutil
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_jsonrpc,
+    connect_nodes_bi,
+    start_node,
+    start_nodes,
+    stop_node,
+    sync_blocks,
+)
+
+class UTXOSnapshotTest(BitcoinTestFramework):
+
+    def __init__(self):
+        super().__init__()
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+
+    def setup_network(self, split=False):
+        # Not connected, so that node 1 stays at the genesis block
+        self.nodes = start_nodes(self.num_nodes, self.options.tmpdir, [[], ["-prune=1"]])
+        self.is_network_split = True
+
+    def run_test(self):
+        node0, node1 = self.nodes
+        node0.generate(110)
+        for i in range(10):
+            node0.sendtoaddress(node0.getnewaddress(), 1)
+        node0.generate(1)
+        stats = node0.gettxoutsetinfo()
+
+        self.log.info("Dump the UTXO set of node 0")
+        res = node0.dumptxoutset("utxo.dat")
+        path = res['path']
+        assert_equal(path, os.path.join(self.options.tmpdir, "node0", "regtest", "utxo.dat"))
+        assert_equal(res['base_hash'], stats['bestblock'])
+        assert_equal(res['base_height'], 111)
+        assert_equal(res['coins_written'], stats['transactions'])
+        assert_equal(res['hash_serialized'], stats['hash_serialized'])
+        assert_raises_jsonrpc(-1, "already exists", node0.dumptxoutset, "utxo.dat")
+
+        self.log.info("Reject bad snapshots and nodes that cannot load them")
+        corrupt = os.path.join(self.options.tmpdir, "corrupt.dat")
+        shutil.copyfile(path, corrupt)
+        with open(corrupt, "r+b") as f:
+            f.seek(-40, os.SEEK_END)
+            byte = f.read(1)
+            f.seek(-1, os.SEEK_CUR)
+            f.write(bytes([byte[0] ^ 1]))
+        assert_raises_jsonrpc(-1, "checksum mismatch", node1.loadtxoutset, corrupt)
+        with open(corrupt, "r+b") as f:
+            f.truncate(1000)
+        assert_raises_jsonrpc(-1, "Invalid or truncated", node1.loadtxoutset, corrupt)
+        assert_raises_jsonrpc(-1, "is not the expected one", node1.loadtxoutset, path, "11" * 32)
+        assert_raises_jsonrpc(-1, "requires pruning", node0.loadtxoutset, path)
+        assert_equal(node1.getblockcount(), 0)
+
+        self.log.info("Load the snapshot into node 1")
+        res = node1.loadtxoutset(path, stats['hash_serialized'])
+        assert_equal(res['base_hash'], stats['bestblock'])
+        assert_equal(res['base_height'], 111)
+        assert_equal(res['coins_written'], stats['transactions'])
+        assert_equal(node1.getbestblockhash(), stats['bestblock'])
+        assert_equal(node1.gettxoutsetinfo(), stats)
+        assert node1.getblockchaininfo()['pruned']
+        assert_raises_jsonrpc(-1, "requires an empty chain state", node1.loadtxoutset, path)
+
+        self.log.info("Sync new blocks on top of the snapshot")
+        connect_nodes_bi(self.nodes, 0, 1)
+        node0.sendtoaddress(node0.getnewaddress(), 1)
+        node0.generate(5)
+        sync_blocks(self.nodes)
+        assert_equal(node1.gettxoutsetinfo(), node0.gettxoutsetinfo())
+
+        self.log.info("Restart node 1 from the loaded chain state")
+        stop_node(node1, 1)
+        self.nodes[1] = start_node(1, self.options.tmpdir, ["-prune=1"])
+        assert_equal(self.nodes[1].getbestblockhash(), node0.getbestblockhash())
+        assert_equal(self.nodes[1].gettxoutsetinfo(), node0.gettxoutsetinfo())
+
+if __name__ == '__main__':
+    UTXOSnapshotTest().main()
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the append-only log wallet storage engine.
+
+- a new wallet file is created as a log with -walletbackend=log, while an
+  existing Berkeley DB wallet keeps its format
+- a log wallet survives restarts and encryption (which rewrites it)
+- -migratewallet converts a wallet both ways, keeping its contents and a
+  backup of the original file
+"""
+import os
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+
+LOGDB_MAGIC = b"\x00logwalt"
+
+class WalletLogDBTest(BitcoinTestFramework):
+
+    def __init__(self):
+        super().__init__()
+        self.setup_clean_chain = False
+        self.num_nodes = 2
+        self.extra_args = [[], ["-walletbackend=log", "-wallet=log.dat"]]
+
+    def setup_network(self):
+        self.nodes = start_nodes(self.num_nodes, self.options.tmpdir, self.extra_args)
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.is_network_split = False
+
+    def wallet_path(self, node, filename):
+        return os.path.join(self.options.tmpdir, "node%d" % node, "regtest", filename)
+
+    def is_log(self, node, filename):
+        with open(self.wallet_path(node, filename), "rb") as f:
+            return f.read(len(LOGDB_MAGIC)) == LOGDB_MAGIC
+
+    def restart_node(self, node, extra_args):
+        stop_node(self.nodes[node], node)
+        self.nodes[node] = start_node(node, self.options.tmpdir, extra_args)
+        connect_nodes_bi(self.nodes, 0, 1)
+
+    def run_test(self):
+        assert(not self.is_log(0, "wallet.dat"))
+        assert(self.is_log(1, "log.dat"))
+
+        # Fill the log wallet with some keys and transactions
+        addresses = [self.nodes[1].getnewaddress() for _ in range(10)]
+        for address in addresses:
+            self.nodes[0].sendtoaddress(address, 1)
+        self.nodes[0].generate(1)
+        self.sync_all()
+        assert_equal(self.nodes[1].getbalance(), 10)
+        txs = self.nodes[1].listtransactions("*", 100)
+
+        # It loads back identically
+        self.restart_node(1, self.extra_args[1])
+        assert_equal(self.nodes[1].getbalance(), 10)
+        assert_equal(self.nodes[1].listtransactions("*", 100), txs)
+
+        # Encrypt it, which rewrites the log, and spend from it
+        self.nodes[1].encryptwallet("test")
+        bitcoind_processes[1].wait()
+        self.nodes[1] = start_node(1, self.options.tmpdir, self.extra_args[1])
+        connect_nodes_bi(self.nodes, 0, 1)
+        assert(self.is_log(1, "log.dat"))
+        self.nodes[1].walletpassphrase("test", 100)
+        self.nodes[1].sendtoaddress(self.nodes[0].getnewaddress(), 5)
+        self.sync_all()
+        self.nodes[0].generate(1)
+        self.sync_all()
+        assert_greater_than(5, self.nodes[1].getbalance())
+        balance1 = self.nodes[1].getbalance()
+
+        # Migrate node 0's Berkeley DB wallet to a log and back
+        balance0 = self.nodes[0].getbalance()
+        txs = self.nodes[0].listtransactions("*", 1000)
+        self.restart_node(0, ["-migratewallet", "-walletbackend=log"])
+        assert(self.is_log(0, "wallet.dat"))
+        backups = [f for f in os.listdir(self.wallet_path(0, "")) if f.startswith("wallet.dat.") and f.endswith(".bak")]
+        assert_equal(len(backups), 1)
+        assert(not self.is_log(0, backups[0]))
+        assert_equal(self.nodes[0].getbalance(), balance0)
+        assert_equal(self.nodes[0].listtransactions("*", 1000), txs)
+
+        # The migrated wallet keeps working
+        self.nodes[0].sendtoaddress(self.nodes[1].getnewaddress(), 1)
+        self.nodes[0].generate(1)
+        self.sync_all()
+        assert_equal(self.nodes[1].getbalance(), balance1 + 1)
+        balance0 = self.nodes[0].getbalance()
+
+        # Without -migratewallet, an existing wallet keeps its format
+        self.restart_node(0, ["-walletbackend=bdb"])
+        assert(self.is_log(0, "wallet.dat"))
+        assert_equal(self.nodes[0].getbalance(), balance0)
+
+        self.restart_node(0, ["-migratewallet", "-walletbackend=bdb"])
+        assert(not self.is_log(0, "wallet.dat"))
+        assert_equal(self.nodes[0].getbalance(), balance0)
+
+        # An unknown engine is refused
+        stop_node(self.nodes[0], 0)
+        assert_start_raises_init_error(0, self.options.tmpdir, ["-walletbackend=foo"], "Unknown wallet storage engine: foo")
+        self.nodes[0] = start_node(0, self.options.tmpdir)
+
+if __name__ == '__main__':
+    WalletLogDBTest().main()
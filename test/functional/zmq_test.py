@@ -23,8 +23,11 @@ class ZMQTest (BitcoinTestFramework):
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashblock")
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashtx")
         self.zmqSubSocket.connect("tcp://127.0.0.1:%i" % self.port)
+        self.zmqSequenceSocket = self.zmqContext.socket(zmq.SUB)
+        self.zmqSequenceSocket.setsockopt(zmq.SUBSCRIBE, b"sequence")
+        self.zmqSequenceSocket.connect("tcp://127.0.0.1:%i" % self.port)
         return start_nodes(self.num_nodes, self.options.tmpdir, extra_args=[
-            ['-zmqpubhashtx=tcp://127.0.0.1:'+str(self.port), '-zmqpubhashblock=tcp://127.0.0.1:'+str(self.port)],
+            ['-zmqpubhashtx=tcp://127.0.0.1:'+str(self.port), '-zmqpubhashblock=tcp://127.0.0.1:'+str(self.port), '-zmqpubsequence=tcp://127.0.0.1:'+str(self.port)],
             [],
             [],
             []
@@ -34,6 +37,7 @@ class ZMQTest (BitcoinTestFramework):
         self.sync_all()
 
         genhashes = self.nodes[0].generate(1)
+        genhashes0 = genhashes[0]
         self.sync_all()
 
         self.log.info("listen...")
@@ -88,6 +92,26 @@ class ZMQTest (BitcoinTestFramework):
 
         assert_equal(hashRPC, hashZMQ) #blockhash from generate must be equal to the hash received over zmq
 
+        self.log.info("check sequence notifications")
+        expected = [(h, b"C") for h in [genhashes0] + genhashes] + [(hashRPC, b"A")]
+        for seq, (hash, label) in enumerate(expected):
+            msg = self.zmqSequenceSocket.recv_multipart()
+            assert_equal(msg[0], b"sequence")
+            assert_equal(bytes_to_hex_str(msg[1][:32]), hash)
+            assert_equal(msg[1][32:], label)
+            assert_equal(struct.unpack('<I', msg[-1])[-1], seq)
+
+        # a subscriber that missed messages can recover them from the spill buffer
+        spill = self.nodes[0].getzmqspill(1)
+        assert_equal(spill['oldest'], 0)
+        assert(spill['complete'])
+        assert_equal(len(spill['messages']), len(expected) - 1)
+        for seq, entry in enumerate(spill['messages'], 1):
+            assert_equal(entry['sequence'], seq)
+            assert_equal(entry['topic'], "sequence")
+            assert_equal(entry['body'][:64], expected[seq][0])
+        assert_raises_jsonrpc(-1, "No ZMQ spill buffer", self.nodes[1].getzmqspill, 0)
+
 
 if __name__ == '__main__':
     ZMQTest ().main ()